@@ -0,0 +1,611 @@
+// End-to-end throughput of the codec and I/O entry points on a deterministic
+// synthetic corpus. Every stage is timed per file and in aggregate, along
+// with heap allocations and peak RSS, and the whole run can be written as
+// JSON so two builds can be compared. Run with --help for options.
+
+#include "AudioFormats.h"
+#include "Convert.h"
+#include "ConvertBuffers.h"
+#include "LoopFinder.h"
+#include "PathUtils.h"
+#include "PcmKernels.h"
+#include "Resampler.h"
+#include "SamplePlayer.h"
+#include "SohSampleWriter.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <new>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// Heap traffic through the global operator new. Aligned and nothrow
+// allocations that bypass it are not counted.
+static std::atomic<uint64_t> gAllocationCount{0};
+static std::atomic<uint64_t> gAllocationBytes{0};
+
+// GCC cannot see that these replacements pair malloc with free.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    gAllocationBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+static uint64_t PeakRssBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.PeakWorkingSetSize;
+    }
+    return 0;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+enum class Signal {
+    Tone,
+    Noise,
+    Speech,
+};
+
+static const char* SignalName(Signal signal) {
+    switch (signal) {
+        case Signal::Tone:
+            return "tone";
+        case Signal::Noise:
+            return "noise";
+        case Signal::Speech:
+            return "speech";
+    }
+    return "";
+}
+
+struct CorpusFile {
+    std::string name;
+    std::filesystem::path path;
+    Signal signal = Signal::Tone;
+    uint32_t sampleRate = 0;
+    double seconds = 0.0;
+    size_t sampleCount = 0;
+};
+
+struct StageTotals {
+    const char* name = "";
+    uint64_t files = 0;
+    uint64_t samples = 0;
+    double seconds = 0.0;
+    uint64_t allocations = 0;
+    uint64_t allocatedBytes = 0;
+    uint64_t peakRssBytes = 0;
+};
+
+struct FileResult {
+    const CorpusFile* file = nullptr;
+    // Seconds per run for each stage, in StageTotals order.
+    std::vector<double> seconds;
+};
+
+struct ThreadResult {
+    size_t threads = 0;
+    size_t files = 0;
+    size_t failed = 0;
+    uint64_t samples = 0;
+    double seconds = 0.0;
+    uint64_t peakRssBytes = 0;
+};
+
+struct BenchOptions {
+    bool quick = false;
+    size_t maxThreads = 0;
+    std::filesystem::path corpusDir;
+    std::filesystem::path jsonPath;
+};
+
+// xorshift64*, so every build and platform generates the same corpus.
+class Random {
+public:
+    explicit Random(uint64_t seed) : state(seed ? seed : 1) {
+    }
+    double NextSigned() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        uint64_t value = state * 0x2545F4914F6CDD1DULL;
+        return static_cast<double>(value >> 11) / static_cast<double>(1ULL << 53) * 2.0 - 1.0;
+    }
+
+private:
+    uint64_t state;
+};
+
+static std::vector<int16_t> Synthesize(Signal signal, uint32_t sampleRate, size_t sampleCount) {
+    constexpr double kTwoPi = 6.283185307179586;
+    std::vector<float> buffer(sampleCount);
+    Random random(0x5EED0000ULL + static_cast<uint64_t>(signal) * 7919 + sampleRate);
+    double rate = static_cast<double>(sampleRate);
+    double lowpass = 0.0;
+    for (size_t i = 0; i < sampleCount; i++) {
+        double t = static_cast<double>(i) / rate;
+        double value = 0.0;
+        switch (signal) {
+            case Signal::Tone: {
+                // Three partials with slow vibrato, like a sustained instrument.
+                double vibrato = 1.0 + 0.003 * std::sin(kTwoPi * 5.0 * t);
+                value = 0.35 * std::sin(kTwoPi * 440.0 * vibrato * t) + 0.15 * std::sin(kTwoPi * 880.0 * vibrato * t) +
+                        0.08 * std::sin(kTwoPi * 1320.0 * vibrato * t);
+                break;
+            }
+            case Signal::Noise:
+                value = 0.3 * random.NextSigned();
+                break;
+            case Signal::Speech: {
+                // Band-limited noise plus a gliding voiced tone under a 4 Hz
+                // syllable envelope with pauses between phrases.
+                lowpass += 0.2 * (random.NextSigned() - lowpass);
+                double syllable = std::fabs(std::sin(kTwoPi * 2.0 * t));
+                double phrase = std::fmod(t, 3.0) < 2.4 ? 1.0 : 0.0;
+                double pitch = 140.0 + 30.0 * std::sin(kTwoPi * 0.7 * t);
+                value = phrase * syllable * (0.4 * std::sin(kTwoPi * pitch * t) + 0.5 * lowpass);
+                break;
+            }
+        }
+        buffer[i] = static_cast<float>(value);
+    }
+    std::vector<int16_t> samples(sampleCount);
+    NarrowF32ToS16(buffer.data(), samples.data(), sampleCount);
+    return samples;
+}
+
+// Short files at several rates; the long ones at the game's usual 32 kHz so
+// the corpus stays a few hundred MB.
+static std::vector<CorpusFile> PlanCorpus(const BenchOptions& options) {
+    std::vector<CorpusFile> files;
+    auto add = [&](Signal signal, uint32_t sampleRate, double seconds) {
+        CorpusFile file;
+        file.signal = signal;
+        file.sampleRate = sampleRate;
+        file.seconds = seconds;
+        file.sampleCount = static_cast<size_t>(std::llround(seconds * sampleRate));
+        char name[64];
+        std::snprintf(name, sizeof(name), "%s_%u_%gs", SignalName(signal), sampleRate, seconds);
+        file.name = name;
+        file.path = options.corpusDir / (file.name + ".wav");
+        files.push_back(file);
+    };
+
+    for (Signal signal : {Signal::Tone, Signal::Noise, Signal::Speech}) {
+        for (uint32_t sampleRate : {16000u, 32000u, 44100u}) {
+            for (double seconds : {0.1, 1.0, 10.0}) {
+                add(signal, sampleRate, seconds);
+            }
+        }
+        if (!options.quick) {
+            add(signal, 32000, 60.0);
+            add(signal, 32000, 600.0);
+        }
+    }
+    return files;
+}
+
+static bool WriteCorpus(const std::vector<CorpusFile>& files) {
+    for (const CorpusFile& file : files) {
+        std::error_code ec;
+        uint64_t expected = 44 + static_cast<uint64_t>(file.sampleCount) * 2;
+        if (std::filesystem::file_size(file.path, ec) == expected && !ec) {
+            continue;
+        }
+        WavData wav;
+        wav.sampleRate = file.sampleRate;
+        wav.samples = Synthesize(file.signal, file.sampleRate, file.sampleCount);
+        std::string error;
+        if (!WriteWavFile(file.path, wav, error)) {
+            std::fprintf(stderr, "Failed to write %s: %s\n", PathToUtf8(file.path).c_str(), error.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// Runs a stage at least once and until it has taken 0.2 s, so short files
+// are not timed at the clock's resolution. Returns seconds per run.
+static double TimeStage(StageTotals& totals, size_t sampleCount, const std::function<bool()>& run) {
+    using Clock = std::chrono::steady_clock;
+    uint64_t allocationsBefore = gAllocationCount.load(std::memory_order_relaxed);
+    uint64_t bytesBefore = gAllocationBytes.load(std::memory_order_relaxed);
+    size_t runs = 0;
+    double seconds = 0.0;
+    auto start = Clock::now();
+    do {
+        if (!run()) {
+            return -1.0;
+        }
+        runs++;
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (seconds < 0.2);
+
+    totals.files++;
+    totals.samples += sampleCount;
+    totals.seconds += seconds / static_cast<double>(runs);
+    totals.allocations += (gAllocationCount.load(std::memory_order_relaxed) - allocationsBefore) / runs;
+    totals.allocatedBytes += (gAllocationBytes.load(std::memory_order_relaxed) - bytesBefore) / runs;
+    totals.peakRssBytes = std::max(totals.peakRssBytes, PeakRssBytes());
+    return seconds / static_cast<double>(runs);
+}
+
+static bool RunThreadSweep(const std::vector<CorpusFile>& files,
+                           const std::filesystem::path& outputDir,
+                           size_t threads,
+                           ThreadResult& result) {
+    ConvertOptions convertOptions;
+    convertOptions.incremental = false;
+    std::atomic<size_t> failed{0};
+    auto start = std::chrono::steady_clock::now();
+    {
+        ThreadPool pool(threads);
+        for (const CorpusFile& file : files) {
+            pool.Submit([&, filePtr = &file] {
+                ConvertJob job;
+                job.inputPath = filePtr->path;
+                job.outputName = filePtr->name;
+                thread_local ConvertBuffers buffers;
+                std::string status;
+                if (!ConvertSample(job, outputDir, convertOptions, status, nullptr, nullptr, &buffers)) {
+                    failed++;
+                }
+            });
+        }
+        pool.Wait();
+    }
+    result.threads = threads;
+    result.files = files.size();
+    result.failed = failed.load();
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.peakRssBytes = PeakRssBytes();
+    for (const CorpusFile& file : files) {
+        result.samples += file.sampleCount;
+    }
+    return result.failed == 0;
+}
+
+static double PerSecond(double amount, double seconds) {
+    return seconds > 0.0 ? amount / seconds : 0.0;
+}
+
+static std::string JsonString(const std::string& text) {
+    std::string out = "\"";
+    for (char ch : text) {
+        if (ch == '"' || ch == '\\') {
+            out += '\\';
+        }
+        out += ch;
+    }
+    return out + "\"";
+}
+
+static bool WriteJson(const std::filesystem::path& path,
+                      const std::vector<CorpusFile>& files,
+                      const std::vector<StageTotals>& stages,
+                      const std::vector<FileResult>& fileResults,
+                      const std::vector<ThreadResult>& threadResults) {
+    FILE* out = std::fopen(PathToUtf8(path).c_str(), "w");
+    if (!out) {
+        return false;
+    }
+
+    uint64_t corpusSamples = 0;
+    for (const CorpusFile& file : files) {
+        corpusSamples += file.sampleCount;
+    }
+    std::fprintf(out, "{\n  \"tool\": \"SoH-AudioTool-bench\",\n  \"format\": 1,\n");
+    std::fprintf(out, "  \"isa\": %s,\n", JsonString(PcmIsaName(GetPcmIsa())).c_str());
+    std::fprintf(out, "  \"hardwareThreads\": %zu,\n", ThreadPool::DefaultThreadCount());
+    std::fprintf(out, "  \"corpus\": {\"files\": %zu, \"samples\": %llu},\n", files.size(),
+                 static_cast<unsigned long long>(corpusSamples));
+
+    std::fprintf(out, "  \"stages\": [\n");
+    for (size_t i = 0; i < stages.size(); i++) {
+        const StageTotals& stage = stages[i];
+        std::fprintf(out,
+                     "    {\"name\": %s, \"files\": %llu, \"samples\": %llu, \"seconds\": %.6f, "
+                     "\"samplesPerSecond\": %.1f, \"mbPerSecond\": %.3f, \"allocations\": %llu, "
+                     "\"allocatedBytes\": %llu, \"peakRssBytes\": %llu}%s\n",
+                     JsonString(stage.name).c_str(), static_cast<unsigned long long>(stage.files),
+                     static_cast<unsigned long long>(stage.samples), stage.seconds,
+                     PerSecond(static_cast<double>(stage.samples), stage.seconds),
+                     PerSecond(static_cast<double>(stage.samples) * 2.0 / 1e6, stage.seconds),
+                     static_cast<unsigned long long>(stage.allocations),
+                     static_cast<unsigned long long>(stage.allocatedBytes),
+                     static_cast<unsigned long long>(stage.peakRssBytes), i + 1 < stages.size() ? "," : "");
+    }
+    std::fprintf(out, "  ],\n  \"files\": [\n");
+    for (size_t i = 0; i < fileResults.size(); i++) {
+        const FileResult& result = fileResults[i];
+        std::fprintf(out, "    {\"name\": %s, \"sampleRate\": %u, \"samples\": %zu, \"seconds\": {",
+                     JsonString(result.file->name).c_str(), result.file->sampleRate, result.file->sampleCount);
+        for (size_t stage = 0; stage < result.seconds.size(); stage++) {
+            std::fprintf(out, "%s%s: %.6f", stage ? ", " : "", JsonString(stages[stage].name).c_str(),
+                         result.seconds[stage]);
+        }
+        std::fprintf(out, "}}%s\n", i + 1 < fileResults.size() ? "," : "");
+    }
+    std::fprintf(out, "  ],\n  \"threads\": [\n");
+    for (size_t i = 0; i < threadResults.size(); i++) {
+        const ThreadResult& result = threadResults[i];
+        std::fprintf(out,
+                     "    {\"threads\": %zu, \"files\": %zu, \"failed\": %zu, \"seconds\": %.6f, "
+                     "\"filesPerSecond\": %.3f, \"samplesPerSecond\": %.1f, \"mbPerSecond\": %.3f, "
+                     "\"peakRssBytes\": %llu}%s\n",
+                     result.threads, result.files, result.failed, result.seconds,
+                     PerSecond(static_cast<double>(result.files), result.seconds),
+                     PerSecond(static_cast<double>(result.samples), result.seconds),
+                     PerSecond(static_cast<double>(result.samples) * 2.0 / 1e6, result.seconds),
+                     static_cast<unsigned long long>(result.peakRssBytes), i + 1 < threadResults.size() ? "," : "");
+    }
+    std::fprintf(out, "  ]\n}\n");
+    return std::fclose(out) == 0;
+}
+
+static void PrintUsage(FILE* out) {
+    std::fputs(
+        "Usage: SoH-AudioTool-bench [options]\n"
+        "\n"
+        "  --quick           Skip the 60 s and 10 min corpus files\n"
+        "  --threads N       Largest thread count for the batch sweep (default: one per core)\n"
+        "  --corpus DIR      Where to generate the corpus (default: system temp folder)\n"
+        "  --json FILE       Also write the results as JSON\n"
+        "  -h, --help        Show this help\n",
+        out);
+}
+
+static bool ParseArgs(int argc, char** argv, BenchOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--quick") {
+            options.quick = true;
+        } else if (arg == "--threads" && hasValue) {
+            options.maxThreads = static_cast<size_t>(std::max(1L, std::strtol(argv[++i], nullptr, 10)));
+        } else if (arg == "--corpus" && hasValue) {
+            options.corpusDir = Utf8ToPath(argv[++i]);
+        } else if (arg == "--json" && hasValue) {
+            options.jsonPath = Utf8ToPath(argv[++i]);
+        } else {
+            PrintUsage(arg == "-h" || arg == "--help" ? stdout : stderr);
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    if (!ParseArgs(argc, argv, options)) {
+        return 2;
+    }
+    if (options.corpusDir.empty()) {
+        options.corpusDir = std::filesystem::temp_directory_path() / "soh-audio-bench";
+    }
+    if (options.maxThreads == 0) {
+        options.maxThreads = ThreadPool::DefaultThreadCount();
+    }
+    std::filesystem::path outputDir = options.corpusDir / "out";
+    std::error_code ec;
+    std::filesystem::create_directories(outputDir, ec);
+
+    std::vector<CorpusFile> files = PlanCorpus(options);
+    std::printf("Generating corpus in %s...\n", PathToUtf8(options.corpusDir).c_str());
+    if (!WriteCorpus(files)) {
+        return 1;
+    }
+
+    // Files already at the resample target are copied, which shows the
+    // stage's fixed cost.
+    constexpr uint32_t kResampleRate = 32000;
+    std::vector<StageTotals> stages(7);
+    stages[0].name = "read";
+    stages[1].name = "resample";
+    stages[2].name = "encode";
+    stages[3].name = "decode";
+    stages[4].name = "write";
+    stages[5].name = "convert";
+    // Streams the written sample through the preview player in
+    // audio-callback-sized reads.
+    stages[6].name = "play";
+    constexpr size_t kPlayBlockSamples = 512;
+
+    std::vector<FileResult> fileResults;
+    ConvertOptions convertOptions;
+    convertOptions.incremental = false;
+    // Shared by every file, as a batch worker's would be, and each stage
+    // below reuses its outputs across runs.
+    ConvertBuffers convertBuffers;
+    std::vector<float> resampleWork;
+    SamplePlayer player;
+    int16_t playBlock[kPlayBlockSamples];
+    // Open plus the first block: how long a preview takes to start.
+    double worstPlayStart = 0.0;
+    const CorpusFile* worstPlayStartFile = nullptr;
+    // Automatic loop search over the whole file. Files too short to search
+    // are skipped.
+    double worstLoopSearch = 0.0;
+    const CorpusFile* worstLoopSearchFile = nullptr;
+    std::vector<LoopCandidate> loopCandidates;
+    std::printf("%-24s %10s %10s %10s %10s %10s %10s %10s  (Msamples/s)\n", "file", "read", "resample", "encode",
+                "decode", "write", "convert", "play");
+    for (const CorpusFile& file : files) {
+        FileResult result;
+        result.file = &file;
+        std::string error;
+        WavData wav;
+        VadpcmAifc aifc;
+        std::vector<int16_t> decoded;
+        std::vector<int16_t> resampled;
+        SohSampleData sample;
+        std::filesystem::path soundPath = outputDir / file.name;
+
+        result.seconds.push_back(TimeStage(stages[0], file.sampleCount, [&] {
+            return ReadWavFile(file.path, wav, error);
+        }));
+        result.seconds.push_back(TimeStage(stages[1], file.sampleCount, [&] {
+            return ResamplePcm(wav.samples, wav.sampleRate, kResampleRate, resampled, error, &resampleWork);
+        }));
+        result.seconds.push_back(TimeStage(stages[2], file.sampleCount, [&] {
+            return EncodeVadpcm(wav, 4, aifc, error);
+        }));
+        result.seconds.push_back(TimeStage(stages[3], file.sampleCount, [&] {
+            return DecodeVadpcm(aifc, decoded, error);
+        }));
+        sample.adpcmData = aifc.adpcmData;
+        sample.sampleCount = static_cast<uint32_t>(file.sampleCount);
+        sample.order = aifc.order;
+        sample.predictors = aifc.predictors;
+        sample.book = aifc.book;
+        result.seconds.push_back(TimeStage(stages[4], file.sampleCount, [&] {
+            return WriteSohSample(soundPath, sample, error);
+        }));
+        result.seconds.push_back(TimeStage(stages[5], file.sampleCount, [&] {
+            ConvertJob job;
+            job.inputPath = file.path;
+            job.outputName = file.name;
+            return ConvertSample(job, outputDir, convertOptions, error, nullptr, nullptr, &convertBuffers);
+        }));
+        result.seconds.push_back(TimeStage(stages[6], file.sampleCount, [&] {
+            if (!player.Open(soundPath, error)) {
+                return false;
+            }
+            while (player.Read(playBlock) == kPlayBlockSamples) {
+            }
+            if (player.GetPlayedCount() != file.sampleCount) {
+                error = "Preview played " + std::to_string(player.GetPlayedCount()) + " samples.";
+                return false;
+            }
+            return true;
+        }));
+        auto playStart = std::chrono::steady_clock::now();
+        if (player.Open(soundPath, error) && player.Read(playBlock) > 0) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - playStart).count();
+            if (seconds > worstPlayStart) {
+                worstPlayStart = seconds;
+                worstPlayStartFile = &file;
+            }
+        }
+        player.Close();
+        auto searchStart = std::chrono::steady_clock::now();
+        std::string searchError;
+        if (FindLoopPoints(wav.samples, wav.sampleRate, LoopSearchOptions{}, loopCandidates, searchError)) {
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - searchStart).count();
+            if (seconds > worstLoopSearch) {
+                worstLoopSearch = seconds;
+                worstLoopSearchFile = &file;
+            }
+        }
+
+        if (std::any_of(result.seconds.begin(), result.seconds.end(), [](double seconds) { return seconds < 0.0; })) {
+            std::fprintf(stderr, "%s failed: %s\n", file.name.c_str(), error.c_str());
+            return 1;
+        }
+        std::printf("%-24s", file.name.c_str());
+        for (double seconds : result.seconds) {
+            std::printf(" %10.2f", PerSecond(static_cast<double>(file.sampleCount) / 1e6, seconds));
+        }
+        std::printf("\n");
+        fileResults.push_back(std::move(result));
+    }
+
+    std::printf("\n%-10s %12s %10s %14s %14s %12s\n", "stage", "Msamples/s", "MB/s", "allocs/file", "alloc MB",
+                "peak RSS MB");
+    for (const StageTotals& stage : stages) {
+        std::printf("%-10s %12.2f %10.1f %14.1f %14.1f %12.1f\n", stage.name,
+                    PerSecond(static_cast<double>(stage.samples) / 1e6, stage.seconds),
+                    PerSecond(static_cast<double>(stage.samples) * 2.0 / 1e6, stage.seconds),
+                    static_cast<double>(stage.allocations) / static_cast<double>(std::max<uint64_t>(stage.files, 1)),
+                    static_cast<double>(stage.allocatedBytes) / 1e6, static_cast<double>(stage.peakRssBytes) / 1e6);
+    }
+    if (worstPlayStartFile) {
+        std::printf("Preview start: %.3f ms at worst (%s)\n", worstPlayStart * 1000.0,
+                    worstPlayStartFile->name.c_str());
+    }
+    if (worstLoopSearchFile) {
+        std::printf("Loop search: %.3f ms at worst (%s)\n", worstLoopSearch * 1000.0,
+                    worstLoopSearchFile->name.c_str());
+    }
+
+    std::vector<ThreadResult> threadResults;
+    std::printf("\n%-8s %10s %12s %10s\n", "threads", "files/s", "Msamples/s", "seconds");
+    for (size_t threads = 1;; threads = std::min(threads * 2, options.maxThreads)) {
+        ThreadResult result;
+        if (!RunThreadSweep(files, outputDir, threads, result)) {
+            std::fprintf(stderr, "%zu conversions failed with %zu threads.\n", result.failed, threads);
+            return 1;
+        }
+        std::printf("%-8zu %10.2f %12.2f %10.2f\n", threads, PerSecond(static_cast<double>(result.files), result.seconds),
+                    PerSecond(static_cast<double>(result.samples) / 1e6, result.seconds), result.seconds);
+        threadResults.push_back(result);
+        if (threads >= options.maxThreads) {
+            break;
+        }
+    }
+
+    if (!options.jsonPath.empty()) {
+        if (!WriteJson(options.jsonPath, files, stages, fileResults, threadResults)) {
+            std::fprintf(stderr, "Failed to write %s\n", PathToUtf8(options.jsonPath).c_str());
+            return 1;
+        }
+        std::printf("\nWrote %s\n", PathToUtf8(options.jsonPath).c_str());
+    }
+    return 0;
+}
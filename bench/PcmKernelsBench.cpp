@@ -0,0 +1,138 @@
+// Throughput of the PCM byte-order and width kernels against the per-sample
+// loops they replaced. Run without arguments; prints GB/s of input per
+// kernel and ISA.
+
+#include "PcmKernels.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <ostream>
+#include <streambuf>
+#include <vector>
+
+static constexpr size_t kSampleCount = size_t(1) << 22;
+
+// Swallows output so stream overhead is measured without the disk.
+class NullBuffer : public std::streambuf {
+protected:
+    std::streamsize xsputn(const char*, std::streamsize count) override {
+        return count;
+    }
+    int overflow(int ch) override {
+        return ch;
+    }
+};
+
+static double MeasureGBps(size_t bytesPerRun, const std::function<void()>& run) {
+    using Clock = std::chrono::steady_clock;
+    run();
+    size_t runs = 0;
+    auto start = Clock::now();
+    double seconds = 0.0;
+    do {
+        run();
+        runs++;
+        seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (seconds < 0.25);
+    return static_cast<double>(bytesPerRun) * static_cast<double>(runs) / seconds / 1e9;
+}
+
+static void Report(const char* kernel, const char* variant, double gbps) {
+    std::printf("%-22s %-14s %8.2f GB/s\n", kernel, variant, gbps);
+}
+
+int main() {
+    std::vector<uint8_t> bytes(kSampleCount * 2);
+    for (size_t i = 0; i < bytes.size(); i++) {
+        bytes[i] = static_cast<uint8_t>(i * 131 + 7);
+    }
+    std::vector<int16_t> samples(kSampleCount);
+    std::vector<int16_t> decoded(kSampleCount);
+    std::vector<int32_t> wide(kSampleCount);
+    std::vector<float> floats(kSampleCount);
+    std::vector<uint8_t> outBytes(kSampleCount * 2);
+    // 24- and 32-bit WAV data.
+    std::vector<uint8_t> wideBytes(kSampleCount * 4);
+    for (size_t i = 0; i < wideBytes.size(); i++) {
+        wideBytes[i] = static_cast<uint8_t>(i * 97 + 3);
+    }
+    std::memcpy(samples.data(), bytes.data(), bytes.size());
+    for (size_t i = 0; i < kSampleCount; i++) {
+        decoded[i] = static_cast<int16_t>(samples[i] + static_cast<int>(i % 61) - 30);
+    }
+    const size_t pcmBytes = kSampleCount * 2;
+
+    // The loops ReadWavFile, ReadAiffPcm and WriteAiffPcm used before.
+    Report("read s16le", "per-sample", MeasureGBps(pcmBytes, [&] {
+        for (size_t i = 0; i < kSampleCount; i++) {
+            const uint8_t* p = bytes.data() + i * 2;
+            samples[i] = static_cast<int16_t>(p[0] | (p[1] << 8));
+        }
+    }));
+    Report("read s16be", "per-sample", MeasureGBps(pcmBytes, [&] {
+        for (size_t i = 0; i < kSampleCount; i++) {
+            const uint8_t* p = bytes.data() + i * 2;
+            samples[i] = static_cast<int16_t>((p[0] << 8) | p[1]);
+        }
+    }));
+    NullBuffer nullBuffer;
+    std::ostream nullStream(&nullBuffer);
+    Report("write s16be", "ostream/sample", MeasureGBps(pcmBytes, [&] {
+        for (int16_t sample : samples) {
+            uint16_t value = static_cast<uint16_t>(sample);
+            uint8_t be[2] = {static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value & 0xFF)};
+            nullStream.write(reinterpret_cast<const char*>(be), sizeof(be));
+        }
+    }));
+    // The double-precision loop SnrAccumulator runs during a predictor search.
+    double energy = 0.0;
+    Report("error sums", "double loop", MeasureGBps(pcmBytes * 2, [&] {
+        double signalEnergy = 0.0;
+        double noiseEnergy = 0.0;
+        for (size_t i = 0; i < kSampleCount; i++) {
+            double signal = samples[i];
+            double noise = signal - decoded[i];
+            signalEnergy += signal * signal;
+            noiseEnergy += noise * noise;
+        }
+        energy += signalEnergy + noiseEnergy;
+    }));
+
+    for (PcmIsa isa : {PcmIsa::Scalar, PcmIsa::Sse2, PcmIsa::Avx2, PcmIsa::Neon}) {
+        if (!SetPcmIsa(isa)) {
+            continue;
+        }
+        const char* name = PcmIsaName(isa);
+        Report("read s16le", name, MeasureGBps(pcmBytes, [&] { CopyS16LE(bytes.data(), samples.data(), kSampleCount); }));
+        Report("read s16be", name, MeasureGBps(pcmBytes, [&] { CopyS16BE(bytes.data(), samples.data(), kSampleCount); }));
+        Report("write s16be", name, MeasureGBps(pcmBytes, [&] {
+            StoreS16BE(samples.data(), outBytes.data(), kSampleCount);
+            nullStream.write(reinterpret_cast<const char*>(outBytes.data()), static_cast<std::streamsize>(outBytes.size()));
+        }));
+        Report("widen s16->s32", name, MeasureGBps(pcmBytes, [&] { WidenS16ToS32(samples.data(), wide.data(), kSampleCount); }));
+        Report("narrow s32->s16", name, MeasureGBps(pcmBytes * 2, [&] { NarrowS32ToS16(wide.data(), samples.data(), kSampleCount); }));
+        Report("widen s16->f32", name, MeasureGBps(pcmBytes, [&] { WidenS16ToF32(samples.data(), floats.data(), kSampleCount); }));
+        Report("narrow f32->s16", name, MeasureGBps(pcmBytes * 2, [&] { NarrowF32ToS16(floats.data(), samples.data(), kSampleCount); }));
+        Report("widen s24le->f32", name, MeasureGBps(kSampleCount * 3, [&] {
+            WidenS24LEToF32(wideBytes.data(), floats.data(), kSampleCount);
+        }));
+        Report("widen s32le->f32", name, MeasureGBps(kSampleCount * 4, [&] {
+            WidenS32LEToF32(wideBytes.data(), floats.data(), kSampleCount);
+        }));
+        Report("downmix stereo f32", name, MeasureGBps(kSampleCount * 4, [&] {
+            DownmixF32(floats.data(), floats.data(), kSampleCount / 2, 2);
+        }));
+        Report("peak blocks s16", name, MeasureGBps(pcmBytes, [&] {
+            PeakBlocksS16(samples.data(), reinterpret_cast<int16_t*>(wide.data()), kSampleCount / kPeakBlockSamples);
+        }));
+        Report("error sums", name, MeasureGBps(pcmBytes * 2, [&] {
+            PcmErrorSums sums;
+            AccumulatePcmError(samples.data(), decoded.data(), kSampleCount, sums);
+            energy += static_cast<double>(sums.noiseEnergy);
+        }));
+    }
+    // Keeps the error loops from being optimized away.
+    return energy < 0.0 ? 1 : 0;
+}
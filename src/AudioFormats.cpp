@@ -1,5 +1,11 @@
 #include "AudioFormats.h"
 
+#include "BinaryWriter.h"
+#include "PcmKernels.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <bit>
 #include <cmath>
 #include <cstring>
 #include <fstream>
@@ -32,28 +38,10 @@ static uint32_t ReadU32BE(const uint8_t* data) {
            static_cast<uint32_t>(data[3]);
 }
 
-static void WriteU16BE(std::ostream& out, uint16_t value) {
-    uint8_t bytes[2] = {
-        static_cast<uint8_t>((value >> 8) & 0xFF),
-        static_cast<uint8_t>(value & 0xFF),
-    };
-    out.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
-}
-
-static void WriteU32BE(std::ostream& out, uint32_t value) {
-    uint8_t bytes[4] = {
-        static_cast<uint8_t>((value >> 24) & 0xFF),
-        static_cast<uint8_t>((value >> 16) & 0xFF),
-        static_cast<uint8_t>((value >> 8) & 0xFF),
-        static_cast<uint8_t>(value & 0xFF),
-    };
-    out.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
-}
-
-static void WriteExtended80(std::ostream& out, uint32_t sampleRate) {
+static void PutExtended80(BinaryWriter& out, uint32_t sampleRate) {
     uint8_t bytes[10] = {};
     if (sampleRate == 0) {
-        out.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+        out.PutBytes(bytes, sizeof(bytes));
         return;
     }
 
@@ -69,7 +57,7 @@ static void WriteExtended80(std::ostream& out, uint32_t sampleRate) {
         bytes[2 + i] = static_cast<uint8_t>((mantissa >> (56 - i * 8)) & 0xFF);
     }
 
-    out.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+    out.PutBytes(bytes, sizeof(bytes));
 }
 
 static double ReadExtended80(const uint8_t* data) {
@@ -88,126 +76,486 @@ static double ReadExtended80(const uint8_t* data) {
     return std::ldexp(frac, exp);
 }
 
-static bool ReadFileBytes(const std::filesystem::path& path, std::vector<uint8_t>& out, std::string& error) {
-    std::ifstream file(path, std::ios::binary);
-    if (!file) {
-        error = "Failed to open file.";
-        return false;
+// Points out.samples at count 16-bit samples stored at data, converting into
+// out.converted only when the stored byte order differs from the host or the
+// data is misaligned.
+static void BindPcm16(const uint8_t* data, size_t count, bool bigEndian, PcmView& out) {
+    bool nativeOrder = (std::endian::native == std::endian::big) == bigEndian;
+    if (nativeOrder && reinterpret_cast<uintptr_t>(data) % alignof(int16_t) == 0) {
+        out.samples = std::span<const int16_t>(reinterpret_cast<const int16_t*>(data), count);
+        return;
     }
 
-    file.seekg(0, std::ios::end);
-    std::streamoff size = file.tellg();
-    file.seekg(0, std::ios::beg);
-    if (size < 0) {
-        error = "Invalid file size.";
-        return false;
+    out.converted.resize(count);
+    if (bigEndian) {
+        CopyS16BE(data, out.converted.data(), count);
+    } else {
+        CopyS16LE(data, out.converted.data(), count);
     }
+    out.samples = out.converted;
+}
 
-    out.resize(static_cast<size_t>(size));
-    if (!out.empty()) {
-        file.read(reinterpret_cast<char*>(out.data()), out.size());
+static void MovePcm(PcmView& view, std::vector<int16_t>& out) {
+    if (view.samples.data() == view.converted.data()) {
+        out = std::move(view.converted);
+    } else {
+        out.assign(view.samples.begin(), view.samples.end());
     }
+    view.samples = {};
+}
 
-    if (!file) {
-        error = "Failed to read file.";
+static constexpr uint16_t kWavFormatPcm = 1;
+static constexpr uint16_t kWavFormatFloat = 3;
+static constexpr uint16_t kWavFormatExtensible = 0xFFFE;
+// Frames are averaged through a block of this many values, which bounds
+// the channel count.
+static constexpr size_t kWavBlockValues = 4096;
+static constexpr uint16_t kMaxWavChannels = 64;
+// Any seed works; a fixed one keeps conversions reproducible.
+static constexpr uint32_t kDitherSeed = 0x2545F491;
+
+// Reads a fmt chunk body of size bytes and checks it is a layout we convert.
+static bool ParseWavFormat(const uint8_t* body, uint32_t size, WavFormat& format, std::string& error) {
+    if (size < 16) {
+        error = "Invalid fmt chunk.";
+        return false;
+    }
+    uint16_t formatTag = ReadU16LE(body);
+    format.channelCount = ReadU16LE(body + 2);
+    format.blockAlign = ReadU16LE(body + 12);
+    format.bitsPerSample = ReadU16LE(body + 14);
+    if (formatTag == kWavFormatExtensible) {
+        // The subformat GUID at offset 24 starts with the plain format tag;
+        // the rest is the same for every tag we accept.
+        static constexpr uint8_t kGuidTail[14] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80,
+                                                  0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+        if (size < 40) {
+            error = "Invalid fmt chunk.";
+            return false;
+        }
+        if (std::memcmp(body + 26, kGuidTail, sizeof(kGuidTail)) != 0) {
+            error = "Unsupported WAV subformat.";
+            return false;
+        }
+        formatTag = ReadU16LE(body + 24);
+    }
+
+    if (formatTag != kWavFormatPcm && formatTag != kWavFormatFloat) {
+        error = "WAV must be PCM or IEEE float.";
+        return false;
+    }
+    format.isFloat = formatTag == kWavFormatFloat;
+    uint16_t bits = format.bitsPerSample;
+    bool bitsOk = format.isFloat ? bits == 32 : (bits == 8 || bits == 16 || bits == 24 || bits == 32);
+    if (!bitsOk) {
+        error = "Unsupported WAV bit depth: " + std::to_string(bits) + ".";
+        return false;
+    }
+    if (format.channelCount == 0 || format.channelCount > kMaxWavChannels) {
+        error = "WAV must have 1 to " + std::to_string(kMaxWavChannels) + " channels.";
+        return false;
+    }
+    if (format.blockAlign != format.channelCount * (bits / 8)) {
+        error = "Invalid WAV block alignment.";
         return false;
     }
     return true;
 }
 
-bool ReadWavFile(const std::filesystem::path& path, WavData& out, std::string& error) {
-    std::vector<uint8_t> bytes;
-    if (!ReadFileBytes(path, bytes, error)) {
+static bool IsMonoPcm16(const WavFormat& format) {
+    return !format.isFloat && format.bitsPerSample == 16 && format.channelCount == 1;
+}
+
+// Rounding to 16 bits only throws information away for wider or float
+// samples and for downmixes.
+static bool NeedsDither(const WavFormat& format) {
+    return format.isFloat || format.bitsPerSample > 16 || format.channelCount > 1;
+}
+
+static uint32_t NextDitherValue(uint32_t& state) {
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+// Triangular noise spanning one 16-bit step either side of zero: the
+// difference of two uniform 24-bit values.
+static void AddDither(float* values, size_t count, uint32_t& state) {
+    constexpr float kScale = 1.0f / (16777216.0f * 32768.0f);
+    for (size_t i = 0; i < count; i++) {
+        int32_t a = static_cast<int32_t>(NextDitherValue(state) >> 8);
+        int32_t b = static_cast<int32_t>(NextDitherValue(state) >> 8);
+        values[i] += static_cast<float>(a - b) * kScale;
+    }
+}
+
+// Widens count little-endian values of format to floats in [-1, 1).
+static void UnpackWavValues(const uint8_t* src, size_t count, const WavFormat& format, float* dst) {
+    switch (format.bitsPerSample) {
+        case 8:
+            // Unsigned, centred on 128.
+            for (size_t i = 0; i < count; i++) {
+                dst[i] = static_cast<float>(static_cast<int>(src[i]) - 128) * (1.0f / 128.0f);
+            }
+            break;
+        case 16: {
+            int16_t pcm[kWavBlockValues];
+            CopyS16LE(src, pcm, count);
+            WidenS16ToF32(pcm, dst, count);
+            break;
+        }
+        case 24:
+            WidenS24LEToF32(src, dst, count);
+            break;
+        case 32:
+            if (!format.isFloat) {
+                WidenS32LEToF32(src, dst, count);
+            } else if constexpr (std::endian::native == std::endian::little) {
+                std::memcpy(dst, src, count * sizeof(float));
+            } else {
+                for (size_t i = 0; i < count; i++) {
+                    dst[i] = std::bit_cast<float>(ReadU32LE(src + i * 4));
+                }
+            }
+            break;
+    }
+}
+
+// Converts frameCount interleaved frames to mono 16-bit samples a block at
+// a time, so the float intermediate stays in cache: unpack, average the
+// channels, dither when ditherState is set, then round and saturate.
+static void ConvertWavFrames(const uint8_t* src,
+                             size_t frameCount,
+                             const WavFormat& format,
+                             uint32_t* ditherState,
+                             int16_t* dst) {
+    float block[kWavBlockValues];
+    size_t channelCount = format.channelCount;
+    size_t blockFrames = kWavBlockValues / channelCount;
+    for (size_t first = 0; first < frameCount; first += blockFrames) {
+        size_t frames = std::min(blockFrames, frameCount - first);
+        UnpackWavValues(src + first * format.blockAlign, frames * channelCount, format, block);
+        if (channelCount > 1) {
+            DownmixF32(block, block, frames, channelCount);
+        }
+        if (ditherState) {
+            AddDither(block, frames, *ditherState);
+        }
+        NarrowF32ToS16(block, dst + first, frames);
+    }
+}
+
+bool OpenWavView(const std::filesystem::path& path, PcmView& out, std::string& error, bool dither) {
+    ScopedStageTimer timer(ProfileStage::Read);
+    if (!out.file.Open(path, error)) {
         return false;
     }
-    if (bytes.size() < 12) {
+    const uint8_t* bytes = out.file.GetData();
+    size_t byteCount = out.file.GetSize();
+    if (byteCount < 12) {
         error = "WAV header too small.";
         return false;
     }
 
-    if (std::memcmp(bytes.data(), "RIFF", 4) != 0 || std::memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+    if (std::memcmp(bytes, "RIFF", 4) != 0 || std::memcmp(bytes + 8, "WAVE", 4) != 0) {
         error = "Not a RIFF/WAVE file.";
         return false;
     }
 
-    uint16_t audioFormat = 0;
-    uint16_t numChannels = 0;
+    WavFormat format;
     uint32_t sampleRate = 0;
-    uint16_t bitsPerSample = 0;
-    uint32_t dataOffset = 0;
+    size_t dataOffset = 0;
     uint32_t dataSize = 0;
 
     size_t offset = 12;
-    while (offset + 8 <= bytes.size()) {
-        const uint8_t* chunk = bytes.data() + offset;
+    while (offset + 8 <= byteCount) {
+        const uint8_t* chunk = bytes + offset;
         uint32_t chunkSize = ReadU32LE(chunk + 4);
-        if (offset + 8 + chunkSize > bytes.size()) {
+        if (chunkSize > byteCount - offset - 8) {
             error = "Invalid chunk size.";
             return false;
         }
 
         if (std::memcmp(chunk, "fmt ", 4) == 0) {
-            if (chunkSize < 16) {
-                error = "Invalid fmt chunk.";
+            if (!ParseWavFormat(chunk + 8, chunkSize, format, error)) {
                 return false;
             }
-            audioFormat = ReadU16LE(chunk + 8);
-            numChannels = ReadU16LE(chunk + 10);
             sampleRate = ReadU32LE(chunk + 12);
-            bitsPerSample = ReadU16LE(chunk + 22);
         } else if (std::memcmp(chunk, "data", 4) == 0) {
-            dataOffset = static_cast<uint32_t>(offset + 8);
+            dataOffset = offset + 8;
             dataSize = chunkSize;
         }
 
-        offset += 8 + chunkSize;
+        offset += 8 + static_cast<size_t>(chunkSize);
         if (chunkSize & 1) {
             offset += 1;
         }
     }
 
-    if (audioFormat != 1) {
-        error = "WAV must be PCM format.";
+    if (format.channelCount == 0) {
+        error = "Missing fmt chunk.";
         return false;
     }
-    if (numChannels != 1) {
-        error = "WAV must be mono.";
+    if (dataOffset == 0 || dataSize == 0) {
+        error = "Missing data chunk.";
+        return false;
+    }
+    if (dataOffset + dataSize > byteCount) {
+        error = "Invalid data range.";
         return false;
     }
-    if (bitsPerSample != 16) {
-        error = "WAV must be 16-bit PCM.";
+    if (dataSize % format.blockAlign != 0) {
+        error = "Data size is not a whole number of frames.";
+        return false;
+    }
+
+    out.sampleRate = sampleRate;
+    size_t frameCount = dataSize / format.blockAlign;
+    if (IsMonoPcm16(format)) {
+        BindPcm16(bytes + dataOffset, frameCount, false, out);
+        return true;
+    }
+    uint32_t ditherState = kDitherSeed;
+    out.converted.resize(frameCount);
+    ConvertWavFrames(bytes + dataOffset, frameCount, format,
+                     dither && NeedsDither(format) ? &ditherState : nullptr, out.converted.data());
+    out.samples = out.converted;
+    return true;
+}
+
+// Walks the chunk headers of an open WAV, reading only fmt and smpl bodies,
+// and checks the format is one we convert.
+static bool ReadWavChunks(std::ifstream& file, WavInfo& info, uint64_t& dataOffset, std::string& error) {
+    file.seekg(0, std::ios::end);
+    std::streamoff fileSize = file.tellg();
+    file.seekg(0, std::ios::beg);
+    if (fileSize < 12) {
+        error = "WAV header too small.";
+        return false;
+    }
+
+    uint8_t header[12];
+    file.read(reinterpret_cast<char*>(header), sizeof(header));
+    if (!file || std::memcmp(header, "RIFF", 4) != 0 || std::memcmp(header + 8, "WAVE", 4) != 0) {
+        error = "Not a RIFF/WAVE file.";
+        return false;
+    }
+
+    uint32_t dataSize = 0;
+    dataOffset = 0;
+    info = WavInfo{};
+
+    uint64_t offset = 12;
+    while (offset + 8 <= static_cast<uint64_t>(fileSize)) {
+        // Header plus the longest fmt body we read.
+        uint8_t chunk[8 + 40];
+        file.seekg(static_cast<std::streamoff>(offset));
+        file.read(reinterpret_cast<char*>(chunk), 8);
+        if (!file) {
+            error = "Failed to read file.";
+            return false;
+        }
+        uint32_t chunkSize = ReadU32LE(chunk + 4);
+        if (offset + 8 + chunkSize > static_cast<uint64_t>(fileSize)) {
+            error = "Invalid chunk size.";
+            return false;
+        }
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0) {
+            uint32_t bodySize = std::min<uint32_t>(chunkSize, sizeof(chunk) - 8);
+            file.read(reinterpret_cast<char*>(chunk + 8), bodySize);
+            if (!file) {
+                error = "Failed to read file.";
+                return false;
+            }
+            if (!ParseWavFormat(chunk + 8, bodySize, info.format, error)) {
+                return false;
+            }
+            info.sampleRate = ReadU32LE(chunk + 12);
+        } else if (std::memcmp(chunk, "data", 4) == 0) {
+            dataOffset = offset + 8;
+            dataSize = chunkSize;
+        } else if (std::memcmp(chunk, "smpl", 4) == 0 && chunkSize >= 36 + 24) {
+            // 36-byte sampler header, then 24 bytes per loop; only the first
+            // loop is used.
+            uint8_t smpl[36 + 24];
+            file.read(reinterpret_cast<char*>(smpl), sizeof(smpl));
+            if (file && ReadU32LE(smpl + 28) > 0) {
+                uint32_t playCount = ReadU32LE(smpl + 36 + 20);
+                uint32_t maxCount = std::numeric_limits<int32_t>::max();
+                info.hasLoop = true;
+                info.loopStart = ReadU32LE(smpl + 36 + 8);
+                info.loopEnd = ReadU32LE(smpl + 36 + 12);
+                info.loopCount = playCount == 0 ? -1 : static_cast<int32_t>(std::min(playCount, maxCount));
+            }
+            file.clear();
+        }
+
+        offset += 8 + static_cast<uint64_t>(chunkSize);
+        if (chunkSize & 1) {
+            offset += 1;
+        }
+    }
+
+    if (info.format.channelCount == 0) {
+        error = "Missing fmt chunk.";
         return false;
     }
     if (dataOffset == 0 || dataSize == 0) {
         error = "Missing data chunk.";
         return false;
     }
-    if (dataOffset + dataSize > bytes.size()) {
-        error = "Invalid data range.";
+    if (dataSize % info.format.blockAlign != 0) {
+        error = "Data size is not a whole number of frames.";
         return false;
     }
-    if (dataSize % 2 != 0) {
-        error = "Data size is not 16-bit aligned.";
+    info.sampleCount = dataSize / info.format.blockAlign;
+    return true;
+}
+
+bool WavStreamReader::Open(const std::filesystem::path& path, std::string& error, bool dither) {
+    ScopedStageTimer timer(ProfileStage::Read);
+    file = std::ifstream(path, std::ios::binary);
+    if (!file) {
+        error = "Failed to open file.";
         return false;
     }
 
-    out.sampleRate = sampleRate;
-    out.samples.resize(dataSize / 2);
-    for (size_t i = 0; i < out.samples.size(); i++) {
-        const uint8_t* samplePtr = bytes.data() + dataOffset + i * 2;
-        out.samples[i] = static_cast<int16_t>(ReadU16LE(samplePtr));
+    WavInfo info;
+    if (!ReadWavChunks(file, info, dataOffset, error)) {
+        return false;
+    }
+    sampleRate = info.sampleRate;
+    sampleCount = info.sampleCount;
+    format = info.format;
+    this->dither = dither && NeedsDither(format);
+    if (!Rewind()) {
+        error = "Failed to read file.";
+        return false;
     }
+    return true;
+}
+
+bool ProbeWavFile(const std::filesystem::path& path, WavInfo& out, std::string& error) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "Failed to open file.";
+        return false;
+    }
+    uint64_t dataOffset = 0;
+    return ReadWavChunks(file, out, dataOffset, error);
+}
+
+bool WavStreamReader::Rewind() {
+    file.clear();
+    file.seekg(static_cast<std::streamoff>(dataOffset));
+    position = 0;
+    // Restarting the noise makes every pass read the same samples.
+    ditherState = kDitherSeed;
+    return static_cast<bool>(file);
+}
+
+size_t WavStreamReader::Read(int16_t* out, size_t count) {
+    ScopedStageTimer timer(ProfileStage::Read);
+    uint64_t remaining = sampleCount - position;
+    if (count > remaining) {
+        count = static_cast<size_t>(remaining);
+    }
+    if (count == 0) {
+        return 0;
+    }
+
+    if (IsMonoPcm16(format)) {
+        file.read(reinterpret_cast<char*>(out), static_cast<std::streamsize>(count * 2));
+        size_t read = static_cast<size_t>(file.gcount()) / 2;
+        CopyS16LE(reinterpret_cast<const uint8_t*>(out), out, read);
+        position += read;
+        return read;
+    }
+
+    frames.resize(count * format.blockAlign);
+    file.read(reinterpret_cast<char*>(frames.data()), static_cast<std::streamsize>(frames.size()));
+    size_t read = static_cast<size_t>(file.gcount()) / format.blockAlign;
+    ConvertWavFrames(frames.data(), read, format, dither ? &ditherState : nullptr, out);
+    position += read;
+    return read;
+}
 
+bool ReadWavFile(const std::filesystem::path& path, WavData& out, std::string& error) {
+    PcmView view;
+    if (!OpenWavView(path, view, error)) {
+        return false;
+    }
+    out.sampleRate = view.sampleRate;
+    MovePcm(view, out.samples);
     return true;
 }
 
-bool WriteAiffPcm(const std::filesystem::path& path, const WavData& wav, std::string& error) {
-    std::ofstream out(path, std::ios::binary);
-    if (!out) {
-        error = "Failed to open output file.";
+bool WriteWavFile(const std::filesystem::path& path, const WavData& wav, std::string& error) {
+    uint64_t dataBytes = static_cast<uint64_t>(wav.samples.size()) * 2;
+    // smpl chunk: 36-byte sampler header plus one 24-byte loop. A play count
+    // of 0 would read back as forever, so a loop played zero times is left
+    // out.
+    bool writeLoop = wav.hasLoop && wav.loopCount != 0;
+    uint32_t smplBytes = writeLoop ? 8 + 36 + 24 : 0;
+    if (dataBytes > 0xFFFFFFFFull - 36 - smplBytes) {
+        error = "WAV data is too long.";
+        return false;
+    }
+    if (writeLoop && (wav.loopStart > wav.loopEnd || wav.loopEnd >= wav.samples.size())) {
+        error = "Loop points are outside the WAV data.";
         return false;
     }
 
+    std::vector<uint8_t> bytes;
+    BinaryWriter out(bytes);
+    out.Reserve(44 + smplBytes + static_cast<size_t>(dataBytes));
+
+    out.PutTag("RIFF");
+    out.PutU32LE(static_cast<uint32_t>(36 + smplBytes + dataBytes));
+    out.PutTag("WAVE");
+
+    out.PutTag("fmt ");
+    out.PutU32LE(16);
+    out.PutU16LE(1);
+    out.PutU16LE(1);
+    out.PutU32LE(wav.sampleRate);
+    out.PutU32LE(wav.sampleRate * 2);
+    out.PutU16LE(2);
+    out.PutU16LE(16);
+
+    if (writeLoop) {
+        out.PutTag("smpl");
+        out.PutU32LE(36 + 24);
+        out.PutU32LE(0);
+        out.PutU32LE(0);
+        out.PutU32LE(wav.sampleRate ? 1000000000u / wav.sampleRate : 0);
+        out.PutU32LE(60);
+        out.PutU32LE(0);
+        out.PutU32LE(0);
+        out.PutU32LE(0);
+        out.PutU32LE(1);
+        out.PutU32LE(0);
+
+        out.PutU32LE(0);
+        out.PutU32LE(0);
+        out.PutU32LE(wav.loopStart);
+        out.PutU32LE(wav.loopEnd);
+        out.PutU32LE(0);
+        out.PutU32LE(wav.loopCount < 0 ? 0 : static_cast<uint32_t>(wav.loopCount));
+    }
+
+    out.PutTag("data");
+    out.PutU32LE(static_cast<uint32_t>(dataBytes));
+    out.PutS16LE(wav.samples);
+
+    std::span<const uint8_t> segments[] = {bytes};
+    return WriteFileSegments(path, segments, error);
+}
+
+bool WriteAiffPcm(const std::filesystem::path& path, const WavData& wav, std::string& error) {
     uint32_t numFrames = static_cast<uint32_t>(wav.samples.size());
     uint32_t dataBytes = numFrames * 2;
     uint32_t commChunkSize = 18;
@@ -215,45 +563,49 @@ bool WriteAiffPcm(const std::filesystem::path& path, const WavData& wav, std::st
 
     uint32_t formSize = 4 + (8 + commChunkSize) + (8 + ssndChunkSize);
 
-    out.write("FORM", 4);
-    WriteU32BE(out, formSize);
-    out.write("AIFF", 4);
-
-    out.write("COMM", 4);
-    WriteU32BE(out, commChunkSize);
-    WriteU16BE(out, 1);
-    WriteU32BE(out, numFrames);
-    WriteU16BE(out, 16);
-    WriteExtended80(out, wav.sampleRate);
-
-    out.write("SSND", 4);
-    WriteU32BE(out, ssndChunkSize);
-    WriteU32BE(out, 0);
-    WriteU32BE(out, 0);
-
-    for (int16_t sample : wav.samples) {
-        uint16_t be = static_cast<uint16_t>(sample);
-        WriteU16BE(out, be);
-    }
-
-    if (!out) {
-        error = "Failed to write AIFF data.";
+    std::vector<uint8_t> bytes;
+    BinaryWriter out(bytes);
+    out.Reserve(8 + static_cast<size_t>(formSize));
+
+    out.PutTag("FORM");
+    out.PutU32BE(formSize);
+    out.PutTag("AIFF");
+
+    out.PutTag("COMM");
+    out.PutU32BE(commChunkSize);
+    out.PutU16BE(1);
+    out.PutU32BE(numFrames);
+    out.PutU16BE(16);
+    PutExtended80(out, wav.sampleRate);
+
+    out.PutTag("SSND");
+    out.PutU32BE(ssndChunkSize);
+    out.PutU32BE(0);
+    out.PutU32BE(0);
+    out.PutS16BE(wav.samples);
+
+    std::span<const uint8_t> segments[] = {bytes};
+    if (!WriteFileSegments(path, segments, error)) {
+        if (error == "Failed to write output file.") {
+            error = "Failed to write AIFF data.";
+        }
         return false;
     }
-
     return true;
 }
 
-bool ReadAiffPcm(const std::filesystem::path& path, AiffPcm& out, std::string& error) {
-    std::vector<uint8_t> bytes;
-    if (!ReadFileBytes(path, bytes, error)) {
+bool OpenAiffView(const std::filesystem::path& path, PcmView& out, std::string& error) {
+    ScopedStageTimer timer(ProfileStage::Read);
+    if (!out.file.Open(path, error)) {
         return false;
     }
-    if (bytes.size() < 12 || std::memcmp(bytes.data(), "FORM", 4) != 0) {
+    const uint8_t* bytes = out.file.GetData();
+    size_t byteCount = out.file.GetSize();
+    if (byteCount < 12 || std::memcmp(bytes, "FORM", 4) != 0) {
         error = "Not an AIFF file.";
         return false;
     }
-    if (std::memcmp(bytes.data() + 8, "AIFF", 4) != 0) {
+    if (std::memcmp(bytes + 8, "AIFF", 4) != 0) {
         error = "Unsupported AIFF type.";
         return false;
     }
@@ -261,13 +613,14 @@ bool ReadAiffPcm(const std::filesystem::path& path, AiffPcm& out, std::string& e
     uint16_t numChannels = 0;
     uint16_t sampleSize = 0;
     uint32_t sampleRate = 0;
-    std::vector<uint8_t> soundData;
+    const uint8_t* soundData = nullptr;
+    size_t soundSize = 0;
 
     size_t offset = 12;
-    while (offset + 8 <= bytes.size()) {
-        const uint8_t* chunk = bytes.data() + offset;
+    while (offset + 8 <= byteCount) {
+        const uint8_t* chunk = bytes + offset;
         uint32_t chunkSize = ReadU32BE(chunk + 4);
-        if (offset + 8 + chunkSize > bytes.size()) {
+        if (chunkSize > byteCount - offset - 8) {
             error = "Invalid chunk size.";
             return false;
         }
@@ -293,10 +646,11 @@ bool ReadAiffPcm(const std::filesystem::path& path, AiffPcm& out, std::string& e
                 error = "Invalid SSND offset.";
                 return false;
             }
-            soundData.assign(chunkData + 8 + dataOffset, chunkData + 8 + dataSize);
+            soundData = chunkData + 8 + dataOffset;
+            soundSize = dataSize - dataOffset;
         }
 
-        offset += 8 + chunkSize;
+        offset += 8 + static_cast<size_t>(chunkSize);
         if (chunkSize & 1) {
             offset += 1;
         }
@@ -306,30 +660,39 @@ bool ReadAiffPcm(const std::filesystem::path& path, AiffPcm& out, std::string& e
         error = "AIFF must be mono 16-bit PCM.";
         return false;
     }
-    if (soundData.size() % 2 != 0) {
+    if (soundSize % 2 != 0) {
         error = "AIFF data is not 16-bit aligned.";
         return false;
     }
 
     out.sampleRate = sampleRate;
-    out.samples.resize(soundData.size() / 2);
-    for (size_t i = 0; i < out.samples.size(); i++) {
-        out.samples[i] = static_cast<int16_t>(ReadU16BE(soundData.data() + i * 2));
-    }
+    BindPcm16(soundData, soundSize / 2, true, out);
+    return true;
+}
 
+bool ReadAiffPcm(const std::filesystem::path& path, AiffPcm& out, std::string& error) {
+    PcmView view;
+    if (!OpenAiffView(path, view, error)) {
+        return false;
+    }
+    out.sampleRate = view.sampleRate;
+    MovePcm(view, out.samples);
     return true;
 }
 
 bool ReadAifcVadpcm(const std::filesystem::path& path, VadpcmAifc& out, std::string& error) {
-    std::vector<uint8_t> bytes;
-    if (!ReadFileBytes(path, bytes, error)) {
+    ScopedStageTimer timer(ProfileStage::Read);
+    MappedFile file;
+    if (!file.Open(path, error)) {
         return false;
     }
-    if (bytes.size() < 12 || std::memcmp(bytes.data(), "FORM", 4) != 0) {
+    const uint8_t* bytes = file.GetData();
+    size_t byteCount = file.GetSize();
+    if (byteCount < 12 || std::memcmp(bytes, "FORM", 4) != 0) {
         error = "Not an AIFC file.";
         return false;
     }
-    if (std::memcmp(bytes.data() + 8, "AIFC", 4) != 0) {
+    if (std::memcmp(bytes + 8, "AIFC", 4) != 0) {
         error = "Unsupported AIFC type.";
         return false;
     }
@@ -337,16 +700,17 @@ bool ReadAifcVadpcm(const std::filesystem::path& path, VadpcmAifc& out, std::str
     uint16_t numChannels = 0;
     uint16_t sampleSize = 0;
     uint32_t sampleRate = 0;
-    std::vector<uint8_t> soundData;
+    const uint8_t* soundData = nullptr;
+    size_t soundSize = 0;
     int order = 0;
     int predictors = 0;
     std::vector<int16_t> book;
 
     size_t offset = 12;
-    while (offset + 8 <= bytes.size()) {
-        const uint8_t* chunk = bytes.data() + offset;
+    while (offset + 8 <= byteCount) {
+        const uint8_t* chunk = bytes + offset;
         uint32_t chunkSize = ReadU32BE(chunk + 4);
-        if (offset + 8 + chunkSize > bytes.size()) {
+        if (chunkSize > byteCount - offset - 8) {
             error = "Invalid chunk size.";
             return false;
         }
@@ -372,7 +736,8 @@ bool ReadAifcVadpcm(const std::filesystem::path& path, VadpcmAifc& out, std::str
                 error = "Invalid SSND offset.";
                 return false;
             }
-            soundData.assign(chunkData + 8 + dataOffset, chunkData + 8 + dataSize);
+            soundData = chunkData + 8 + dataOffset;
+            soundSize = dataSize - dataOffset;
         } else if (std::memcmp(chunk, "APPL", 4) == 0) {
             if (chunkSize < 4) {
                 offset += 8 + chunkSize + (chunkSize & 1);
@@ -393,9 +758,7 @@ bool ReadAifcVadpcm(const std::filesystem::path& path, VadpcmAifc& out, std::str
                             size_t tableCount = static_cast<size_t>(order) * predictors * 8;
                             if (dataLen >= 6 + tableCount * 2) {
                                 book.resize(tableCount);
-                                for (size_t i = 0; i < tableCount; i++) {
-                                    book[i] = static_cast<int16_t>(ReadU16BE(data + 6 + i * 2));
-                                }
+                                CopyS16BE(data + 6, book.data(), tableCount);
                             }
                         }
                     }
@@ -403,7 +766,7 @@ bool ReadAifcVadpcm(const std::filesystem::path& path, VadpcmAifc& out, std::str
             }
         }
 
-        offset += 8 + chunkSize;
+        offset += 8 + static_cast<size_t>(chunkSize);
         if (chunkSize & 1) {
             offset += 1;
         }
@@ -413,7 +776,7 @@ bool ReadAifcVadpcm(const std::filesystem::path& path, VadpcmAifc& out, std::str
         error = "AIFC must be mono 16-bit.";
         return false;
     }
-    if (soundData.empty()) {
+    if (soundSize == 0) {
         error = "Missing SSND chunk.";
         return false;
     }
@@ -423,7 +786,7 @@ bool ReadAifcVadpcm(const std::filesystem::path& path, VadpcmAifc& out, std::str
     }
 
     out.sampleRate = sampleRate;
-    out.adpcmData = std::move(soundData);
+    out.adpcmData.assign(soundData, soundData + soundSize);
     out.order = order;
     out.predictors = predictors;
     out.book = std::move(book);
@@ -441,35 +804,49 @@ static std::string VadpcmErrorString(vadpcm_error err) {
 }
 
 bool EncodeVadpcm(const WavData& wav, int predictorCount, VadpcmAifc& out, std::string& error) {
+    return EncodeVadpcm(wav.samples, wav.sampleRate, predictorCount, out, error);
+}
+
+bool EncodeVadpcm(std::span<const int16_t> samples,
+                  uint32_t sampleRate,
+                  int predictorCount,
+                  VadpcmAifc& out,
+                  std::string& error,
+                  std::vector<int16_t>* padded) {
     if (predictorCount < 1 || predictorCount > kVADPCMMaxPredictorCount) {
         error = "Predictor count must be between 1 and 16.";
         return false;
     }
 
-    size_t totalSamples = wav.samples.size();
+    size_t totalSamples = samples.size();
     size_t frameCount = (totalSamples + kVADPCMFrameSampleCount - 1) / kVADPCMFrameSampleCount;
     size_t paddedSamples = frameCount * kVADPCMFrameSampleCount;
     size_t encodedBytes = frameCount * kVADPCMFrameByteSize;
     size_t codebookVecs = static_cast<size_t>(predictorCount) * kVADPCMEncodeOrder;
 
-    std::vector<vadpcm_vector> codebook(codebookVecs);
-    std::vector<uint8_t> encoded(encodedBytes);
+    vadpcm_vector codebook[kVADPCMMaxPredictorCount * kVADPCMEncodeOrder];
+    out.adpcmData.resize(encodedBytes);
 
     vadpcm_params params{};
     params.predictor_count = predictorCount;
 
-    std::vector<int16_t> input;
+    // The encoder reads whole frames, so only a ragged tail forces a copy.
+    std::vector<int16_t> localInput;
+    std::vector<int16_t>& input = padded ? *padded : localInput;
     const int16_t* inputPtr = nullptr;
-    if (paddedSamples > 0) {
-        input = wav.samples;
-        input.resize(paddedSamples, 0);
+    if (paddedSamples == totalSamples) {
+        inputPtr = samples.data();
+    } else {
+        input.resize(paddedSamples);
+        std::copy(samples.begin(), samples.end(), input.begin());
+        std::fill(input.begin() + static_cast<ptrdiff_t>(totalSamples), input.end(), int16_t(0));
         inputPtr = input.data();
     }
 
     vadpcm_error err = vadpcm_encode(&params,
-                                     codebook.data(),
+                                     codebook,
                                      frameCount,
-                                     encoded.data(),
+                                     out.adpcmData.data(),
                                      inputPtr,
                                      nullptr);
     if (err != kVADPCMErrNone) {
@@ -477,65 +854,90 @@ bool EncodeVadpcm(const WavData& wav, int predictorCount, VadpcmAifc& out, std::
         return false;
     }
 
-    size_t bookCount = codebookVecs * kVADPCMVectorSampleCount;
-    std::vector<int16_t> book(bookCount);
+    out.book.resize(codebookVecs * kVADPCMVectorSampleCount);
     for (size_t i = 0; i < codebookVecs; i++) {
         for (size_t j = 0; j < kVADPCMVectorSampleCount; j++) {
-            book[i * kVADPCMVectorSampleCount + j] = codebook[i].v[j];
+            out.book[i * kVADPCMVectorSampleCount + j] = codebook[i].v[j];
         }
     }
 
-    out.sampleRate = wav.sampleRate;
-    out.adpcmData = std::move(encoded);
+    out.sampleRate = sampleRate;
     out.order = kVADPCMEncodeOrder;
     out.predictors = predictorCount;
-    out.book = std::move(book);
     return true;
 }
 
 bool DecodeVadpcm(const VadpcmAifc& vadpcm, std::vector<int16_t>& outSamples, std::string& error) {
-    if (vadpcm.order <= 0 || vadpcm.predictors <= 0) {
+    return DecodeVadpcmPrefix(vadpcm, SIZE_MAX, outSamples, error);
+}
+
+bool DecodeVadpcmPrefix(const VadpcmAifc& vadpcm,
+                        size_t frameCount,
+                        std::vector<int16_t>& outSamples,
+                        std::string& error) {
+    return DecodeVadpcmFrames(vadpcm.adpcmData, vadpcm.order, vadpcm.predictors, vadpcm.book, frameCount, outSamples,
+                              error);
+}
+
+bool DecodeVadpcmFrames(std::span<const uint8_t> adpcmData,
+                        int order,
+                        int predictors,
+                        std::span<const int16_t> book,
+                        size_t frameCount,
+                        std::vector<int16_t>& outSamples,
+                        std::string& error) {
+    if (order <= 0 || predictors <= 0 || order > kVADPCMMaxOrder || predictors > kVADPCMMaxPredictorCount) {
         error = "Invalid VADPCM codebook.";
         return false;
     }
-    if (vadpcm.adpcmData.size() % kVADPCMFrameByteSize != 0) {
+    if (adpcmData.size() % kVADPCMFrameByteSize != 0) {
         error = "Invalid VADPCM data size.";
         return false;
     }
-    size_t expectedBook = static_cast<size_t>(vadpcm.order) *
-                          static_cast<size_t>(vadpcm.predictors) *
-                          kVADPCMVectorSampleCount;
-    if (vadpcm.book.size() < expectedBook) {
+    size_t expectedBook = static_cast<size_t>(order) * static_cast<size_t>(predictors) * kVADPCMVectorSampleCount;
+    if (book.size() < expectedBook) {
         error = "VADPCM codebook is incomplete.";
         return false;
     }
 
-    size_t codebookVecs = static_cast<size_t>(vadpcm.order) *
-                          static_cast<size_t>(vadpcm.predictors);
-    std::vector<vadpcm_vector> codebook(codebookVecs);
+    size_t codebookVecs = static_cast<size_t>(order) * static_cast<size_t>(predictors);
+    vadpcm_vector codebook[kVADPCMMaxOrder * kVADPCMMaxPredictorCount];
     for (size_t i = 0; i < codebookVecs; i++) {
         for (size_t j = 0; j < kVADPCMVectorSampleCount; j++) {
-            codebook[i].v[j] = vadpcm.book[i * kVADPCMVectorSampleCount + j];
+            codebook[i].v[j] = book[i * kVADPCMVectorSampleCount + j];
         }
     }
 
-    size_t frameCount = vadpcm.adpcmData.size() / kVADPCMFrameByteSize;
+    frameCount = std::min(frameCount, adpcmData.size() / kVADPCMFrameByteSize);
     outSamples.resize(frameCount * kVADPCMFrameSampleCount);
     if (frameCount == 0) {
         return true;
     }
 
     vadpcm_vector state{};
-    vadpcm_error err = vadpcm_decode(vadpcm.predictors,
-                                     vadpcm.order,
-                                     codebook.data(),
+    vadpcm_error err = vadpcm_decode(predictors,
+                                     order,
+                                     codebook,
                                      &state,
                                      frameCount,
                                      outSamples.data(),
-                                     vadpcm.adpcmData.data());
+                                     adpcmData.data());
     if (err != kVADPCMErrNone) {
         error = "VADPCM decode failed: " + VadpcmErrorString(err);
         return false;
     }
     return true;
 }
+
+bool IsVadpcmSilent(std::span<const uint8_t> adpcmData) {
+    // The first byte of each frame is the scale/predictor header; only the
+    // residual bytes decide whether anything is audible.
+    for (size_t offset = 0; offset + kVADPCMFrameByteSize <= adpcmData.size(); offset += kVADPCMFrameByteSize) {
+        for (size_t i = 1; i < kVADPCMFrameByteSize; i++) {
+            if (adpcmData[offset + i] != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
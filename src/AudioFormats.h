@@ -1,13 +1,59 @@
 #pragma once
 
+#include "MappedFile.h"
+
 #include <cstdint>
 #include <filesystem>
+#include <fstream>
+#include <span>
 #include <string>
 #include <vector>
 
 struct WavData {
     uint32_t sampleRate = 0;
     std::vector<int16_t> samples;
+    // Written as a smpl chunk when set, with the same meaning as WavInfo's
+    // loop fields, except that a loop count of 0 writes no loop: smpl
+    // spells forever that way.
+    bool hasLoop = false;
+    uint32_t loopStart = 0;
+    uint32_t loopEnd = 0;
+    int32_t loopCount = -1;
+};
+
+// PCM parsed in place from a memory-mapped file. samples points straight
+// into the mapping when the file's byte order matches the host and the data
+// is aligned; otherwise it points into converted, the only copy made. A view
+// can be opened again for the next file, which reuses converted's capacity.
+struct PcmView {
+    uint32_t sampleRate = 0;
+    std::span<const int16_t> samples;
+    MappedFile file;
+    std::vector<int16_t> converted;
+};
+
+// Layout of a WAV's frames, with WAVE_FORMAT_EXTENSIBLE resolved to its
+// subformat. Readers accept 8/16/24/32-bit integer and 32-bit float PCM with
+// any number of channels, and hand out mono 16-bit samples.
+struct WavFormat {
+    uint16_t channelCount = 0;
+    uint16_t bitsPerSample = 0;
+    bool isFloat = false;
+    // Bytes per frame.
+    uint16_t blockAlign = 0;
+};
+
+// What a WAV's chunk headers say about it.
+struct WavInfo {
+    uint32_t sampleRate = 0;
+    WavFormat format;
+    uint64_t sampleCount = 0;
+    // First loop of the smpl chunk, when the file has one. A play count of
+    // zero (forever) becomes -1.
+    bool hasLoop = false;
+    uint32_t loopStart = 0;
+    uint32_t loopEnd = 0;
+    int32_t loopCount = -1;
 };
 
 struct AiffPcm {
@@ -23,9 +69,80 @@ struct VadpcmAifc {
     std::vector<int16_t> book;
 };
 
+// Sequential reader for WAV data as mono 16-bit samples. Only the caller's
+// buffer (and one block of raw frames for other formats) is ever resident,
+// so it suits inputs too long to load whole.
+class WavStreamReader {
+public:
+    // See OpenWavView for dither.
+    bool Open(const std::filesystem::path& path, std::string& error, bool dither = false);
+
+    uint32_t GetSampleRate() const {
+        return sampleRate;
+    }
+    uint64_t GetSampleCount() const {
+        return sampleCount;
+    }
+
+    // Seeks back to the first sample.
+    bool Rewind();
+    // Reads up to count samples and returns how many were read; fewer than
+    // requested means the end of the data or a read error.
+    size_t Read(int16_t* out, size_t count);
+
+private:
+    std::ifstream file;
+    uint64_t dataOffset = 0;
+    uint64_t sampleCount = 0;
+    uint64_t position = 0;
+    uint32_t sampleRate = 0;
+    WavFormat format;
+    bool dither = false;
+    uint32_t ditherState = 0;
+    std::vector<uint8_t> frames;
+};
+
+// Mono 16-bit files are read in place; anything else is converted once into
+// out.converted (see PcmView), downmixing channels by averaging them. With dither set,
+// formats that lose precision on the way to 16 bits get TPDF dither; the
+// noise is seeded the same way every time, so a file always converts to
+// the same samples.
+bool OpenWavView(const std::filesystem::path& path, PcmView& out, std::string& error, bool dither = false);
+bool OpenAiffView(const std::filesystem::path& path, PcmView& out, std::string& error);
 bool ReadWavFile(const std::filesystem::path& path, WavData& out, std::string& error);
+// Reads only the chunk headers, so it costs the same for any length of
+// audio. Accepts the same files as OpenWavView.
+bool ProbeWavFile(const std::filesystem::path& path, WavInfo& out, std::string& error);
+// Mono 16-bit PCM WAV.
+bool WriteWavFile(const std::filesystem::path& path, const WavData& wav, std::string& error);
 bool WriteAiffPcm(const std::filesystem::path& path, const WavData& wav, std::string& error);
 bool ReadAiffPcm(const std::filesystem::path& path, AiffPcm& out, std::string& error);
 bool ReadAifcVadpcm(const std::filesystem::path& path, VadpcmAifc& out, std::string& error);
+// Writes into out's vectors, so encoding into the same VadpcmAifc again does
+// not allocate once it is large enough. Inputs that are not whole frames are
+// copied and zero-padded first, into padded when given.
+bool EncodeVadpcm(std::span<const int16_t> samples,
+                  uint32_t sampleRate,
+                  int predictorCount,
+                  VadpcmAifc& out,
+                  std::string& error,
+                  std::vector<int16_t>* padded = nullptr);
 bool EncodeVadpcm(const WavData& wav, int predictorCount, VadpcmAifc& out, std::string& error);
 bool DecodeVadpcm(const VadpcmAifc& vadpcm, std::vector<int16_t>& outSamples, std::string& error);
+// Decodes only the first frameCount frames (clamped to the data length).
+bool DecodeVadpcmPrefix(const VadpcmAifc& vadpcm,
+                        size_t frameCount,
+                        std::vector<int16_t>& outSamples,
+                        std::string& error);
+// DecodeVadpcmPrefix for a payload and codebook held elsewhere, e.g. in a
+// SohSampleView.
+bool DecodeVadpcmFrames(std::span<const uint8_t> adpcmData,
+                        int order,
+                        int predictors,
+                        std::span<const int16_t> book,
+                        size_t frameCount,
+                        std::vector<int16_t>& outSamples,
+                        std::string& error);
+// True when every residual in the stream is zero. Decoding starts from a
+// zero state, so this is exactly the case where every decoded sample is zero.
+bool IsVadpcmSilent(std::span<const uint8_t> adpcmData);
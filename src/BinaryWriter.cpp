@@ -0,0 +1,96 @@
+#include "BinaryWriter.h"
+
+#include "PcmKernels.h"
+
+#include <algorithm>
+#include <climits>
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+void BinaryWriter::PutS16LE(std::span<const int16_t> values) {
+    size_t offset = buffer.size();
+    buffer.resize(offset + values.size() * 2);
+    StoreS16LE(values.data(), buffer.data() + offset, values.size());
+}
+
+void BinaryWriter::PutS16BE(std::span<const int16_t> values) {
+    size_t offset = buffer.size();
+    buffer.resize(offset + values.size() * 2);
+    StoreS16BE(values.data(), buffer.data() + offset, values.size());
+}
+
+#ifdef _WIN32
+bool WriteFileSegments(const std::filesystem::path& path,
+                       std::span<const std::span<const uint8_t>> segments,
+                       std::string& error) {
+    std::ofstream out(path, std::ios::binary);
+    if (!out) {
+        error = "Failed to open output file.";
+        return false;
+    }
+    for (const auto& segment : segments) {
+        if (!segment.empty()) {
+            out.write(reinterpret_cast<const char*>(segment.data()), static_cast<std::streamsize>(segment.size()));
+        }
+    }
+    if (!out) {
+        error = "Failed to write output file.";
+        return false;
+    }
+    return true;
+}
+#else
+bool WriteFileSegments(const std::filesystem::path& path,
+                       std::span<const std::span<const uint8_t>> segments,
+                       std::string& error) {
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        error = "Failed to open output file.";
+        return false;
+    }
+
+    std::vector<iovec> iov;
+    iov.reserve(segments.size());
+    for (const auto& segment : segments) {
+        if (!segment.empty()) {
+            iov.push_back({const_cast<uint8_t*>(segment.data()), segment.size()});
+        }
+    }
+
+    // writev may stop early; resume from wherever it left off.
+    size_t index = 0;
+    while (index < iov.size()) {
+        ssize_t written = writev(fd, iov.data() + index, static_cast<int>(std::min<size_t>(iov.size() - index, IOV_MAX)));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            error = "Failed to write output file.";
+            return false;
+        }
+        size_t remaining = static_cast<size_t>(written);
+        while (index < iov.size() && remaining >= iov[index].iov_len) {
+            remaining -= iov[index].iov_len;
+            index++;
+        }
+        if (index < iov.size()) {
+            iov[index].iov_base = static_cast<uint8_t*>(iov[index].iov_base) + remaining;
+            iov[index].iov_len -= remaining;
+        }
+    }
+
+    if (close(fd) != 0) {
+        error = "Failed to write output file.";
+        return false;
+    }
+    return true;
+}
+#endif
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+// Appends fixed-width values to a byte buffer in either byte order. Callers
+// that know their output size up front should Reserve() it so the buffer is
+// filled without reallocating.
+class BinaryWriter {
+public:
+    explicit BinaryWriter(std::vector<uint8_t>& buffer) : buffer(buffer) {
+    }
+
+    void Reserve(size_t bytes) {
+        buffer.reserve(buffer.size() + bytes);
+    }
+    size_t GetSize() const {
+        return buffer.size();
+    }
+
+    void PutU8(uint8_t value) {
+        buffer.push_back(value);
+    }
+    void PutU16LE(uint16_t value) {
+        uint8_t bytes[2] = {
+            static_cast<uint8_t>(value & 0xFF),
+            static_cast<uint8_t>((value >> 8) & 0xFF),
+        };
+        PutBytes(bytes, sizeof(bytes));
+    }
+    void PutU32LE(uint32_t value) {
+        uint8_t bytes[4] = {
+            static_cast<uint8_t>(value & 0xFF),
+            static_cast<uint8_t>((value >> 8) & 0xFF),
+            static_cast<uint8_t>((value >> 16) & 0xFF),
+            static_cast<uint8_t>((value >> 24) & 0xFF),
+        };
+        PutBytes(bytes, sizeof(bytes));
+    }
+    void PutU64LE(uint64_t value) {
+        PutU32LE(static_cast<uint32_t>(value & 0xFFFFFFFF));
+        PutU32LE(static_cast<uint32_t>(value >> 32));
+    }
+    void PutU16BE(uint16_t value) {
+        uint8_t bytes[2] = {
+            static_cast<uint8_t>((value >> 8) & 0xFF),
+            static_cast<uint8_t>(value & 0xFF),
+        };
+        PutBytes(bytes, sizeof(bytes));
+    }
+    void PutU32BE(uint32_t value) {
+        uint8_t bytes[4] = {
+            static_cast<uint8_t>((value >> 24) & 0xFF),
+            static_cast<uint8_t>((value >> 16) & 0xFF),
+            static_cast<uint8_t>((value >> 8) & 0xFF),
+            static_cast<uint8_t>(value & 0xFF),
+        };
+        PutBytes(bytes, sizeof(bytes));
+    }
+    void PutTag(const char (&tag)[5]) {
+        PutBytes(tag, 4);
+    }
+    void PutBytes(const void* data, size_t size) {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        buffer.insert(buffer.end(), bytes, bytes + size);
+    }
+    void PutZeros(size_t count) {
+        buffer.resize(buffer.size() + count, 0);
+    }
+    // Pads with zeros up to an absolute offset in the buffer.
+    void PadTo(size_t offset) {
+        if (buffer.size() < offset) {
+            PutZeros(offset - buffer.size());
+        }
+    }
+
+    void PutS16LE(std::span<const int16_t> values);
+    void PutS16BE(std::span<const int16_t> values);
+
+private:
+    std::vector<uint8_t>& buffer;
+};
+
+// Writes the segments to path back to back, with a single gathered write
+// where the platform supports it.
+bool WriteFileSegments(const std::filesystem::path& path,
+                       std::span<const std::span<const uint8_t>> segments,
+                       std::string& error);
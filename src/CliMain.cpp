@@ -0,0 +1,777 @@
+#include "ConversionCache.h"
+#include "ConversionDedup.h"
+#include "ConversionManifest.h"
+#include "Convert.h"
+#include "ConvertBuffers.h"
+#include "DirectoryScan.h"
+#include "LoopFinder.h"
+#include "O2rArchive.h"
+#include "PathUtils.h"
+#include "Profiler.h"
+#include "QualityReport.h"
+#include "SampleExport.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <vector>
+
+enum ExitCode {
+    kExitOk = 0,
+    kExitConvertFailed = 1,
+    kExitUsage = 2,
+};
+
+struct CliOptions {
+    std::filesystem::path outputDir;
+    std::filesystem::path archivePath;
+    std::string resourcePrefix = kDefaultSampleResourcePrefix;
+    ConvertOptions convert;
+    std::filesystem::path cacheDir;
+    uint64_t cacheMaxBytes = 1024ull * 1024 * 1024;
+    std::filesystem::path tracePath;
+    std::filesystem::path reportPath;
+    QualitySortKey reportSort = QualitySortKey::Snr;
+    size_t jobCount = 0;
+    bool quiet = false;
+    std::vector<ConvertJob> jobs;
+    // Per job: search for its loop points before converting.
+    std::vector<char> autoLoop;
+    // --extract decodes samples back to WAV instead of converting.
+    bool extract = false;
+    uint32_t wavRate = kDefaultExportRate;
+    std::vector<ExportJob> exportJobs;
+};
+
+struct LoopSettings {
+    bool enabled = false;
+    uint32_t start = 0;
+    uint32_t end = 0;
+    int32_t count = -1;
+    // --auto-loop: search for the points, around end when it is set.
+    bool automatic = false;
+};
+
+static void PrintUsage(FILE* out) {
+    std::fputs(
+        "Usage: SoH-AudioTool-cli (-o <output folder> | --archive <file.o2r>) [options] <input>...\n"
+        "       SoH-AudioTool-cli --extract -o <output folder> [--wav-rate HZ] [-j N] [-q] <sample>...\n"
+        "\n"
+        "Inputs are WAV files or folders, which are searched recursively; outputs\n"
+        "keep the folder's subfolder layout. Options that describe a sample\n"
+        "(--name, --loop, --auto-loop, --no-loop, --rate) apply to the inputs that follow them.\n"
+        "\n"
+        "With --extract, inputs are converted sample files or folders of them, and\n"
+        "each is decoded to a 16-bit WAV with its loop points in a smpl chunk.\n"
+        "\n"
+        "  -o, --output DIR        Output folder\n"
+        "      --archive FILE      Write samples into this .o2r mod archive instead of a\n"
+        "                          folder, replacing only entries that changed\n"
+        "      --resource-prefix P Folder for samples inside the archive (default audio/samples/)\n"
+        "  -p, --predictors N      VADPCM predictor count, 1..16 (default 4)\n"
+        "      --target-snr DB     Use the fewest predictors (up to -p, default 16) whose\n"
+        "                          round-trip SNR reaches DB\n"
+        "  -j, --jobs N            Worker threads (default: one per core)\n"
+        "      --loop S:E:C        Loop from sample S to E, C times (E 0 = last sample, C -1 = infinite)\n"
+        "      --auto-loop         Search the inputs that follow for their smoothest frame-aligned\n"
+        "                          loop, ending at the --loop end if one was given\n"
+        "      --no-loop           Disable looping for the inputs that follow\n"
+        "      --rate HZ           Resample the inputs that follow to HZ before encoding (0 = keep\n"
+        "                          each WAV's rate); loop points stay in input samples\n"
+        "      --name NAME         Output name for the next input (default: input file stem)\n"
+        "      --list FILE         Read jobs from FILE, one per line:\n"
+        "                          input<TAB>name[<TAB>loopStart<TAB>loopEnd<TAB>loopCount]\n"
+        "      --cache DIR         Reuse finished samples stored in DIR across runs\n"
+        "      --cache-size MB     Evict least recently used cache entries past MB (default 1024)\n"
+        "      --rebuild           Convert every input, even those the manifest shows as up to date\n"
+        "      --dither            Add TPDF dither when stereo, 24/32-bit or float WAVs are\n"
+        "                          reduced to mono 16-bit\n"
+        "      --verify            Decode every output again and check it (slower)\n"
+        "      --report FILE       After converting, decode every output and write its SNR,\n"
+        "                          peak error, clipping and DC offset to FILE (.csv or .json)\n"
+        "      --report-sort KEY   Report order, worst first: snr (default), peak, clip, dc or name\n"
+        "      --profile           Print per-stage timing percentiles at the end\n"
+        "      --extract           Decode sample files back to WAV instead of converting\n"
+        "      --wav-rate HZ       Sample rate written to extracted WAVs (default 32000)\n"
+        "      --trace FILE        Write a Chrome trace-event JSON of every stage to FILE\n"
+        "  -q, --quiet             Only report failures\n"
+        "  -h, --help              Show this help\n"
+        "\n"
+        "Exit status: 0 if every sample converted, 1 if any failed, 2 on usage errors.\n",
+        out);
+}
+
+static bool ParseInt(const std::string& text, long long minValue, long long maxValue, long long& out) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    long long value = std::strtoll(text.c_str(), &end, 10);
+    if (!end || *end != '\0' || value < minValue || value > maxValue) {
+        return false;
+    }
+    out = value;
+    return true;
+}
+
+static bool ParseDouble(const std::string& text, double minValue, double maxValue, double& out) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    double value = std::strtod(text.c_str(), &end);
+    if (!end || *end != '\0' || !(value >= minValue && value <= maxValue)) {
+        return false;
+    }
+    out = value;
+    return true;
+}
+
+static std::string DescribeChoice(const PredictorChoice& choice) {
+    char text[96];
+    if (std::isinf(choice.snrDb) && choice.snrDb > 0) {
+        std::snprintf(text, sizeof(text), " (%d predictors, lossless)", choice.predictorCount);
+    } else {
+        std::snprintf(text, sizeof(text), " (%d predictors, %.1f dB%s)", choice.predictorCount, choice.snrDb,
+                      choice.metTarget ? "" : ", below target");
+    }
+    return text;
+}
+
+static bool ParseSortKey(const std::string& text, QualitySortKey& out) {
+    static const std::pair<const char*, QualitySortKey> kKeys[] = {
+        {"snr", QualitySortKey::Snr},
+        {"peak", QualitySortKey::PeakError},
+        {"clip", QualitySortKey::Clipping},
+        {"dc", QualitySortKey::DcOffset},
+        {"name", QualitySortKey::Name},
+    };
+    for (const auto& [name, key] : kKeys) {
+        if (text == name) {
+            out = key;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool ParseLoop(const std::string& text, LoopSettings& out) {
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, ':')) {
+        parts.push_back(part);
+    }
+    if (parts.size() < 2 || parts.size() > 3) {
+        return false;
+    }
+
+    long long start = 0;
+    long long end = 0;
+    long long count = -1;
+    if (!ParseInt(parts[0], 0, UINT32_MAX, start) || !ParseInt(parts[1], 0, UINT32_MAX, end)) {
+        return false;
+    }
+    if (parts.size() == 3 && !ParseInt(parts[2], INT32_MIN, INT32_MAX, count)) {
+        return false;
+    }
+
+    out.enabled = true;
+    out.automatic = false;
+    out.start = static_cast<uint32_t>(start);
+    out.end = static_cast<uint32_t>(end);
+    out.count = static_cast<int32_t>(count);
+    return true;
+}
+
+static ConvertJob MakeJob(const std::filesystem::path& input,
+                          const std::string& name,
+                          const LoopSettings& loop,
+                          uint32_t targetRate) {
+    ConvertJob job;
+    job.inputPath = input;
+    job.outputName = name.empty() ? DefaultOutputName(input) : name;
+    job.loopEnabled = loop.enabled;
+    job.loopStart = loop.start;
+    job.loopEnd = loop.end;
+    job.loopCount = loop.count;
+    job.targetSampleRate = targetRate;
+    return job;
+}
+
+// Lists a folder input, sorted so jobs run in a stable order.
+static bool ScanInputFolder(const std::filesystem::path& input,
+                            const std::string& pendingName,
+                            ScanTarget target,
+                            std::vector<ScannedFile>& found) {
+    if (!pendingName.empty()) {
+        std::fprintf(stderr, "--name cannot be used with a folder input: %s\n", PathToUtf8(input).c_str());
+        return false;
+    }
+    DirectoryScan scan(input, 0, target);
+    scan.Wait();
+    std::vector<std::string> errors = scan.GetErrors();
+    for (const auto& error : errors) {
+        std::fprintf(stderr, "Failed to list folder %s\n", error.c_str());
+    }
+    if (!errors.empty()) {
+        return false;
+    }
+    found = scan.TakeFiles();
+    std::sort(found.begin(), found.end(), [](const ScannedFile& a, const ScannedFile& b) { return a.path < b.path; });
+    return true;
+}
+
+static bool AddInput(const std::filesystem::path& input,
+                     std::string& pendingName,
+                     const LoopSettings& loop,
+                     uint32_t targetRate,
+                     std::vector<ConvertJob>& jobs) {
+    std::error_code ec;
+    if (std::filesystem::is_directory(input, ec)) {
+        std::vector<ScannedFile> found;
+        if (!ScanInputFolder(input, pendingName, ScanTarget::Wav, found)) {
+            return false;
+        }
+        for (const auto& file : found) {
+            jobs.push_back(MakeJob(file.path, file.outputName, loop, targetRate));
+        }
+        return true;
+    }
+
+    jobs.push_back(MakeJob(input, pendingName, loop, targetRate));
+    pendingName.clear();
+    return true;
+}
+
+static bool AddExportInput(const std::filesystem::path& input, std::string& pendingName, std::vector<ExportJob>& jobs) {
+    std::error_code ec;
+    if (std::filesystem::is_directory(input, ec)) {
+        std::vector<ScannedFile> found;
+        if (!ScanInputFolder(input, pendingName, ScanTarget::SohSample, found)) {
+            return false;
+        }
+        for (auto& file : found) {
+            jobs.push_back({std::move(file.path), std::move(file.outputName)});
+        }
+        return true;
+    }
+
+    jobs.push_back({input, pendingName.empty() ? PathToUtf8(input.filename()) : pendingName});
+    pendingName.clear();
+    return true;
+}
+
+static bool ReadJobList(const std::filesystem::path& listPath,
+                        const LoopSettings& loop,
+                        uint32_t targetRate,
+                        std::vector<ConvertJob>& jobs) {
+    std::ifstream file(listPath);
+    if (!file) {
+        std::fprintf(stderr, "Failed to open job list: %s\n", PathToUtf8(listPath).c_str());
+        return false;
+    }
+
+    std::string line;
+    size_t lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        std::vector<std::string> fields;
+        std::stringstream stream(line);
+        std::string field;
+        while (std::getline(stream, field, '\t')) {
+            fields.push_back(field);
+        }
+
+        LoopSettings lineLoop = loop;
+        if (fields.size() == 5) {
+            if (!ParseLoop(fields[2] + ":" + fields[3] + ":" + fields[4], lineLoop)) {
+                std::fprintf(stderr, "%s:%zu: invalid loop settings\n", PathToUtf8(listPath).c_str(), lineNumber);
+                return false;
+            }
+        } else if (fields.size() != 1 && fields.size() != 2) {
+            std::fprintf(stderr, "%s:%zu: expected 1, 2 or 5 tab-separated fields\n", PathToUtf8(listPath).c_str(), lineNumber);
+            return false;
+        }
+
+        std::filesystem::path input = Utf8ToPath(fields[0]);
+        if (input.is_relative()) {
+            input = listPath.parent_path() / input;
+        }
+        jobs.push_back(MakeJob(input, fields.size() >= 2 ? fields[1] : std::string(), lineLoop, targetRate));
+    }
+    return true;
+}
+
+static std::optional<ExitCode> ParseArgs(int argc, char** argv, CliOptions& options) {
+    LoopSettings loop;
+    uint32_t targetRate = 0;
+    std::string pendingName;
+    bool sawOutput = false;
+    bool sawPredictors = false;
+    // Known up front, since it changes what the inputs are.
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--extract") {
+            options.extract = true;
+        }
+    }
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto nextValue = [&](const char* name) -> const char* {
+            if (i + 1 >= argc) {
+                std::fprintf(stderr, "%s requires a value.\n", name);
+                return nullptr;
+            }
+            return argv[++i];
+        };
+
+        if (arg == "-h" || arg == "--help") {
+            PrintUsage(stdout);
+            return kExitOk;
+        } else if (arg == "-o" || arg == "--output") {
+            const char* value = nextValue("--output");
+            if (!value) {
+                return kExitUsage;
+            }
+            options.outputDir = Utf8ToPath(value);
+            sawOutput = true;
+        } else if (arg == "--archive") {
+            const char* value = nextValue("--archive");
+            if (!value) {
+                return kExitUsage;
+            }
+            options.archivePath = Utf8ToPath(value);
+        } else if (arg == "--resource-prefix") {
+            const char* value = nextValue("--resource-prefix");
+            if (!value) {
+                return kExitUsage;
+            }
+            options.resourcePrefix = value;
+            if (!options.resourcePrefix.empty() && options.resourcePrefix.back() != '/') {
+                options.resourcePrefix += '/';
+            }
+        } else if (arg == "-p" || arg == "--predictors") {
+            const char* value = nextValue("--predictors");
+            long long count = 0;
+            if (!value || !ParseInt(value, 1, 16, count)) {
+                std::fprintf(stderr, "--predictors must be between 1 and 16.\n");
+                return kExitUsage;
+            }
+            options.convert.predictorCount = static_cast<int>(count);
+            sawPredictors = true;
+        } else if (arg == "--target-snr") {
+            const char* value = nextValue("--target-snr");
+            if (!value || !ParseDouble(value, 1.0, 200.0, options.convert.targetSnrDb)) {
+                std::fprintf(stderr, "--target-snr must be between 1 and 200 dB.\n");
+                return kExitUsage;
+            }
+        } else if (arg == "-j" || arg == "--jobs") {
+            const char* value = nextValue("--jobs");
+            long long count = 0;
+            if (!value || !ParseInt(value, 1, 1024, count)) {
+                std::fprintf(stderr, "--jobs must be between 1 and 1024.\n");
+                return kExitUsage;
+            }
+            options.jobCount = static_cast<size_t>(count);
+        } else if (arg == "--loop") {
+            const char* value = nextValue("--loop");
+            if (!value || !ParseLoop(value, loop)) {
+                std::fprintf(stderr, "--loop expects START:END[:COUNT].\n");
+                return kExitUsage;
+            }
+        } else if (arg == "--auto-loop") {
+            loop.enabled = true;
+            loop.automatic = true;
+        } else if (arg == "--no-loop") {
+            loop = LoopSettings{};
+        } else if (arg == "--rate") {
+            const char* value = nextValue("--rate");
+            long long rate = 0;
+            if (!value || !ParseInt(value, 0, 768000, rate)) {
+                std::fprintf(stderr, "--rate must be between 0 and 768000 Hz.\n");
+                return kExitUsage;
+            }
+            targetRate = static_cast<uint32_t>(rate);
+        } else if (arg == "--name") {
+            const char* value = nextValue("--name");
+            if (!value) {
+                return kExitUsage;
+            }
+            pendingName = value;
+        } else if (arg == "--list") {
+            const char* value = nextValue("--list");
+            if (!value || !ReadJobList(Utf8ToPath(value), loop, targetRate, options.jobs)) {
+                return kExitUsage;
+            }
+            options.autoLoop.resize(options.jobs.size(), loop.automatic);
+        } else if (arg == "--cache") {
+            const char* value = nextValue("--cache");
+            if (!value) {
+                return kExitUsage;
+            }
+            options.cacheDir = Utf8ToPath(value);
+        } else if (arg == "--cache-size") {
+            const char* value = nextValue("--cache-size");
+            long long megabytes = 0;
+            if (!value || !ParseInt(value, 1, 1024 * 1024, megabytes)) {
+                std::fprintf(stderr, "--cache-size must be between 1 and 1048576 MB.\n");
+                return kExitUsage;
+            }
+            options.cacheMaxBytes = static_cast<uint64_t>(megabytes) * 1024 * 1024;
+        } else if (arg == "--rebuild") {
+            options.convert.incremental = false;
+        } else if (arg == "--profile") {
+            options.convert.profile = true;
+        } else if (arg == "--trace") {
+            const char* value = nextValue("--trace");
+            if (!value) {
+                return kExitUsage;
+            }
+            options.tracePath = Utf8ToPath(value);
+        } else if (arg == "--report") {
+            const char* value = nextValue("--report");
+            if (!value) {
+                return kExitUsage;
+            }
+            options.reportPath = Utf8ToPath(value);
+        } else if (arg == "--report-sort") {
+            const char* value = nextValue("--report-sort");
+            if (!value || !ParseSortKey(value, options.reportSort)) {
+                std::fprintf(stderr, "--report-sort expects snr, peak, clip, dc or name.\n");
+                return kExitUsage;
+            }
+        } else if (arg == "--extract") {
+            // Handled above.
+        } else if (arg == "--wav-rate") {
+            const char* value = nextValue("--wav-rate");
+            long long rate = 0;
+            if (!value || !ParseInt(value, 1000, 768000, rate)) {
+                std::fprintf(stderr, "--wav-rate must be between 1000 and 768000 Hz.\n");
+                return kExitUsage;
+            }
+            options.wavRate = static_cast<uint32_t>(rate);
+        } else if (arg == "--dither") {
+            options.convert.dither = true;
+        } else if (arg == "--verify") {
+            options.convert.verify = true;
+        } else if (arg == "-q" || arg == "--quiet") {
+            options.quiet = true;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            std::fprintf(stderr, "Unknown option: %s\n", arg.c_str());
+            return kExitUsage;
+        } else if (options.extract) {
+            if (!AddExportInput(Utf8ToPath(arg), pendingName, options.exportJobs)) {
+                return kExitUsage;
+            }
+        } else if (!AddInput(Utf8ToPath(arg), pendingName, loop, targetRate, options.jobs)) {
+            return kExitUsage;
+        } else {
+            options.autoLoop.resize(options.jobs.size(), loop.automatic);
+        }
+    }
+
+    if (options.extract) {
+        if (!sawOutput || !options.archivePath.empty()) {
+            std::fprintf(stderr, "--extract needs an output folder (-o) and reads sample files, not archives.\n");
+            return kExitUsage;
+        }
+        if (options.exportJobs.empty()) {
+            std::fprintf(stderr, "No input samples given.\n");
+            return kExitUsage;
+        }
+        return std::nullopt;
+    }
+
+    if (options.convert.targetSnrDb > 0.0 && !sawPredictors) {
+        options.convert.predictorCount = 16;
+    }
+    if (sawOutput == !options.archivePath.empty()) {
+        std::fprintf(stderr, "Give either an output folder (-o) or an archive (--archive).\n\n");
+        PrintUsage(stderr);
+        return kExitUsage;
+    }
+    if (!pendingName.empty()) {
+        std::fprintf(stderr, "--name %s is not followed by an input.\n", pendingName.c_str());
+        return kExitUsage;
+    }
+    if (options.jobs.empty()) {
+        std::fprintf(stderr, "No input WAV files given.\n");
+        return kExitUsage;
+    }
+    // A lone sample has the cores to itself; a batch keeps them busy with
+    // one sample per worker instead.
+    options.convert.parallelSearch = options.jobs.size() == 1;
+    return std::nullopt;
+}
+
+// Replaces the loop points of every --auto-loop job with the best seam the
+// search finds. Jobs the manifest shows as searched and converted already
+// take the points it recorded instead. A job whose search fails is marked in
+// loopFailed and not converted: its loop would be one nobody asked for.
+static size_t FindAutoLoops(CliOptions& options, std::vector<char>& loopFailed) {
+    std::atomic<size_t> failed = 0;
+    std::mutex printMutex;
+    ThreadPool pool(std::min(options.jobCount == 0 ? ThreadPool::DefaultThreadCount() : options.jobCount,
+                             options.jobs.size()));
+    for (size_t index = 0; index < options.jobs.size(); index++) {
+        if (!options.autoLoop[index]) {
+            continue;
+        }
+        ConvertJob& job = options.jobs[index];
+        char* jobFailed = &loopFailed[index];
+        pool.Submit([&options, &job, jobFailed, &failed, &printMutex] {
+            ConversionManifest* manifest = options.convert.manifest;
+            if (manifest && options.convert.incremental &&
+                manifest->ReuseLoopSearch(job, options.convert, options.outputDir / Utf8ToPath(job.outputName))) {
+                if (!options.quiet) {
+                    std::lock_guard<std::mutex> lock(printMutex);
+                    std::printf("%s: loop %u:%u, unchanged\n", PathToUtf8(job.inputPath).c_str(), job.loopStart,
+                                job.loopEnd);
+                }
+                return;
+            }
+            LoopSearchOptions search;
+            search.loopEnd = job.loopEnd;
+            search.predictorCount = options.convert.predictorCount;
+            search.candidateCount = 1;
+            std::vector<LoopCandidate> candidates;
+            std::string error;
+            bool ok = FindJobLoopPoints(job, options.convert.dither, search, candidates, error);
+            std::lock_guard<std::mutex> lock(printMutex);
+            if (!ok) {
+                failed++;
+                *jobFailed = 1;
+                std::fprintf(stderr, "%s: loop search failed: %s\n", PathToUtf8(job.inputPath).c_str(), error.c_str());
+                return;
+            }
+            job.loopSearched = true;
+            job.searchLoopEnd = job.loopEnd;
+            job.loopStart = candidates[0].loopStart;
+            job.loopEnd = candidates[0].loopEnd;
+            if (!options.quiet) {
+                std::printf("%s: loop %u:%u, seam %.1f dB\n", PathToUtf8(job.inputPath).c_str(), job.loopStart,
+                            job.loopEnd, candidates[0].seamSnrDb);
+            }
+        });
+    }
+    pool.Wait();
+    return failed.load();
+}
+
+static int RunExtract(const CliOptions& options) {
+    auto startTime = std::chrono::steady_clock::now();
+    std::vector<ExportResult> results =
+        ExportSamples(options.exportJobs, options.outputDir, options.wavRate, options.jobCount);
+
+    size_t failCount = 0;
+    for (const ExportResult& result : results) {
+        if (!result.ok) {
+            failCount++;
+            std::fprintf(stderr, "%s: %s\n", PathToUtf8(result.inputPath).c_str(), result.error.c_str());
+        } else if (!options.quiet) {
+            std::printf("%s -> %s.wav\n", PathToUtf8(result.inputPath).c_str(), result.outputName.c_str());
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    if (!options.quiet || failCount > 0) {
+        std::fprintf(failCount > 0 ? stderr : stdout, "Extracted %zu of %zu samples in %.2f s.\n",
+                     results.size() - failCount, results.size(), seconds);
+    }
+    return failCount > 0 ? kExitConvertFailed : kExitOk;
+}
+
+int main(int argc, char** argv) {
+    CliOptions options;
+    if (auto exitCode = ParseArgs(argc, argv, options)) {
+        return *exitCode;
+    }
+    if (options.extract) {
+        return RunExtract(options);
+    }
+
+    ConversionDedup dedup;
+    options.convert.dedup = &dedup;
+    std::optional<ConversionCache> cache;
+    if (!options.cacheDir.empty()) {
+        cache.emplace(options.cacheDir, options.cacheMaxBytes);
+        options.convert.cache = &*cache;
+    }
+
+    std::optional<O2rArchive> archive;
+    if (!options.archivePath.empty()) {
+        std::string archiveError;
+        archive.emplace(options.resourcePrefix);
+        if (!archive->Open(options.archivePath, archiveError)) {
+            std::fprintf(stderr, "%s\n", archiveError.c_str());
+            return kExitConvertFailed;
+        }
+        options.convert.archive = &*archive;
+    }
+
+    std::string manifestError;
+    ConversionManifest manifest;
+    if (!manifest.Load(archive ? options.archivePath : options.outputDir, manifestError, options.convert.archive)) {
+        std::fprintf(stderr, "Warning: %s Converting everything.\n", manifestError.c_str());
+    }
+    options.convert.manifest = &manifest;
+
+    TraceRecorder trace;
+    if (!options.tracePath.empty()) {
+        options.convert.trace = &trace;
+    }
+    std::vector<StageTimings> timings;
+
+    auto startTime = std::chrono::steady_clock::now();
+    size_t loopFailCount = 0;
+    std::vector<char> loopFailed(options.jobs.size(), 0);
+    if (std::find(options.autoLoop.begin(), options.autoLoop.end(), 1) != options.autoLoop.end()) {
+        loopFailCount = FindAutoLoops(options, loopFailed);
+    }
+    std::atomic<size_t> failed = 0;
+    std::vector<char> converted(options.jobs.size(), 0);
+    std::mutex printMutex;
+    {
+        ThreadPool pool(std::min(options.jobCount == 0 ? ThreadPool::DefaultThreadCount() : options.jobCount,
+                                 options.jobs.size()));
+        for (size_t index = 0; index < options.jobs.size(); index++) {
+            if (loopFailed[index]) {
+                continue;
+            }
+            const ConvertJob& job = options.jobs[index];
+            char* jobConverted = &converted[index];
+            pool.Submit([&options, &job, jobConverted, &failed, &printMutex, &timings] {
+                thread_local ConvertBuffers buffers;
+                std::string status;
+                ConvertProgress progress;
+                bool ok = ConvertSample(job, options.outputDir, options.convert, status, &progress, nullptr, &buffers);
+                *jobConverted = ok ? 1 : 0;
+                if (!ok) {
+                    failed++;
+                }
+                if (options.convert.profile) {
+                    std::lock_guard<std::mutex> lock(printMutex);
+                    timings.push_back(progress.timings);
+                }
+                if (!ok || !options.quiet) {
+                    std::lock_guard<std::mutex> lock(printMutex);
+                    std::string choice = progress.predictorChoice ? DescribeChoice(*progress.predictorChoice) : "";
+                    std::fprintf(ok ? stdout : stderr, "%s -> %s: %s%s\n", PathToUtf8(job.inputPath).c_str(),
+                                 job.outputName.c_str(), status.c_str(), choice.c_str());
+                }
+            });
+        }
+        pool.Wait();
+    }
+
+    size_t failCount = failed.load() + loopFailCount;
+    if (archive) {
+        std::string archiveError;
+        if (!archive->Finish(archiveError)) {
+            std::fprintf(stderr, "%s\n", archiveError.c_str());
+            failCount++;
+        }
+        O2rArchive::Stats archiveStats = archive->GetStats();
+        if (!options.quiet) {
+            std::printf("Archive: %zu entries, %zu added, %zu replaced, %zu unchanged%s.\n", archiveStats.entries,
+                        archiveStats.added, archiveStats.replaced, archiveStats.unchanged,
+                        archiveStats.compacted ? ", compacted" : "");
+        }
+    }
+
+    if (!options.reportPath.empty()) {
+        std::vector<ConvertJob> reportJobs;
+        for (size_t index = 0; index < options.jobs.size(); index++) {
+            if (converted[index]) {
+                reportJobs.push_back(options.jobs[index]);
+            }
+        }
+        std::vector<SampleQuality> report =
+            MeasureQuality(reportJobs, options.outputDir, options.convert.archive, options.jobCount);
+        SortQuality(report, options.reportSort);
+        std::string reportError;
+        if (!WriteQualityReport(options.reportPath, report, reportError)) {
+            std::fprintf(stderr, "Failed to write report %s: %s\n", PathToUtf8(options.reportPath).c_str(),
+                         reportError.c_str());
+            failCount++;
+        }
+        for (const SampleQuality& item : report) {
+            if (!item.ok) {
+                std::fprintf(stderr, "Could not measure %s: %s\n", item.outputName.c_str(), item.error.c_str());
+            }
+        }
+        auto worst = std::min_element(report.begin(), report.end(), [](const SampleQuality& a, const SampleQuality& b) {
+            return a.ok && (!b.ok || a.snrDb < b.snrDb);
+        });
+        if (!options.quiet && worst != report.end() && worst->ok) {
+            std::printf("Quality: lowest SNR %.1f dB (%s); report written to %s.\n", worst->snrDb,
+                        worst->outputName.c_str(), PathToUtf8(options.reportPath).c_str());
+        }
+    }
+
+    if (!manifest.Save(manifestError)) {
+        std::fprintf(stderr, "Warning: %s\n", manifestError.c_str());
+    }
+    for (const auto& orphan : manifest.FindOrphans()) {
+        std::fprintf(stderr, "Stale output %s: input %s no longer exists.\n", orphan.outputName.c_str(),
+                     PathToUtf8(orphan.inputPath).c_str());
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    size_t failedJobs = failed.load() + loopFailCount;
+    if (!options.quiet || failCount > 0) {
+        std::fprintf(failCount > 0 ? stderr : stdout, "Converted %zu of %zu samples in %.2f s.\n",
+                     options.jobs.size() - failedJobs, options.jobs.size(), seconds);
+    }
+    if (options.convert.profile) {
+        std::printf("%-10s %6s %10s %10s %10s %10s\n", "Stage", "Runs", "p50 ms", "p99 ms", "Total s", "MB/s");
+        for (const StageSummary& summary : SummarizeTimings(timings)) {
+            std::printf("%-10s %6zu %10.3f %10.3f %10.3f %10.1f\n", ProfileStageName(summary.stage), summary.count,
+                        summary.p50Seconds * 1000.0, summary.p99Seconds * 1000.0, summary.totalSeconds,
+                        summary.mbPerSecond);
+        }
+        uint64_t allocations = 0;
+        for (const StageTimings& item : timings) {
+            allocations += item.bufferAllocations;
+        }
+        std::printf("Buffer allocations: %llu over %zu samples (%.2f per sample).\n",
+                    static_cast<unsigned long long>(allocations), timings.size(),
+                    timings.empty() ? 0.0 : static_cast<double>(allocations) / static_cast<double>(timings.size()));
+    }
+    if (!options.tracePath.empty()) {
+        std::string traceError;
+        if (!trace.Write(options.tracePath, traceError)) {
+            std::fprintf(stderr, "Warning: failed to write trace %s: %s\n", PathToUtf8(options.tracePath).c_str(),
+                         traceError.c_str());
+        }
+    }
+    if (cache && !options.quiet) {
+        ConversionCache::Stats cacheStats = cache->GetStats();
+        std::printf("Cache: %llu hits, %llu misses, %llu evicted, %zu entries (%.1f MB).\n",
+                    static_cast<unsigned long long>(cacheStats.hits),
+                    static_cast<unsigned long long>(cacheStats.misses),
+                    static_cast<unsigned long long>(cacheStats.evictions),
+                    cacheStats.entries,
+                    static_cast<double>(cacheStats.bytes) / (1024.0 * 1024.0));
+    }
+    return failCount > 0 ? kExitConvertFailed : kExitOk;
+}
@@ -0,0 +1,137 @@
+#include "ConversionBatch.h"
+
+#include "ConversionDedup.h"
+#include "ConvertBuffers.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+static bool IsFinalStage(ConvertStage stage) {
+    return stage == ConvertStage::Done || stage == ConvertStage::Failed || stage == ConvertStage::Cancelled;
+}
+
+ConversionBatch::ConversionBatch(std::vector<ConvertJob> jobs,
+                                 std::filesystem::path outputDir,
+                                 ConvertOptions options,
+                                 size_t threadCount)
+    : outputDir(std::move(outputDir)), dedup(std::make_unique<ConversionDedup>()), options(options) {
+    this->options.dedup = dedup.get();
+    jobStates.reserve(jobs.size());
+    for (auto& job : jobs) {
+        auto state = std::make_unique<JobState>();
+        state->job = std::move(job);
+        jobStates.push_back(std::move(state));
+    }
+
+    startTime = std::chrono::steady_clock::now();
+    if (jobStates.empty()) {
+        return;
+    }
+
+    if (threadCount == 0) {
+        threadCount = ThreadPool::DefaultThreadCount();
+    }
+    pool = std::make_unique<ThreadPool>(std::min(threadCount, jobStates.size()));
+    for (auto& state : jobStates) {
+        JobState* statePtr = state.get();
+        pool->Submit([this, statePtr] { RunJob(*statePtr); });
+    }
+}
+
+ConversionBatch::~ConversionBatch() {
+    Cancel();
+    pool.reset();
+}
+
+void ConversionBatch::Cancel() {
+    cancel.store(true, std::memory_order_relaxed);
+}
+
+bool ConversionBatch::IsCancelled() const {
+    return cancel.load(std::memory_order_relaxed);
+}
+
+bool ConversionBatch::IsFinished() const {
+    return finished.load(std::memory_order_acquire) == jobStates.size();
+}
+
+size_t ConversionBatch::GetJobCount() const {
+    return jobStates.size();
+}
+
+ConvertStage ConversionBatch::GetStage(size_t index) const {
+    return jobStates[index]->progress.stage.load(std::memory_order_acquire);
+}
+
+std::string ConversionBatch::GetStatus(size_t index) const {
+    const JobState& state = *jobStates[index];
+    ConvertStage stage = state.progress.stage.load(std::memory_order_acquire);
+    if (IsFinalStage(stage)) {
+        // The status string is written once, before the final stage is
+        // published, so it is safe to read without a lock.
+        return state.status;
+    }
+    return ConvertStageName(stage);
+}
+
+std::optional<StageTimings> ConversionBatch::GetTimings(size_t index) const {
+    const JobState& state = *jobStates[index];
+    // Like the status, timings are complete before the final stage is
+    // published.
+    if (!options.profile || !IsFinalStage(state.progress.stage.load(std::memory_order_acquire))) {
+        return std::nullopt;
+    }
+    return state.progress.timings;
+}
+
+std::optional<PredictorChoice> ConversionBatch::GetPredictorChoice(size_t index) const {
+    const JobState& state = *jobStates[index];
+    if (!IsFinalStage(state.progress.stage.load(std::memory_order_acquire))) {
+        return std::nullopt;
+    }
+    return state.progress.predictorChoice;
+}
+
+std::vector<StageSummary> ConversionBatch::GetStageSummary() const {
+    std::vector<StageTimings> timings;
+    for (size_t i = 0; i < jobStates.size(); i++) {
+        if (auto item = GetTimings(i)) {
+            timings.push_back(*item);
+        }
+    }
+    return SummarizeTimings(timings);
+}
+
+ConversionBatch::Stats ConversionBatch::GetStats() const {
+    Stats stats;
+    stats.total = jobStates.size();
+    stats.finished = finished.load(std::memory_order_acquire);
+    stats.failed = failed.load(std::memory_order_relaxed);
+    stats.samples = samples.load(std::memory_order_relaxed);
+
+    int64_t endTicks = finishTicks.load(std::memory_order_relaxed);
+    auto end = endTicks != 0 ? startTime + std::chrono::steady_clock::duration(endTicks) : std::chrono::steady_clock::now();
+    stats.elapsedSeconds = std::chrono::duration<double>(end - startTime).count();
+    return stats;
+}
+
+void ConversionBatch::RunJob(JobState& state) {
+    // Pool threads live as long as the batch, and so do their buffers.
+    thread_local ConvertBuffers buffers;
+    ConvertStage result = ConvertStage::Done;
+    if (!ConvertSample(state.job, outputDir, options, state.status, &state.progress, &cancel, &buffers)) {
+        if (state.status == ConvertStageName(ConvertStage::Cancelled)) {
+            result = ConvertStage::Cancelled;
+        } else {
+            result = ConvertStage::Failed;
+            failed.fetch_add(1, std::memory_order_relaxed);
+        }
+    } else {
+        samples.fetch_add(state.progress.sampleCount.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+
+    state.progress.stage.store(result, std::memory_order_release);
+    if (finished.fetch_add(1, std::memory_order_acq_rel) + 1 == jobStates.size()) {
+        finishTicks.store((std::chrono::steady_clock::now() - startTime).count(), std::memory_order_relaxed);
+    }
+}
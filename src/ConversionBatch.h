@@ -0,0 +1,80 @@
+#pragma once
+
+#include "Convert.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+class ConversionDedup;
+class ThreadPool;
+
+// Runs a list of ConvertJobs on a worker pool in the background. All getters
+// may be called from the UI thread while the batch is running.
+class ConversionBatch {
+public:
+    struct Stats {
+        size_t total = 0;
+        size_t finished = 0;
+        size_t failed = 0;
+        uint64_t samples = 0;
+        double elapsedSeconds = 0.0;
+    };
+
+    // threadCount == 0 uses one thread per hardware core.
+    ConversionBatch(std::vector<ConvertJob> jobs,
+                    std::filesystem::path outputDir,
+                    ConvertOptions options,
+                    size_t threadCount = 0);
+    // Cancels outstanding jobs and waits for the workers to exit.
+    ~ConversionBatch();
+
+    ConversionBatch(const ConversionBatch&) = delete;
+    ConversionBatch& operator=(const ConversionBatch&) = delete;
+
+    void Cancel();
+    bool IsCancelled() const;
+    bool IsFinished() const;
+
+    size_t GetJobCount() const;
+    ConvertStage GetStage(size_t index) const;
+    // Stage name while the job is in flight, the final status message once
+    // it has finished.
+    std::string GetStatus(size_t index) const;
+    // Stage timings of a finished job; empty while it runs or when the batch
+    // is not profiling.
+    std::optional<StageTimings> GetTimings(size_t index) const;
+    // Predictor count and SNR a finished job's search settled on; empty
+    // without a search, or when the output came from the cache or manifest.
+    std::optional<PredictorChoice> GetPredictorChoice(size_t index) const;
+    // Timing percentiles over the jobs finished so far.
+    std::vector<StageSummary> GetStageSummary() const;
+    Stats GetStats() const;
+
+private:
+    struct JobState {
+        ConvertJob job;
+        ConvertProgress progress;
+        std::string status;
+    };
+
+    void RunJob(JobState& state);
+
+    std::vector<std::unique_ptr<JobState>> jobStates;
+    std::filesystem::path outputDir;
+    // Identical inputs of this batch are encoded once.
+    std::unique_ptr<ConversionDedup> dedup;
+    ConvertOptions options;
+    std::atomic<bool> cancel{false};
+    std::atomic<size_t> finished{0};
+    std::atomic<size_t> failed{0};
+    std::atomic<uint64_t> samples{0};
+    std::chrono::steady_clock::time_point startTime;
+    std::atomic<int64_t> finishTicks{0};
+    std::unique_ptr<ThreadPool> pool;
+};
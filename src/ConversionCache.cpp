@@ -0,0 +1,285 @@
+#include "ConversionCache.h"
+
+#include "BinaryWriter.h"
+#include "Hash64.h"
+#include "MappedFile.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdio>
+#include <system_error>
+#include <thread>
+
+// Bump whenever the encoder or the resource layout changes, so stale entries
+// stop matching.
+static constexpr uint32_t kCacheFormatVersion = 2;
+static constexpr const char* kEntryExtension = ".soh";
+
+uint64_t HashPcm(std::span<const int16_t> samples) {
+    ScopedStageTimer timer(ProfileStage::Hash);
+    return Hash64({reinterpret_cast<const uint8_t*>(samples.data()), samples.size_bytes()});
+}
+
+uint64_t ConversionCacheKey(uint64_t pcmHash,
+                            uint64_t sampleCount,
+                            uint32_t sampleRate,
+                            const ConvertJob& job,
+                            const ConvertOptions& options) {
+    std::vector<uint8_t> params;
+    BinaryWriter writer(params);
+    writer.PutU32LE(kCacheFormatVersion);
+    writer.PutU64LE(sampleCount);
+    writer.PutU32LE(sampleRate);
+    writer.PutU32LE(job.targetSampleRate);
+    writer.PutU32LE(static_cast<uint32_t>(options.predictorCount));
+    writer.PutU64LE(std::bit_cast<uint64_t>(options.targetSnrDb));
+    writer.PutU8(job.loopEnabled ? 1 : 0);
+    if (job.loopEnabled) {
+        writer.PutU32LE(job.loopStart);
+        writer.PutU32LE(job.loopEnd);
+        writer.PutU32LE(static_cast<uint32_t>(job.loopCount));
+    }
+    return Hash64(params, pcmHash);
+}
+
+uint64_t ConversionCacheKey(std::span<const int16_t> samples,
+                            uint32_t sampleRate,
+                            const ConvertJob& job,
+                            const ConvertOptions& options) {
+    return ConversionCacheKey(HashPcm(samples), samples.size(), sampleRate, job, options);
+}
+
+static bool ParseEntryName(const std::filesystem::path& path, uint64_t& key) {
+    std::string stem = path.stem().string();
+    if (path.extension() != kEntryExtension || stem.size() != 16) {
+        return false;
+    }
+    key = 0;
+    for (char ch : stem) {
+        int digit;
+        if (ch >= '0' && ch <= '9') {
+            digit = ch - '0';
+        } else if (ch >= 'a' && ch <= 'f') {
+            digit = ch - 'a' + 10;
+        } else {
+            return false;
+        }
+        key = (key << 4) | static_cast<uint64_t>(digit);
+    }
+    return true;
+}
+
+bool ConversionCache::Ticket::Restore(const std::filesystem::path& path,
+                                      std::string& error,
+                                      uint64_t* resourceHash) const {
+    if (!hit) {
+        error = "Not a cache hit.";
+        return false;
+    }
+    if (data) {
+        if (resourceHash) {
+            *resourceHash = Hash64(*data);
+        }
+        std::span<const uint8_t> segments[] = {*data};
+        return WriteFileSegments(path, segments, error);
+    }
+    if (resourceHash) {
+        // Hashed from the same mapping it is written from, so the entry is
+        // read once.
+        MappedFile mapped;
+        if (!mapped.Open(file, error)) {
+            return false;
+        }
+        std::span<const uint8_t> segments[] = {{mapped.GetData(), mapped.GetSize()}};
+        *resourceHash = Hash64(segments[0]);
+        return WriteFileSegments(path, segments, error);
+    }
+
+    std::error_code ec;
+    std::filesystem::copy_file(file, path, std::filesystem::copy_options::overwrite_existing, ec);
+    if (ec) {
+        error = "Failed to copy cached sample: " + ec.message();
+        return false;
+    }
+    return true;
+}
+
+bool ConversionCache::Ticket::Load(std::vector<uint8_t>& resource, std::string& error) const {
+    if (!hit) {
+        error = "Not a cache hit.";
+        return false;
+    }
+    if (data) {
+        resource = *data;
+        return true;
+    }
+
+    MappedFile mapped;
+    if (!mapped.Open(file, error)) {
+        return false;
+    }
+    resource.assign(mapped.GetData(), mapped.GetData() + mapped.GetSize());
+    return true;
+}
+
+void ConversionCache::Ticket::Store(std::span<const uint8_t> resource) {
+    std::span<const uint8_t> segments[] = {resource};
+    Store(segments);
+}
+
+void ConversionCache::Ticket::Store(std::span<const std::span<const uint8_t>> segments) {
+    if (!cache || hit) {
+        return;
+    }
+    cache->Insert(key, segments);
+    cache = nullptr;
+}
+
+ConversionCache::ConversionCache(std::filesystem::path folder, uint64_t maxBytes)
+    : folder(std::move(folder)), maxBytes(maxBytes) {
+    if (this->folder.empty()) {
+        return;
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(this->folder, ec);
+
+    struct Found {
+        std::filesystem::file_time_type lastUse;
+        uint64_t key;
+        uint64_t size;
+    };
+    std::vector<Found> found;
+    for (const auto& item : std::filesystem::directory_iterator(this->folder, ec)) {
+        uint64_t key = 0;
+        if (!item.is_regular_file(ec) || !ParseEntryName(item.path(), key)) {
+            continue;
+        }
+        uint64_t size = item.file_size(ec);
+        auto lastUse = item.last_write_time(ec);
+        if (!ec) {
+            found.push_back({lastUse, key, size});
+        }
+    }
+    std::sort(found.begin(), found.end(), [](const Found& a, const Found& b) { return a.lastUse > b.lastUse; });
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const Found& item : found) {
+        Entry& entry = entries[item.key];
+        entry.size = item.size;
+        entry.order = order.insert(order.end(), item.key);
+        stats.bytes += item.size;
+    }
+    EvictLocked();
+}
+
+ConversionCache::Ticket ConversionCache::Claim(uint64_t key) {
+    std::lock_guard<std::mutex> lock(mutex);
+    Ticket ticket;
+    ticket.cache = this;
+    ticket.key = key;
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        ticket.hit = true;
+        ticket.data = it->second.data;
+        if (!folder.empty()) {
+            ticket.file = EntryPath(key);
+        }
+        Touch(it->second, key);
+        stats.hits++;
+    } else {
+        stats.misses++;
+    }
+    return ticket;
+}
+
+ConversionCache::Stats ConversionCache::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = stats;
+    result.entries = entries.size();
+    return result;
+}
+
+std::filesystem::path ConversionCache::EntryPath(uint64_t key) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx%s", static_cast<unsigned long long>(key), kEntryExtension);
+    return folder / name;
+}
+
+void ConversionCache::Insert(uint64_t key, std::span<const std::span<const uint8_t>> segments) {
+    uint64_t size = 0;
+    for (const auto& segment : segments) {
+        size += segment.size();
+    }
+    if (size > maxBytes) {
+        return;
+    }
+
+    std::shared_ptr<const std::vector<uint8_t>> data;
+    if (folder.empty()) {
+        auto bytes = std::make_shared<std::vector<uint8_t>>();
+        bytes->reserve(size);
+        for (const auto& segment : segments) {
+            bytes->insert(bytes->end(), segment.begin(), segment.end());
+        }
+        data = std::move(bytes);
+    } else {
+        // Write under a temporary name and rename, so another process never
+        // sees a half-written entry.
+        std::filesystem::path target = EntryPath(key);
+        char suffix[32];
+        std::snprintf(suffix, sizeof(suffix), ".%zx.tmp", std::hash<std::thread::id>()(std::this_thread::get_id()));
+        std::filesystem::path temp = target;
+        temp += suffix;
+        std::string error;
+        std::error_code ec;
+        if (!WriteFileSegments(temp, segments, error)) {
+            std::filesystem::remove(temp, ec);
+            return;
+        }
+        std::filesystem::rename(temp, target, ec);
+        if (ec) {
+            std::filesystem::remove(temp, ec);
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [it, inserted] = entries.try_emplace(key);
+    Entry& entry = it->second;
+    if (inserted) {
+        entry.order = order.insert(order.begin(), key);
+    } else {
+        stats.bytes -= entry.size;
+        order.splice(order.begin(), order, entry.order);
+    }
+    entry.size = size;
+    entry.data = std::move(data);
+    stats.bytes += entry.size;
+    EvictLocked();
+}
+
+void ConversionCache::Touch(Entry& entry, uint64_t key) {
+    order.splice(order.begin(), order, entry.order);
+    if (!folder.empty()) {
+        // The file time carries the LRU order across runs.
+        std::error_code ec;
+        std::filesystem::last_write_time(EntryPath(key), std::filesystem::file_time_type::clock::now(), ec);
+    }
+}
+
+void ConversionCache::EvictLocked() {
+    while (stats.bytes > maxBytes && !order.empty()) {
+        uint64_t key = order.back();
+        order.pop_back();
+        auto it = entries.find(key);
+        stats.bytes -= it->second.size;
+        entries.erase(it);
+        if (!folder.empty()) {
+            std::error_code ec;
+            std::filesystem::remove(EntryPath(key), ec);
+        }
+        stats.evictions++;
+    }
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "Convert.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Hash64 of a PCM payload, as ConversionCacheKey takes it.
+uint64_t HashPcm(std::span<const int16_t> samples);
+// Fingerprint of everything that decides a conversion's output: the PCM
+// payload, sample rate, target rate, predictor settings and loop settings.
+uint64_t ConversionCacheKey(uint64_t pcmHash,
+                            uint64_t sampleCount,
+                            uint32_t sampleRate,
+                            const ConvertJob& job,
+                            const ConvertOptions& options);
+uint64_t ConversionCacheKey(std::span<const int16_t> samples,
+                            uint32_t sampleRate,
+                            const ConvertJob& job,
+                            const ConvertOptions& options);
+
+// Finished SoH samples keyed by ConversionCacheKey, kept either in a folder
+// (one file per entry, so it survives restarts) or in memory when no folder
+// is given. The least recently used entries are evicted once the total size
+// passes the cap. Safe to share between workers; identical inputs within a
+// batch are left to ConversionDedup.
+class ConversionCache {
+public:
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        size_t entries = 0;
+        uint64_t bytes = 0;
+    };
+
+    // Returned by Claim. A hit can restore the cached output; on a miss the
+    // caller should Store the result once it has one.
+    class Ticket {
+    public:
+        bool IsHit() const {
+            return hit;
+        }
+        // Writes the cached resource to path, and its Hash64 to resourceHash
+        // when given.
+        bool Restore(const std::filesystem::path& path, std::string& error, uint64_t* resourceHash = nullptr) const;
+        // Reads the cached resource into memory instead.
+        bool Load(std::vector<uint8_t>& resource, std::string& error) const;
+        // Adds the serialized resource under the claimed key. Ignored for hits.
+        void Store(std::span<const uint8_t> resource);
+        // The same for a resource held in pieces, stored back to back.
+        void Store(std::span<const std::span<const uint8_t>> segments);
+
+    private:
+        friend class ConversionCache;
+
+        ConversionCache* cache = nullptr;
+        uint64_t key = 0;
+        bool hit = false;
+        std::shared_ptr<const std::vector<uint8_t>> data;
+        std::filesystem::path file;
+    };
+
+    // An empty folder keeps entries in memory only. Existing entries in the
+    // folder are picked up, oldest use first in line for eviction.
+    ConversionCache(std::filesystem::path folder, uint64_t maxBytes);
+
+    ConversionCache(const ConversionCache&) = delete;
+    ConversionCache& operator=(const ConversionCache&) = delete;
+
+    Ticket Claim(uint64_t key);
+    Stats GetStats() const;
+
+private:
+    struct Entry {
+        uint64_t size = 0;
+        std::list<uint64_t>::iterator order;
+        std::shared_ptr<const std::vector<uint8_t>> data;
+    };
+
+    std::filesystem::path EntryPath(uint64_t key) const;
+    void Insert(uint64_t key, std::span<const std::span<const uint8_t>> segments);
+    void Touch(Entry& entry, uint64_t key);
+    void EvictLocked();
+
+    std::filesystem::path folder;
+    uint64_t maxBytes = 0;
+
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, Entry> entries;
+    // Most recently used first.
+    std::list<uint64_t> order;
+    Stats stats;
+};
@@ -0,0 +1,65 @@
+#include "ConversionDedup.h"
+
+ConversionDedup::Ticket::~Ticket() {
+    Release();
+}
+
+ConversionDedup::Ticket::Ticket(Ticket&& other) noexcept
+    : dedup(other.dedup), key(other.key), duplicate(other.duplicate), output(std::move(other.output)) {
+    other.dedup = nullptr;
+}
+
+ConversionDedup::Ticket& ConversionDedup::Ticket::operator=(Ticket&& other) noexcept {
+    if (this != &other) {
+        Release();
+        dedup = other.dedup;
+        key = other.key;
+        duplicate = other.duplicate;
+        output = std::move(other.output);
+        other.dedup = nullptr;
+    }
+    return *this;
+}
+
+void ConversionDedup::Ticket::Finish(Output output) {
+    if (!dedup || duplicate) {
+        return;
+    }
+    dedup->Finish(key, &output);
+    dedup = nullptr;
+}
+
+void ConversionDedup::Ticket::Release() {
+    if (dedup && !duplicate) {
+        dedup->Finish(key, nullptr);
+    }
+    dedup = nullptr;
+}
+
+ConversionDedup::Ticket ConversionDedup::Claim(uint64_t key) {
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return inFlight.count(key) == 0; });
+
+    Ticket ticket;
+    ticket.dedup = this;
+    ticket.key = key;
+    auto it = outputs.find(key);
+    if (it != outputs.end()) {
+        ticket.duplicate = true;
+        ticket.output = it->second;
+    } else {
+        inFlight.insert(key);
+    }
+    return ticket;
+}
+
+void ConversionDedup::Finish(uint64_t key, Output* output) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        inFlight.erase(key);
+        if (output) {
+            outputs[key] = std::move(*output);
+        }
+    }
+    finished.notify_all();
+}
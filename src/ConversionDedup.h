@@ -0,0 +1,73 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Identical inputs within one batch, found by ConversionCacheKey. The first
+// job to claim a key converts it; jobs claiming the same key meanwhile wait
+// for it, and they and any later ones copy its output instead of encoding
+// again. Only where each output went is kept, never the audio. Safe to share
+// between the workers of a batch.
+class ConversionDedup {
+public:
+    // Where a claimed key's output was written. In an archive the output is
+    // found by outputName; resourceHash is the Hash64 of a file output when
+    // its conversion measured one, otherwise 0.
+    struct Output {
+        std::filesystem::path path;
+        std::string outputName;
+        uint64_t resourceHash = 0;
+    };
+
+    // Returned by Claim. A duplicate carries the first job's output;
+    // otherwise the caller is converting the key and calls Finish once its
+    // output is written. Dropping it unfinished lets the next waiter convert
+    // instead.
+    class Ticket {
+    public:
+        Ticket() = default;
+        ~Ticket();
+        Ticket(Ticket&& other) noexcept;
+        Ticket& operator=(Ticket&& other) noexcept;
+        Ticket(const Ticket&) = delete;
+        Ticket& operator=(const Ticket&) = delete;
+
+        bool IsDuplicate() const {
+            return duplicate;
+        }
+        const Output& GetOutput() const {
+            return output;
+        }
+        // Ignored for duplicates.
+        void Finish(Output output);
+
+    private:
+        friend class ConversionDedup;
+        void Release();
+
+        ConversionDedup* dedup = nullptr;
+        uint64_t key = 0;
+        bool duplicate = false;
+        Output output;
+    };
+
+    ConversionDedup() = default;
+    ConversionDedup(const ConversionDedup&) = delete;
+    ConversionDedup& operator=(const ConversionDedup&) = delete;
+
+    // Blocks while another job is converting key.
+    Ticket Claim(uint64_t key);
+
+private:
+    void Finish(uint64_t key, Output* output);
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::unordered_set<uint64_t> inFlight;
+    std::unordered_map<uint64_t, Output> outputs;
+};
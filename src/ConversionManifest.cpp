@@ -0,0 +1,431 @@
+#include "ConversionManifest.h"
+
+#include "AudioFormats.h"
+#include "BinaryWriter.h"
+#include "ConversionCache.h"
+#include "Hash64.h"
+#include "MappedFile.h"
+#include "O2rArchive.h"
+#include "PathUtils.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <system_error>
+
+// Bump with the encoder so every output is rebuilt once.
+static constexpr const char* kManifestHeader = "# SoH-AudioTool manifest v6";
+// Samples hashed per read when an input's time changed.
+static constexpr size_t kHashChunkSamples = 64 * 1024;
+static constexpr size_t kFieldCount = 18;
+
+struct FileState {
+    uint64_t size = 0;
+    int64_t time = 0;
+};
+
+static bool StatFile(const std::filesystem::path& path, FileState& out) {
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return false;
+    }
+    auto time = std::filesystem::last_write_time(path, ec);
+    if (ec) {
+        return false;
+    }
+    out.size = size;
+    out.time = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+static bool HashFile(const std::filesystem::path& path, uint64_t& hash) {
+    MappedFile file;
+    std::string error;
+    if (!file.Open(path, error)) {
+        return false;
+    }
+    hash = Hash64({file.GetData(), file.GetSize()});
+    return true;
+}
+
+// The input hash a conversion of job would record, read in chunks so long
+// inputs cost no memory.
+static bool HashInput(const ConvertJob& job, const ConvertOptions& options, uint64_t& hash) {
+    WavStreamReader reader;
+    std::string error;
+    if (!reader.Open(job.inputPath, error, options.dither)) {
+        return false;
+    }
+    Hash64Stream pcm;
+    std::vector<int16_t> chunk(kHashChunkSamples);
+    uint64_t total = 0;
+    while (size_t read = reader.Read(chunk.data(), chunk.size())) {
+        pcm.Update({reinterpret_cast<const uint8_t*>(chunk.data()), read * sizeof(int16_t)});
+        total += read;
+    }
+    if (total != reader.GetSampleCount()) {
+        return false;
+    }
+    hash = ConversionCacheKey(pcm.Digest(), total, reader.GetSampleRate(), job, options);
+    return true;
+}
+
+// True when the file still matches the recorded state. A file with a new
+// time but the same size is hashed with rehash, and its recorded time
+// refreshed when the content turns out unchanged.
+template <typename Rehash>
+static bool FileMatches(const std::filesystem::path& path, uint64_t size, int64_t& time, uint64_t hash, Rehash rehash) {
+    FileState state;
+    if (!StatFile(path, state) || state.size != size) {
+        return false;
+    }
+    if (state.time == time) {
+        return true;
+    }
+    uint64_t current = 0;
+    if (!rehash(current) || current != hash) {
+        return false;
+    }
+    time = state.time;
+    return true;
+}
+
+// Archive entries are compared by size and CRC-32 from the directory, which
+// is as cheap as a stat.
+static bool EntryMatches(const O2rArchive& archive, const std::string& outputName, uint64_t size, uint64_t crc) {
+    O2rArchive::EntryInfo info;
+    return archive.FindEntry(archive.ResourcePath(outputName), info) && info.size == size && info.crc == crc;
+}
+
+static std::filesystem::path NormalizeInput(const std::filesystem::path& input) {
+    std::error_code ec;
+    std::filesystem::path absolute = std::filesystem::absolute(input, ec);
+    return (ec ? input : absolute).lexically_normal();
+}
+
+static bool SettingsMatch(const ManifestEntry& entry, const ConvertJob& job, const ConvertOptions& options) {
+    if (entry.predictorCount != options.predictorCount || entry.targetSnrDb != options.targetSnrDb ||
+        entry.loopEnabled != job.loopEnabled || entry.targetSampleRate != job.targetSampleRate ||
+        entry.dither != options.dither) {
+        return false;
+    }
+    return !job.loopEnabled ||
+           (entry.loopStart == job.loopStart && entry.loopEnd == job.loopEnd && entry.loopCount == job.loopCount);
+}
+
+static bool ParseU64(const std::string& text, int base, uint64_t& out) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    out = std::strtoull(text.c_str(), &end, base);
+    return end && *end == '\0';
+}
+
+static bool ParseI64(const std::string& text, int64_t& out) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    out = std::strtoll(text.c_str(), &end, 10);
+    return end && *end == '\0';
+}
+
+static bool ParseDouble(const std::string& text, double& out) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    out = std::strtod(text.c_str(), &end);
+    return end && *end == '\0';
+}
+
+static bool ParseEntry(const std::string& line, ManifestEntry& entry) {
+    std::vector<std::string> fields;
+    std::stringstream stream(line);
+    std::string field;
+    while (std::getline(stream, field, '\t')) {
+        fields.push_back(field);
+    }
+    if (fields.size() != kFieldCount || fields[0].empty()) {
+        return false;
+    }
+
+    uint64_t predictorCount = 0;
+    uint64_t loopEnabled = 0;
+    uint64_t loopStart = 0;
+    uint64_t loopEnd = 0;
+    int64_t loopCount = 0;
+    uint64_t targetSampleRate = 0;
+    uint64_t dither = 0;
+    uint64_t loopSearched = 0;
+    uint64_t searchLoopEnd = 0;
+    bool ok = ParseU64(fields[2], 10, entry.inputSize) && ParseI64(fields[3], entry.inputTime) &&
+              ParseU64(fields[4], 16, entry.inputHash) && ParseU64(fields[5], 10, predictorCount) &&
+              ParseDouble(fields[6], entry.targetSnrDb) && ParseU64(fields[7], 10, loopEnabled) &&
+              ParseU64(fields[8], 10, loopStart) && ParseU64(fields[9], 10, loopEnd) &&
+              ParseI64(fields[10], loopCount) && ParseU64(fields[11], 10, targetSampleRate) &&
+              ParseU64(fields[12], 10, dither) && ParseU64(fields[13], 10, loopSearched) &&
+              ParseU64(fields[14], 10, searchLoopEnd) && ParseU64(fields[15], 10, entry.outputSize) &&
+              ParseI64(fields[16], entry.outputTime) && ParseU64(fields[17], 16, entry.outputHash);
+    if (!ok) {
+        return false;
+    }
+
+    entry.outputName = fields[0];
+    entry.inputPath = Utf8ToPath(fields[1]);
+    entry.predictorCount = static_cast<int>(predictorCount);
+    entry.loopEnabled = loopEnabled != 0;
+    entry.loopStart = static_cast<uint32_t>(loopStart);
+    entry.loopEnd = static_cast<uint32_t>(loopEnd);
+    entry.loopCount = static_cast<int32_t>(loopCount);
+    entry.targetSampleRate = static_cast<uint32_t>(targetSampleRate);
+    entry.dither = dither != 0;
+    entry.loopSearched = loopSearched != 0;
+    entry.searchLoopEnd = static_cast<uint32_t>(searchLoopEnd);
+    return true;
+}
+
+std::filesystem::path ConversionManifest::PathFor(const std::filesystem::path& outputDir) {
+    std::error_code ec;
+    std::filesystem::path dir = std::filesystem::absolute(outputDir, ec).lexically_normal();
+    if (!dir.has_filename()) {
+        dir = dir.parent_path();
+    }
+    if (!dir.has_filename()) {
+        // A filesystem root has nothing to sit next to.
+        return dir / ".soh-audio.manifest";
+    }
+    std::filesystem::path manifest = dir;
+    manifest += ".manifest";
+    return manifest;
+}
+
+bool ConversionManifest::Load(const std::filesystem::path& outputDir, std::string& error, const O2rArchive* archive) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->outputDir = outputDir;
+    this->archive = archive;
+    path = PathFor(outputDir);
+    entries.clear();
+
+    std::error_code ec;
+    if (!std::filesystem::exists(path, ec)) {
+        return true;
+    }
+    std::ifstream file(path);
+    if (!file) {
+        error = "Failed to open manifest " + PathToUtf8(path) + ".";
+        return false;
+    }
+
+    std::string line;
+    if (!std::getline(file, line) || line != kManifestHeader) {
+        // Older or foreign format: start over.
+        return true;
+    }
+    while (std::getline(file, line)) {
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        ManifestEntry entry;
+        if (ParseEntry(line, entry)) {
+            entries[entry.outputName] = std::move(entry);
+        }
+    }
+    return true;
+}
+
+bool ConversionManifest::Save(std::string& error) const {
+    std::vector<const ManifestEntry*> sorted;
+    std::string text = std::string(kManifestHeader) + "\n";
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& [name, entry] : entries) {
+            if (OutputExists(name)) {
+                sorted.push_back(&entry);
+            }
+        }
+        std::sort(sorted.begin(), sorted.end(), [](const ManifestEntry* a, const ManifestEntry* b) {
+            return a->outputName < b->outputName;
+        });
+
+        char numbers[256];
+        for (const ManifestEntry* entry : sorted) {
+            text += entry->outputName;
+            text += '\t';
+            text += PathToUtf8(entry->inputPath);
+            std::snprintf(numbers, sizeof(numbers),
+                          "\t%" PRIu64 "\t%" PRId64 "\t%016" PRIx64 "\t%d\t%.17g\t%d\t%" PRIu32 "\t%" PRIu32
+                          "\t%" PRId32 "\t%" PRIu32 "\t%d\t%d\t%" PRIu32 "\t%" PRIu64 "\t%" PRId64 "\t%016" PRIx64 "\n",
+                          entry->inputSize, entry->inputTime, entry->inputHash, entry->predictorCount,
+                          entry->targetSnrDb, entry->loopEnabled ? 1 : 0, entry->loopStart, entry->loopEnd, entry->loopCount,
+                          entry->targetSampleRate, entry->dither ? 1 : 0, entry->loopSearched ? 1 : 0,
+                          entry->searchLoopEnd, entry->outputSize, entry->outputTime, entry->outputHash);
+            text += numbers;
+        }
+    }
+
+    // Write beside the old manifest and swap, so an interrupted save keeps
+    // the previous one.
+    std::filesystem::path temp = path;
+    temp += ".tmp";
+    std::span<const uint8_t> segments[] = {{reinterpret_cast<const uint8_t*>(text.data()), text.size()}};
+    if (!WriteFileSegments(temp, segments, error)) {
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+        std::filesystem::remove(temp, ec);
+        error = "Failed to write manifest " + PathToUtf8(path) + ".";
+        return false;
+    }
+    return true;
+}
+
+bool ConversionManifest::IsUpToDate(const ConvertJob& job,
+                                    const ConvertOptions& options,
+                                    const std::filesystem::path& outPath) {
+    ScopedStageTimer timer(ProfileStage::Manifest);
+    ManifestEntry entry;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(job.outputName);
+        if (it == entries.end()) {
+            return false;
+        }
+        entry = it->second;
+    }
+
+    if (entry.inputPath != NormalizeInput(job.inputPath) || !SettingsMatch(entry, job, options)) {
+        return false;
+    }
+    if (!FileMatches(entry.inputPath, entry.inputSize, entry.inputTime, entry.inputHash,
+                     [&](uint64_t& hash) { return HashInput(job, options, hash); })) {
+        return false;
+    }
+    if (archive ? !EntryMatches(*archive, job.outputName, entry.outputSize, entry.outputHash)
+                : !FileMatches(outPath, entry.outputSize, entry.outputTime, entry.outputHash,
+                               [&](uint64_t& hash) { return HashFile(outPath, hash); })) {
+        return false;
+    }
+
+    // Keep any refreshed times so the next run skips the hash.
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(job.outputName);
+    if (it != entries.end() && it->second.inputHash == entry.inputHash && it->second.outputHash == entry.outputHash) {
+        it->second.inputTime = entry.inputTime;
+        it->second.outputTime = entry.outputTime;
+    }
+    return true;
+}
+
+bool ConversionManifest::ReuseLoopSearch(ConvertJob& job,
+                                         const ConvertOptions& options,
+                                         const std::filesystem::path& outPath) {
+    ConvertJob searched = job;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(job.outputName);
+        if (it == entries.end() || !it->second.loopSearched || it->second.searchLoopEnd != job.loopEnd) {
+            return false;
+        }
+        searched.loopStart = it->second.loopStart;
+        searched.loopEnd = it->second.loopEnd;
+    }
+    searched.loopSearched = true;
+    searched.searchLoopEnd = job.loopEnd;
+    // The search depends only on the input and settings the full check
+    // covers, so an output that is up to date also has a current loop.
+    if (!IsUpToDate(searched, options, outPath)) {
+        return false;
+    }
+    job = std::move(searched);
+    return true;
+}
+
+void ConversionManifest::StatInput(const std::filesystem::path& inputPath, ManifestRecord& record) {
+    FileState state;
+    if (StatFile(inputPath, state)) {
+        record.inputSize = state.size;
+        record.inputTime = state.time;
+    }
+}
+
+void ConversionManifest::Record(const ConvertJob& job,
+                                const ConvertOptions& options,
+                                const std::filesystem::path& outPath,
+                                const ManifestRecord& record) {
+    ScopedStageTimer timer(ProfileStage::Manifest);
+    ManifestEntry entry;
+    entry.outputName = job.outputName;
+    entry.inputPath = NormalizeInput(job.inputPath);
+    entry.predictorCount = options.predictorCount;
+    entry.targetSnrDb = options.targetSnrDb;
+    entry.loopEnabled = job.loopEnabled;
+    entry.targetSampleRate = job.targetSampleRate;
+    entry.dither = options.dither;
+    if (job.loopEnabled) {
+        entry.loopStart = job.loopStart;
+        entry.loopEnd = job.loopEnd;
+        entry.loopCount = job.loopCount;
+        entry.loopSearched = job.loopSearched;
+        entry.searchLoopEnd = job.searchLoopEnd;
+    }
+
+    // Only the output's directory entry is looked at; its hash is the one
+    // taken over the bytes as they were written.
+    FileState output;
+    bool ok = record.inputSize != 0;
+    entry.inputHash = record.inputHash;
+    if (archive) {
+        O2rArchive::EntryInfo info;
+        ok = ok && archive->FindEntry(archive->ResourcePath(job.outputName), info);
+        output.size = info.size;
+        entry.outputHash = info.crc;
+    } else {
+        ok = ok && StatFile(outPath, output);
+        entry.outputHash = record.outputHash;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!ok) {
+        // Without a full record the output is simply rebuilt next time.
+        entries.erase(job.outputName);
+        return;
+    }
+    entry.inputSize = record.inputSize;
+    entry.inputTime = record.inputTime;
+    entry.outputSize = output.size;
+    entry.outputTime = output.time;
+    entries[entry.outputName] = std::move(entry);
+}
+
+std::vector<ManifestEntry> ConversionManifest::FindOrphans() const {
+    std::vector<ManifestEntry> orphans;
+    std::lock_guard<std::mutex> lock(mutex);
+    for (const auto& [name, entry] : entries) {
+        std::error_code ec;
+        if (!std::filesystem::exists(entry.inputPath, ec) && OutputExists(name)) {
+            orphans.push_back(entry);
+        }
+    }
+    std::sort(orphans.begin(), orphans.end(), [](const ManifestEntry& a, const ManifestEntry& b) {
+        return a.outputName < b.outputName;
+    });
+    return orphans;
+}
+
+bool ConversionManifest::OutputExists(const std::string& outputName) const {
+    if (archive) {
+        O2rArchive::EntryInfo info;
+        return archive->FindEntry(archive->ResourcePath(outputName), info);
+    }
+    std::error_code ec;
+    return std::filesystem::exists(outputDir / Utf8ToPath(outputName), ec);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "Convert.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class O2rArchive;
+
+// What one output was built from. Times are file clock ticks. The input hash
+// is the ConversionCacheKey of the PCM the encoder was given, the output hash
+// Hash64 of the whole file. Outputs inside an archive record the entry's
+// CRC-32 as their hash and no time.
+struct ManifestEntry {
+    std::string outputName;
+    std::filesystem::path inputPath;
+    uint64_t inputSize = 0;
+    int64_t inputTime = 0;
+    uint64_t inputHash = 0;
+    int predictorCount = 0;
+    double targetSnrDb = 0.0;
+    bool loopEnabled = false;
+    uint32_t loopStart = 0;
+    uint32_t loopEnd = 0;
+    int32_t loopCount = -1;
+    uint32_t targetSampleRate = 0;
+    bool dither = false;
+    bool loopSearched = false;
+    uint32_t searchLoopEnd = 0;
+    uint64_t outputSize = 0;
+    int64_t outputTime = 0;
+    uint64_t outputHash = 0;
+};
+
+// What a conversion measured as it ran, so recording it reads neither file
+// again.
+struct ManifestRecord {
+    // Taken before the input is read: an edit made while it converts then
+    // shows up as a changed time on the next run.
+    uint64_t inputSize = 0;
+    int64_t inputTime = 0;
+    // ConversionCacheKey of the samples that were encoded.
+    uint64_t inputHash = 0;
+    // Hash64 of the resource written; unused for archive outputs.
+    uint64_t outputHash = 0;
+};
+
+// Make-style record of an output folder, stored next to it as
+// "<folder>.manifest". A job is up to date when its settings match the
+// recorded ones and neither its input nor its output changed. Files whose
+// size and time still match are trusted without being read; a changed time
+// with the same content only costs reading and hashing it. Safe to query and
+// update from several workers at once.
+class ConversionManifest {
+public:
+    static std::filesystem::path PathFor(const std::filesystem::path& outputDir);
+
+    // A missing manifest loads as empty. Unreadable lines are dropped, which
+    // only means those outputs get rebuilt. With an archive, outputs are its
+    // entries and outputDir is the archive's path.
+    bool Load(const std::filesystem::path& outputDir, std::string& error, const O2rArchive* archive = nullptr);
+    bool Save(std::string& error) const;
+
+    // Fills in the input's size and time; they stay zero, which never
+    // matches, when it cannot be read.
+    static void StatInput(const std::filesystem::path& inputPath, ManifestRecord& record);
+
+    bool IsUpToDate(const ConvertJob& job, const ConvertOptions& options, const std::filesystem::path& outPath);
+    // For a job whose loop is about to be searched for, ending at its
+    // loopEnd: when the recorded output came from the same search and is
+    // still up to date, gives the job the loop points it found and returns
+    // true, so the search can be skipped.
+    bool ReuseLoopSearch(ConvertJob& job, const ConvertOptions& options, const std::filesystem::path& outPath);
+    // Records a freshly written output from what its conversion measured.
+    void Record(const ConvertJob& job,
+                const ConvertOptions& options,
+                const std::filesystem::path& outPath,
+                const ManifestRecord& record);
+    // Entries whose input file no longer exists; their outputs are stale.
+    // Entries whose output is gone as well are forgotten on the next Save.
+    std::vector<ManifestEntry> FindOrphans() const;
+
+private:
+    bool OutputExists(const std::string& outputName) const;
+
+    std::filesystem::path outputDir;
+    const O2rArchive* archive = nullptr;
+    std::filesystem::path path;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, ManifestEntry> entries;
+};
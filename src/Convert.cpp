@@ -0,0 +1,582 @@
+#include "Convert.h"
+
+#include "AudioFormats.h"
+#include "BinaryWriter.h"
+#include "ConversionCache.h"
+#include "ConversionDedup.h"
+#include "ConversionManifest.h"
+#include "ConvertBuffers.h"
+#include "Hash64.h"
+#include "MappedFile.h"
+#include "O2rArchive.h"
+#include "PathUtils.h"
+#include "Resampler.h"
+#include "SohSampleWriter.h"
+#include "VadpcmStream.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <exception>
+#include <optional>
+#include <system_error>
+#include <thread>
+
+extern "C" {
+#include "codec/vadpcm.h"
+}
+
+const char* ConvertStageName(ConvertStage stage) {
+    switch (stage) {
+        case ConvertStage::Queued:
+            return "Queued";
+        case ConvertStage::Reading:
+            return "Reading";
+        case ConvertStage::Encoding:
+            return "Encoding";
+        case ConvertStage::Writing:
+            return "Writing";
+        case ConvertStage::Done:
+            return "OK";
+        case ConvertStage::Failed:
+            return "Failed";
+        case ConvertStage::Cancelled:
+            return "Cancelled";
+    }
+    return "";
+}
+
+// Inputs at least this long (about 4 minutes at 32 kHz) go through the
+// two-pass streaming encoder so memory use stays flat.
+static constexpr size_t kStreamEncodeMinSamples = size_t(1) << 23;
+
+static void SetStage(ConvertProgress* progress, ConvertStage stage) {
+    if (progress) {
+        progress->stage.store(stage, std::memory_order_relaxed);
+    }
+}
+
+static bool IsCancelled(const std::atomic<bool>* cancel, std::string& status) {
+    if (cancel && cancel->load(std::memory_order_relaxed)) {
+        status = ConvertStageName(ConvertStage::Cancelled);
+        return true;
+    }
+    return false;
+}
+
+// Full reference decode, cross-checked against the silence test and the loop
+// state taken from the prefix decode.
+static bool VerifyEncoded(const VadpcmAifc& aifc,
+                          const SohSampleData& sample,
+                          std::vector<int16_t>& decoded,
+                          std::string& status) {
+    ScopedStageTimer timer(ProfileStage::Verify);
+    std::string error;
+    if (!DecodeVadpcm(aifc, decoded, error)) {
+        status = "Verify failed: " + error;
+        return false;
+    }
+    if (decoded.size() < sample.sampleCount) {
+        status = "Verify failed: decoded audio is shorter than the input.";
+        return false;
+    }
+    bool silent = std::all_of(decoded.begin(), decoded.end(), [](int16_t value) { return value == 0; });
+    if (silent) {
+        status = "Verify failed: decoded audio is silent.";
+        return false;
+    }
+    if (sample.loopEnabled && BuildLoopState(decoded, sample.loopStart) != sample.loopState) {
+        status = "Verify failed: loop state does not match the decoded audio.";
+        return false;
+    }
+    return true;
+}
+
+bool IsWavPath(const std::filesystem::path& path) {
+    std::string ext = path.extension().string();
+    for (char& ch : ext) {
+        ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    }
+    return ext == ".wav";
+}
+
+std::string DefaultOutputName(const std::filesystem::path& path) {
+    return PathToUtf8(path.stem());
+}
+
+std::array<int16_t, 16> BuildLoopState(const std::vector<int16_t>& samples, uint32_t loopStart) {
+    std::array<int16_t, 16> state{};
+    if (samples.empty()) {
+        return state;
+    }
+
+    if (loopStart >= 16) {
+        for (size_t i = 0; i < 16; i++) {
+            state[i] = samples[loopStart - 16 + i];
+        }
+    } else {
+        size_t pad = 16 - loopStart;
+        for (size_t i = 0; i < pad; i++) {
+            state[i] = 0;
+        }
+        for (size_t i = 0; i < loopStart; i++) {
+            state[pad + i] = samples[i];
+        }
+    }
+
+    return state;
+}
+
+// Puts a finished resource where the options say outputs go.
+static bool StoreOutput(const ConvertJob& job,
+                        const std::filesystem::path& outPath,
+                        const ConvertOptions& options,
+                        std::span<const uint8_t> resource,
+                        std::string& error) {
+    if (options.archive) {
+        return options.archive->AddEntry(options.archive->ResourcePath(job.outputName), resource, error);
+    }
+    std::span<const uint8_t> segments[] = {resource};
+    return WriteFileSegments(outPath, segments, error);
+}
+
+static bool RestoreCached(const ConversionCache::Ticket& ticket,
+                          const ConvertJob& job,
+                          const std::filesystem::path& outPath,
+                          const ConvertOptions& options,
+                          ManifestRecord* record,
+                          std::string& error) {
+    if (!options.archive) {
+        return ticket.Restore(outPath, error, record ? &record->outputHash : nullptr);
+    }
+    std::vector<uint8_t> resource;
+    return ticket.Load(resource, error) && StoreOutput(job, outPath, options, resource, error);
+}
+
+// Copies the output an earlier job of the batch made from the same input.
+static bool CopyDuplicate(const ConversionDedup::Output& source,
+                          const ConvertJob& job,
+                          const std::filesystem::path& outPath,
+                          const ConvertOptions& options,
+                          ManifestRecord* record,
+                          std::string& error) {
+    if (options.archive) {
+        std::vector<uint8_t> resource;
+        return options.archive->ReadEntry(options.archive->ResourcePath(source.outputName), resource, error) &&
+               StoreOutput(job, outPath, options, resource, error);
+    }
+    if (record) {
+        record->outputHash = source.resourceHash;
+    }
+    std::error_code ec;
+    if (std::filesystem::equivalent(source.path, outPath, ec)) {
+        return true;
+    }
+    std::filesystem::copy_file(source.path, outPath, std::filesystem::copy_options::overwrite_existing, ec);
+    if (ec) {
+        error = "Failed to copy " + PathToUtf8(source.path) + ": " + ec.message();
+        return false;
+    }
+    return true;
+}
+
+// What duplicates of this job will copy once it has written outPath.
+static ConversionDedup::Output DedupOutput(const ConvertJob& job,
+                                          const std::filesystem::path& outPath,
+                                          const ManifestRecord* record) {
+    return {outPath, job.outputName, record ? record->outputHash : 0};
+}
+
+// The streaming encoder writes to a file, so archive outputs go through a
+// temporary one next to the archive.
+static std::filesystem::path StreamTempPath(const ConvertOptions& options) {
+    std::filesystem::path temp = options.archive->GetPath();
+    char suffix[32];
+    std::snprintf(suffix, sizeof(suffix), ".%zx.part", std::hash<std::thread::id>()(std::this_thread::get_id()));
+    temp += suffix;
+    return temp;
+}
+
+// Long inputs that are not resampled. The cache is consulted once the first
+// pass has hashed the input, before any encoding.
+static bool WriteStreamedSample(const ConvertJob& job,
+                                const std::filesystem::path& outPath,
+                                const ConvertOptions& options,
+                                std::string& status,
+                                ConvertProgress* progress,
+                                const std::atomic<bool>* cancel,
+                                ManifestRecord* record) {
+    std::string error;
+    std::error_code ec;
+    ConversionDedup::Ticket dedupTicket;
+    ConversionCache::Ticket ticket;
+    const char* restored = nullptr;
+    auto inputReady = [&](uint64_t key) {
+        if (record) {
+            record->inputHash = key;
+        }
+        if (options.dedup) {
+            dedupTicket = options.dedup->Claim(key);
+            if (dedupTicket.IsDuplicate()) {
+                ScopedStageTimer timer(ProfileStage::Write);
+                if (CopyDuplicate(dedupTicket.GetOutput(), job, outPath, options, record, error)) {
+                    restored = "OK (duplicate)";
+                    return false;
+                }
+            }
+        }
+        if (options.cache) {
+            ticket = options.cache->Claim(key);
+            if (ticket.IsHit()) {
+                ScopedStageTimer timer(ProfileStage::Write);
+                if (RestoreCached(ticket, job, outPath, options, record, error)) {
+                    restored = "OK (cached)";
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+
+    SetStage(progress, ConvertStage::Encoding);
+    StreamEncodeResult result;
+    std::filesystem::path streamPath = options.archive ? StreamTempPath(options) : outPath;
+    if (!StreamConvertSample(job, streamPath, options, result, status, cancel, inputReady)) {
+        if (options.archive) {
+            std::filesystem::remove(streamPath, ec);
+        }
+        return false;
+    }
+    if (restored) {
+        dedupTicket.Finish(DedupOutput(job, outPath, record));
+        status = restored;
+        return true;
+    }
+    if (progress) {
+        progress->predictorChoice = result.predictorChoice;
+    }
+    if (record) {
+        record->outputHash = result.resourceHash;
+    }
+    if (options.archive || options.cache) {
+        ScopedStageTimer timer(ProfileStage::Write);
+        MappedFile written;
+        bool ok = written.Open(streamPath, error);
+        if (ok && options.archive) {
+            ok = StoreOutput(job, outPath, options, {written.GetData(), written.GetSize()}, error);
+        }
+        if (ok && options.cache) {
+            ticket.Store({written.GetData(), written.GetSize()});
+        }
+        written.Close();
+        if (options.archive) {
+            std::filesystem::remove(streamPath, ec);
+            if (!ok) {
+                status = "Write error: " + error;
+                return false;
+            }
+        }
+    }
+    dedupTicket.Finish(DedupOutput(job, outPath, record));
+    return true;
+}
+
+// record, when given, gets the hashes of what was read and written.
+static bool WriteConvertedSample(const ConvertJob& job,
+                                 const std::filesystem::path& outputDir,
+                                 const ConvertOptions& options,
+                                 std::string& status,
+                                 ConvertProgress* progress,
+                                 const std::atomic<bool>* cancel,
+                                 ConvertBuffers& buffers,
+                                 ManifestRecord* record) {
+    if (IsCancelled(cancel, status)) {
+        return false;
+    }
+
+    // The header decides the route before any audio is read: converting a
+    // long input eagerly would hold all of it in memory.
+    SetStage(progress, ConvertStage::Reading);
+    std::string error;
+    WavInfo info;
+    if (!ProbeWavFile(job.inputPath, info, error)) {
+        status = "WAV error: " + error;
+        return false;
+    }
+
+    if (job.outputName.empty()) {
+        status = "Output name is empty.";
+        return false;
+    }
+
+    if (outputDir.empty() && !options.archive) {
+        status = "Output folder is empty.";
+        return false;
+    }
+
+    if (progress) {
+        progress->sampleCount.store(static_cast<uint32_t>(info.sampleCount), std::memory_order_relaxed);
+    }
+    if (IsCancelled(cancel, status)) {
+        return false;
+    }
+
+    // Several workers may race to create the same folder; only the final
+    // state matters. Names from a folder scan carry their subfolders.
+    std::filesystem::path outPath = outputDir / Utf8ToPath(job.outputName);
+    std::error_code ec;
+    if (!options.archive) {
+        std::filesystem::create_directories(outPath.parent_path(), ec);
+    }
+
+    bool resample = job.targetSampleRate != 0 && job.targetSampleRate != info.sampleRate;
+    if (!resample && info.sampleCount >= kStreamEncodeMinSamples) {
+        return WriteStreamedSample(job, outPath, options, status, progress, cancel, record);
+    }
+
+    PcmView& wav = buffers.wav;
+    if (!OpenWavView(job.inputPath, wav, error, options.dither)) {
+        status = "WAV error: " + error;
+        return false;
+    }
+    if (IsCancelled(cancel, status)) {
+        return false;
+    }
+
+    // The dedup claim blocks while another worker is converting the same
+    // key, then either hands back its output or makes this worker the one
+    // converting it. A duplicate or cache hit that cannot be copied just
+    // converts normally.
+    ConversionDedup::Ticket dedupTicket;
+    ConversionCache::Ticket ticket;
+    uint64_t key = 0;
+    if (options.dedup || options.cache || record) {
+        key = ConversionCacheKey(wav.samples, wav.sampleRate, job, options);
+    }
+    if (record) {
+        record->inputHash = key;
+    }
+    if (options.dedup) {
+        dedupTicket = options.dedup->Claim(key);
+        if (dedupTicket.IsDuplicate()) {
+            ScopedStageTimer timer(ProfileStage::Write);
+            if (CopyDuplicate(dedupTicket.GetOutput(), job, outPath, options, record, error)) {
+                status = "OK (duplicate)";
+                return true;
+            }
+        }
+    }
+    if (options.cache) {
+        ticket = options.cache->Claim(key);
+        if (ticket.IsHit()) {
+            ScopedStageTimer timer(ProfileStage::Write);
+            if (RestoreCached(ticket, job, outPath, options, record, error)) {
+                dedupTicket.Finish(DedupOutput(job, outPath, record));
+                status = "OK (cached)";
+                return true;
+            }
+        }
+    }
+
+    // Resampled audio is encoded in memory, however long it is.
+    std::vector<int16_t>& resampled = buffers.resampled;
+    uint32_t inputRate = wav.sampleRate;
+    size_t inputSampleCount = wav.samples.size();
+    if (resample) {
+        ScopedStageTimer timer(ProfileStage::Resample);
+        if (!ResamplePcm(wav.samples, wav.sampleRate, job.targetSampleRate, resampled, error, &buffers.resampleWork)) {
+            status = "Resample failed: " + error;
+            return false;
+        }
+        wav.samples = resampled;
+        wav.sampleRate = job.targetSampleRate;
+        if (IsCancelled(cancel, status)) {
+            return false;
+        }
+    }
+
+    SetStage(progress, ConvertStage::Encoding);
+    VadpcmAifc& aifc = buffers.aifc;
+    if (options.targetSnrDb > 0.0) {
+        PredictorChoice choice;
+        if (!SearchPredictorCount(wav.samples, wav.sampleRate, options.predictorCount, options.targetSnrDb, aifc,
+                                  choice, error, cancel, options.parallelSearch)) {
+            if (!IsCancelled(cancel, status)) {
+                status = "VADPCM encode failed: " + error;
+            }
+            return false;
+        }
+        if (progress) {
+            progress->predictorChoice = choice;
+        }
+    } else {
+        ScopedStageTimer timer(ProfileStage::Encode);
+        if (!EncodeVadpcm(wav.samples, wav.sampleRate, options.predictorCount, aifc, error, &buffers.padded)) {
+            status = "VADPCM encode failed: " + error;
+            return false;
+        }
+    }
+
+    if (IsVadpcmSilent(aifc.adpcmData)) {
+        status = "Encoded audio is silent.";
+        return false;
+    }
+
+    SohSampleData& outputSample = buffers.sample;
+    outputSample.sampleCount = static_cast<uint32_t>(wav.samples.size());
+    outputSample.loopEnabled = false;
+    outputSample.order = aifc.order;
+    outputSample.predictors = aifc.predictors;
+
+    if (job.loopEnabled) {
+        size_t frameCount = aifc.adpcmData.size() / kVADPCMFrameByteSize;
+        if (frameCount == 0) {
+            status = "Decoded audio is empty.";
+            return false;
+        }
+        uint32_t maxIndex = static_cast<uint32_t>(frameCount * kVADPCMFrameSampleCount - 1);
+        uint32_t loopStart = job.loopStart;
+        uint32_t loopEnd = job.loopEnd;
+        if (resample) {
+            // Rounding can carry a point on the WAV's last sample one past
+            // the resampled audio; points the WAV itself had are pulled back
+            // in, anything further out still fails below.
+            loopStart = ResamplePosition(loopStart, inputRate, wav.sampleRate);
+            loopEnd = ResamplePosition(loopEnd, inputRate, wav.sampleRate);
+            if (job.loopStart < inputSampleCount) {
+                loopStart = std::min(loopStart, maxIndex);
+            }
+            if (job.loopEnd < inputSampleCount) {
+                loopEnd = std::min(loopEnd, maxIndex);
+            }
+        }
+        if (loopEnd == 0) {
+            loopEnd = maxIndex;
+        }
+
+        if (loopStart > loopEnd || loopEnd > maxIndex) {
+            status = "Invalid loop range. Max index = " + std::to_string(maxIndex) + ".";
+            return false;
+        }
+
+        // The loop state is the 16 decoded samples before loopStart, so only
+        // the frames up to it need decoding.
+        std::vector<int16_t>& prefix = buffers.decoded;
+        size_t prefixFrames = (static_cast<size_t>(loopStart) + kVADPCMFrameSampleCount - 1) / kVADPCMFrameSampleCount;
+        ScopedStageTimer timer(ProfileStage::Decode);
+        if (!DecodeVadpcmPrefix(aifc, prefixFrames, prefix, error)) {
+            status = "VADPCM decode failed: " + error;
+            return false;
+        }
+
+        outputSample.loopEnabled = true;
+        outputSample.loopStart = loopStart;
+        outputSample.loopEnd = loopEnd;
+        outputSample.loopCount = job.loopCount;
+        outputSample.loopState = BuildLoopState(prefix, loopStart);
+    }
+
+    if (options.verify && !VerifyEncoded(aifc, outputSample, buffers.decoded, status)) {
+        return false;
+    }
+
+    // Swapped rather than moved so both keep a buffer for the next sample.
+    outputSample.adpcmData.swap(aifc.adpcmData);
+    outputSample.book.swap(aifc.book);
+
+    if (IsCancelled(cancel, status)) {
+        return false;
+    }
+
+    SetStage(progress, ConvertStage::Writing);
+    ScopedStageTimer timer(ProfileStage::Write);
+    // Archives need the whole resource in memory; a plain file is written
+    // straight from the payload with only the framing built, and the cache
+    // takes the same pieces.
+    std::vector<uint8_t>& resource = buffers.resource;
+    resource.clear();
+    std::array<std::span<const uint8_t>, 3> segments{};
+    bool stored = false;
+    if (options.archive) {
+        SerializeSohSample(outputSample, resource);
+        segments[0] = resource;
+        stored = StoreOutput(job, outPath, options, resource, error);
+    } else {
+        segments = FrameSohSample(outputSample, resource);
+        stored = WriteFileSegments(outPath, segments, error);
+        if (record) {
+            Hash64Stream hash;
+            for (const auto& segment : segments) {
+                hash.Update(segment);
+            }
+            record->outputHash = hash.Digest();
+        }
+    }
+    if (!stored) {
+        status = "Write error: " + error;
+        return false;
+    }
+    if (options.cache) {
+        ticket.Store(segments);
+    }
+    dedupTicket.Finish(DedupOutput(job, outPath, record));
+
+    status = "OK";
+    return true;
+}
+
+bool ConvertSample(const ConvertJob& job,
+                   const std::filesystem::path& outputDir,
+                   const ConvertOptions& options,
+                   std::string& status,
+                   ConvertProgress* progress,
+                   const std::atomic<bool>* cancel,
+                   ConvertBuffers* buffers) {
+    std::optional<ProfileScope> profile;
+    if (options.profile || options.trace) {
+        profile.emplace(options.profile && progress ? &progress->timings : nullptr, options.trace, job.outputName);
+    }
+
+    std::filesystem::path outPath = outputDir / Utf8ToPath(job.outputName);
+    if (options.manifest && options.incremental && !job.outputName.empty() && (!outputDir.empty() || options.archive) &&
+        options.manifest->IsUpToDate(job, options, outPath)) {
+        status = "Up to date";
+        return true;
+    }
+
+    std::optional<ConvertBuffers> localBuffers;
+    if (!buffers) {
+        buffers = &localBuffers.emplace();
+    }
+    // Stat before the input is read; the hashes come from the conversion.
+    ManifestRecord record;
+    if (options.manifest) {
+        ConversionManifest::StatInput(job.inputPath, record);
+    }
+
+    buffers->BeginItem();
+    // Running out of memory on one huge input, or a filesystem exception,
+    // fails that sample rather than the whole batch.
+    bool ok = false;
+    try {
+        ok = WriteConvertedSample(job, outputDir, options, status, progress, cancel, *buffers,
+                                  options.manifest ? &record : nullptr);
+    } catch (const std::exception& e) {
+        status = std::string("Error: ") + e.what();
+    }
+    uint32_t allocations = buffers->EndItem();
+    if (options.profile && progress) {
+        progress->timings.pcmBytes = static_cast<uint64_t>(progress->sampleCount.load(std::memory_order_relaxed)) * 2;
+        progress->timings.bufferAllocations = allocations;
+    }
+    if (!ok) {
+        if (progress) {
+            progress->predictorChoice.reset();
+        }
+        return false;
+    }
+    if (options.manifest) {
+        options.manifest->Record(job, options, outPath, record);
+    }
+    return true;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "PredictorSearch.h"
+#include "Profiler.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+class ConversionCache;
+class ConversionDedup;
+class ConversionManifest;
+struct ConvertBuffers;
+class O2rArchive;
+class TraceRecorder;
+
+struct ConvertJob {
+    std::filesystem::path inputPath;
+    // UTF-8, relative to the output folder; '/' separates subfolders.
+    std::string outputName;
+    bool loopEnabled = false;
+    uint32_t loopStart = 0;
+    uint32_t loopEnd = 0;
+    int32_t loopCount = -1;
+    // Resamples the input to this rate before encoding; 0 keeps the WAV's
+    // own rate. Loop points stay in input samples and are scaled with it.
+    uint32_t targetSampleRate = 0;
+    // Set when a loop search picked loopStart and loopEnd; searchLoopEnd is
+    // the end it was asked for. Recorded so a later run can reuse it.
+    bool loopSearched = false;
+    uint32_t searchLoopEnd = 0;
+};
+
+enum class ConvertStage : uint8_t {
+    Queued,
+    Reading,
+    Encoding,
+    Writing,
+    Done,
+    Failed,
+    Cancelled,
+};
+
+const char* ConvertStageName(ConvertStage stage);
+
+// Optional live view of a conversion for callers running it on another
+// thread. ConvertSample only ever stores into it.
+struct ConvertProgress {
+    std::atomic<ConvertStage> stage{ConvertStage::Queued};
+    std::atomic<uint32_t> sampleCount{0};
+    // Filled in when ConvertOptions::profile is set. Only read it once the
+    // job has finished.
+    StageTimings timings;
+    // Set when a predictor search picked the encoding. Same rule as timings.
+    std::optional<PredictorChoice> predictorChoice;
+};
+
+struct ConvertOptions {
+    int predictorCount = 4;
+    // Above zero, predictorCount becomes the largest count tried and each
+    // sample gets the smallest count whose round-trip SNR reaches this many
+    // dB. See SearchPredictorCount.
+    double targetSnrDb = 0.0;
+    // Lets that search encode a few counts at once on threads of its own.
+    // Only for a lone sample: batch workers already fill every core.
+    bool parallelSearch = false;
+    // Decode the whole encoded stream with the reference decoder and check it
+    // against what the encoder reported. Roughly doubles encode time.
+    bool verify = false;
+    // TPDF dither when wider or multichannel WAV input is reduced to mono
+    // 16-bit. See OpenWavView.
+    bool dither = false;
+    // Reuses finished samples for inputs converted before. Not owned.
+    ConversionCache* cache = nullptr;
+    // Encodes identical inputs within a batch once; the rest copy that
+    // output. Not owned.
+    ConversionDedup* dedup = nullptr;
+    // Every written output is recorded here. With incremental set, jobs the
+    // manifest shows as up to date are skipped without reading them. Not
+    // owned.
+    ConversionManifest* manifest = nullptr;
+    bool incremental = true;
+    // Writes each sample into this archive under its resource path instead
+    // of into the output folder, which is then unused. Not owned.
+    O2rArchive* archive = nullptr;
+    // Per-stage timings into ConvertProgress::timings. Off costs one
+    // thread-local check per stage.
+    bool profile = false;
+    // Records every stage as a trace event when set. Not owned.
+    TraceRecorder* trace = nullptr;
+};
+
+bool IsWavPath(const std::filesystem::path& path);
+std::string DefaultOutputName(const std::filesystem::path& path);
+
+std::array<int16_t, 16> BuildLoopState(const std::vector<int16_t>& samples, uint32_t loopStart);
+
+// Reads job.inputPath, encodes it to VADPCM and writes the SoH sample to
+// outputDir / job.outputName, or into options.archive when set. Safe to call
+// from several threads at once.
+// When cancel is set the conversion stops before its next stage.
+// Workers converting many samples should pass their own buffers; without
+// them every call allocates its working memory afresh.
+bool ConvertSample(const ConvertJob& job,
+                   const std::filesystem::path& outputDir,
+                   const ConvertOptions& options,
+                   std::string& status,
+                   ConvertProgress* progress = nullptr,
+                   const std::atomic<bool>* cancel = nullptr,
+                   ConvertBuffers* buffers = nullptr);
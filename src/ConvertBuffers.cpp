@@ -0,0 +1,48 @@
+#include "ConvertBuffers.h"
+
+#include <algorithm>
+
+// Larger buffers are freed after each conversion: inputs that long are rare,
+// and holding on to one per worker would dwarf a typical batch's memory.
+static constexpr size_t kMaxRetainedBytes = size_t(16) << 20;
+
+template <typename T>
+static void TrimBuffer(std::vector<T>& buffer) {
+    if (buffer.capacity() * sizeof(T) > kMaxRetainedBytes) {
+        std::vector<T>().swap(buffer);
+    }
+}
+
+// A buffer that grew or was allocated has a data pointer it did not have
+// before. Swaps between buffers keep the set the same, so they do not count.
+std::array<const void*, ConvertBuffers::kBufferCount> ConvertBuffers::Snapshot() const {
+    return {wav.converted.data(), resampled.data(), resampleWork.data(), padded.data(), aifc.adpcmData.data(),
+            aifc.book.data(),     decoded.data(),   sample.adpcmData.data(), sample.book.data(), resource.data()};
+}
+
+void ConvertBuffers::BeginItem() {
+    itemStart = Snapshot();
+}
+
+uint32_t ConvertBuffers::EndItem() {
+    uint32_t allocations = 0;
+    for (const void* data : Snapshot()) {
+        if (data && std::find(itemStart.begin(), itemStart.end(), data) == itemStart.end()) {
+            allocations++;
+        }
+    }
+
+    wav.file.Close();
+    wav.samples = {};
+    TrimBuffer(wav.converted);
+    TrimBuffer(resampled);
+    TrimBuffer(resampleWork);
+    TrimBuffer(padded);
+    TrimBuffer(aifc.adpcmData);
+    TrimBuffer(aifc.book);
+    TrimBuffer(decoded);
+    TrimBuffer(sample.adpcmData);
+    TrimBuffer(sample.book);
+    TrimBuffer(resource);
+    return allocations;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "AudioFormats.h"
+#include "SohSampleWriter.h"
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Working memory a worker reuses from one ConvertSample call to the next.
+// Buffers keep their capacity, so once a worker has seen its largest input a
+// batch stops allocating PCM, codec and output buffers. Not thread-safe:
+// give each worker its own, e.g. a thread_local in the task.
+struct ConvertBuffers {
+    PcmView wav;
+    std::vector<int16_t> resampled;
+    std::vector<float> resampleWork;
+    // Encoder input rounded up to whole frames.
+    std::vector<int16_t> padded;
+    VadpcmAifc aifc;
+    // Loop-state and verify decodes.
+    std::vector<int16_t> decoded;
+    SohSampleData sample;
+    // The serialized resource, or only its framing for direct file writes.
+    std::vector<uint8_t> resource;
+
+    // Starts counting allocations for one conversion.
+    void BeginItem();
+    // Unmaps the input and frees buffers past kMaxRetainedBytes, so one huge
+    // input does not pin its memory for the rest of a long session. Returns
+    // how many buffers were allocated or grown since BeginItem.
+    uint32_t EndItem();
+
+private:
+    static constexpr size_t kBufferCount = 10;
+
+    std::array<const void*, kBufferCount> Snapshot() const;
+
+    std::array<const void*, kBufferCount> itemStart{};
+};
@@ -0,0 +1,188 @@
+#include "Crc32.h"
+
+#include <array>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SOH_CRC_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SOH_TARGET_PCLMUL
+#else
+#define SOH_TARGET_PCLMUL __attribute__((target("pclmul")))
+#endif
+#endif
+
+#if (defined(__aarch64__) || defined(_M_ARM64)) && defined(__ARM_FEATURE_CRC32)
+#define SOH_CRC_ARM 1
+#include <arm_acle.h>
+#endif
+
+using Crc32Tables = std::array<std::array<uint32_t, 256>, 8>;
+
+// Slicing-by-8: table k advances a byte through k further zero bytes.
+static constexpr Crc32Tables MakeTables() {
+    Crc32Tables tables{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320u : 0u);
+        }
+        tables[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (size_t k = 1; k < 8; k++) {
+            uint32_t previous = tables[k - 1][i];
+            tables[k][i] = (previous >> 8) ^ tables[0][previous & 0xFF];
+        }
+    }
+    return tables;
+}
+
+static constexpr Crc32Tables kTables = MakeTables();
+
+// Works on the inverted state, like the vector versions.
+static uint32_t Crc32Scalar(const uint8_t* data, size_t size, uint32_t state) {
+    while (size >= 8) {
+        uint32_t lo = state ^ (static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8) |
+                               (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24));
+        state = kTables[7][lo & 0xFF] ^ kTables[6][(lo >> 8) & 0xFF] ^ kTables[5][(lo >> 16) & 0xFF] ^
+                kTables[4][lo >> 24] ^ kTables[3][data[4]] ^ kTables[2][data[5]] ^ kTables[1][data[6]] ^
+                kTables[0][data[7]];
+        data += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        state = (state >> 8) ^ kTables[0][(state ^ *data) & 0xFF];
+        data++;
+        size--;
+    }
+    return state;
+}
+
+#ifdef SOH_CRC_X86
+static bool CpuHasPclmul() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4];
+    __cpuid(regs, 1);
+    return (regs[2] & (1 << 1)) != 0;
+#else
+    unsigned int eax = 0;
+    unsigned int ebx = 0;
+    unsigned int ecx = 0;
+    unsigned int edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return (ecx & (1u << 1)) != 0;
+#endif
+}
+
+SOH_TARGET_PCLMUL static __m128i FoldPclmul(__m128i lane, __m128i next, __m128i k) {
+    __m128i lo = _mm_clmulepi64_si128(lane, k, 0x00);
+    __m128i hi = _mm_clmulepi64_si128(lane, k, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(hi, next), lo);
+}
+
+// Folds four 128-bit lanes at a time with carry-less multiplies, then
+// reduces to 32 bits with Barrett reduction ("Fast CRC Computation for
+// Generic Polynomials Using PCLMULQDQ Instruction", Intel, 2009). size must
+// be a multiple of 16 and at least 64.
+SOH_TARGET_PCLMUL static uint32_t Crc32Pclmul(const uint8_t* data, size_t size, uint32_t state) {
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5 = _mm_set_epi64x(0, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+    const __m128i low32 = _mm_setr_epi32(~0, 0, ~0, 0);
+
+    __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16));
+    __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32));
+    __m128i x4 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(static_cast<int>(state)));
+    data += 64;
+    size -= 64;
+
+    while (size >= 64) {
+        __m128i x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+        __m128i x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+        __m128i x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+        __m128i x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)));
+        data += 64;
+        size -= 64;
+    }
+
+    // Four lanes into one, then any remaining 16-byte blocks.
+    x1 = FoldPclmul(x1, x2, k3k4);
+    x1 = FoldPclmul(x1, x3, k3k4);
+    x1 = FoldPclmul(x1, x4, k3k4);
+    while (size >= 16) {
+        x1 = FoldPclmul(x1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), k3k4);
+        data += 16;
+        size -= 16;
+    }
+
+    // 128 bits to 64.
+    __m128i folded = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), folded);
+    __m128i high = _mm_srli_si128(x1, 4);
+    x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), k5, 0x00);
+    x1 = _mm_xor_si128(x1, high);
+
+    // Barrett reduction to 32 bits.
+    __m128i t = _mm_clmulepi64_si128(_mm_and_si128(x1, low32), poly, 0x10);
+    t = _mm_clmulepi64_si128(_mm_and_si128(t, low32), poly, 0x00);
+    x1 = _mm_xor_si128(x1, t);
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(x1, 4)));
+}
+#endif
+
+#ifdef SOH_CRC_ARM
+static uint32_t Crc32Arm(const uint8_t* data, size_t size, uint32_t state) {
+    while (size >= 8) {
+        uint64_t value = 0;
+        for (int i = 7; i >= 0; i--) {
+            value = (value << 8) | data[i];
+        }
+        state = __crc32d(state, value);
+        data += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        state = __crc32b(state, *data);
+        data++;
+        size--;
+    }
+    return state;
+}
+#endif
+
+uint32_t Crc32(std::span<const uint8_t> data, uint32_t crc) {
+    uint32_t state = ~crc;
+    const uint8_t* bytes = data.data();
+    size_t size = data.size();
+#if defined(SOH_CRC_X86)
+    static const bool hasPclmul = CpuHasPclmul();
+    if (hasPclmul && size >= 64) {
+        size_t blocks = size & ~size_t(15);
+        state = Crc32Pclmul(bytes, blocks, state);
+        bytes += blocks;
+        size -= blocks;
+    }
+#elif defined(SOH_CRC_ARM)
+    return ~Crc32Arm(bytes, size, state);
+#endif
+    return ~Crc32Scalar(bytes, size, state);
+}
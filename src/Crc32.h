@@ -0,0 +1,9 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+// CRC-32 as used by zip and PNG (reflected polynomial 0xEDB88320). Pass the
+// previous result as crc to continue over several buffers. Uses carry-less
+// multiply on x86 and the CRC32 instructions on ARMv8 when the CPU has them.
+uint32_t Crc32(std::span<const uint8_t> data, uint32_t crc = 0);
@@ -0,0 +1,128 @@
+#include "DirectoryScan.h"
+
+#include "Convert.h"
+#include "PathUtils.h"
+#include "ThreadPool.h"
+
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <system_error>
+
+static bool HasWavMagic(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    char header[12];
+    if (!file.read(header, sizeof(header))) {
+        return false;
+    }
+    return std::memcmp(header, "RIFF", 4) == 0 && std::memcmp(header + 8, "WAVE", 4) == 0;
+}
+
+// The resource header's type field, OSMP stored little-endian.
+static bool HasSohSampleMagic(const std::filesystem::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    char header[8];
+    if (!file.read(header, sizeof(header))) {
+        return false;
+    }
+    return std::memcmp(header + 4, "PMSO", 4) == 0;
+}
+
+static bool IsTarget(const std::filesystem::path& path, ScanTarget target) {
+    switch (target) {
+        case ScanTarget::Wav:
+            return IsWavPath(path) && HasWavMagic(path);
+        case ScanTarget::SohSample:
+            return HasSohSampleMagic(path);
+    }
+    return false;
+}
+
+DirectoryScan::DirectoryScan(std::filesystem::path root, size_t threadCount, ScanTarget target)
+    : root(std::move(root)), target(target), pool(std::make_unique<ThreadPool>(threadCount)) {
+    SubmitFolder(this->root);
+}
+
+DirectoryScan::~DirectoryScan() {
+    Cancel();
+    pool.reset();
+}
+
+void DirectoryScan::Cancel() {
+    cancel.store(true, std::memory_order_relaxed);
+}
+
+void DirectoryScan::Wait() {
+    pool->Wait();
+}
+
+bool DirectoryScan::IsFinished() const {
+    return pendingFolders.load(std::memory_order_acquire) == 0;
+}
+
+std::vector<ScannedFile> DirectoryScan::TakeFiles() {
+    std::vector<ScannedFile> taken;
+    std::lock_guard<std::mutex> lock(mutex);
+    taken.swap(files);
+    return taken;
+}
+
+std::vector<std::string> DirectoryScan::GetErrors() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return errors;
+}
+
+void DirectoryScan::SubmitFolder(std::filesystem::path folder) {
+    pendingFolders.fetch_add(1, std::memory_order_relaxed);
+    pool->Submit([this, folder = std::move(folder)] {
+        // A folder that throws is reported like one that cannot be listed,
+        // and still counted down so the scan can finish.
+        try {
+            if (!cancel.load(std::memory_order_relaxed)) {
+                ScanFolder(folder);
+            }
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> lock(mutex);
+            errors.push_back(PathToUtf8(folder) + ": " + e.what());
+        }
+        pendingFolders.fetch_sub(1, std::memory_order_acq_rel);
+    });
+}
+
+void DirectoryScan::ScanFolder(const std::filesystem::path& folder) {
+    // Files are published once per folder to keep the lock cold.
+    std::vector<ScannedFile> found;
+    std::error_code ec;
+    std::filesystem::directory_iterator it(folder, std::filesystem::directory_options::skip_permission_denied, ec);
+    for (; !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        const std::filesystem::directory_entry& entry = *it;
+        std::error_code entryEc;
+        if (entry.is_directory(entryEc)) {
+            if (!entry.is_symlink(entryEc)) {
+                // Children are counted before this folder finishes, so the
+                // pending count only reaches zero once the tree is done.
+                SubmitFolder(entry.path());
+            }
+        } else if (entry.is_regular_file(entryEc) && IsTarget(entry.path(), target)) {
+            std::filesystem::path relative = entry.path().lexically_relative(root);
+            if (target == ScanTarget::Wav) {
+                relative.replace_extension();
+            }
+            // UTF-8 with forward slashes, like resource paths.
+            std::string outputName;
+            for (const std::filesystem::path& part : relative) {
+                if (!outputName.empty()) {
+                    outputName += '/';
+                }
+                outputName += PathToUtf8(part);
+            }
+            found.push_back({entry.path(), std::move(outputName)});
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (ec) {
+        errors.push_back(PathToUtf8(folder) + ": " + ec.message());
+    }
+    files.insert(files.end(), std::make_move_iterator(found.begin()), std::make_move_iterator(found.end()));
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+struct ScannedFile {
+    std::filesystem::path path;
+    // Path below the scanned folder without a WAV's extension, so outputs
+    // mirror the input tree. UTF-8, with forward slashes.
+    std::string outputName;
+};
+
+enum class ScanTarget : uint8_t {
+    // By .wav extension and RIFF/WAVE magic.
+    Wav,
+    // Converted samples, which have no extension: by the OSMP resource type.
+    SohSample,
+};
+
+// Walks a folder tree in the background, one pool task per directory, and
+// collects every file of the target kind. Symlinked folders are not
+// followed. Files can be taken while the scan is still running.
+class DirectoryScan {
+public:
+    // threadCount == 0 uses one thread per hardware core.
+    explicit DirectoryScan(std::filesystem::path root, size_t threadCount = 0, ScanTarget target = ScanTarget::Wav);
+    // Stops listing new folders and waits for the workers to exit.
+    ~DirectoryScan();
+
+    DirectoryScan(const DirectoryScan&) = delete;
+    DirectoryScan& operator=(const DirectoryScan&) = delete;
+
+    void Cancel();
+    void Wait();
+    bool IsFinished() const;
+
+    // Files found since the last call, in no particular order.
+    std::vector<ScannedFile> TakeFiles();
+    // Folders that could not be listed, each with its reason.
+    std::vector<std::string> GetErrors() const;
+
+private:
+    void ScanFolder(const std::filesystem::path& folder);
+    void SubmitFolder(std::filesystem::path folder);
+
+    std::filesystem::path root;
+    ScanTarget target;
+    std::unique_ptr<ThreadPool> pool;
+    mutable std::mutex mutex;
+    std::vector<ScannedFile> files;
+    std::vector<std::string> errors;
+    std::atomic<size_t> pendingFolders{0};
+    std::atomic<bool> cancel{false};
+};
@@ -0,0 +1,135 @@
+#include "Hash64.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+static constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+static constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+static constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+static constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+// Little-endian loads written bytewise; compilers turn these into plain
+// loads on little-endian hosts.
+static uint64_t Load64(const uint8_t* p) {
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static uint32_t Load32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static uint64_t Round(uint64_t accumulator, uint64_t input) {
+    accumulator += input * kPrime2;
+    accumulator = std::rotl(accumulator, 31);
+    return accumulator * kPrime1;
+}
+
+static uint64_t MergeRound(uint64_t accumulator, uint64_t value) {
+    accumulator ^= Round(0, value);
+    return accumulator * kPrime1 + kPrime4;
+}
+
+static void InitLanes(uint64_t* lanes, uint64_t seed) {
+    lanes[0] = seed + kPrime1 + kPrime2;
+    lanes[1] = seed + kPrime2;
+    lanes[2] = seed;
+    lanes[3] = seed - kPrime1;
+}
+
+// Consumes every whole 32-byte stripe of [p, end) and returns where the
+// rest starts.
+static const uint8_t* ConsumeStripes(uint64_t* lanes, const uint8_t* p, const uint8_t* end) {
+    for (; end - p >= 32; p += 32) {
+        lanes[0] = Round(lanes[0], Load64(p));
+        lanes[1] = Round(lanes[1], Load64(p + 8));
+        lanes[2] = Round(lanes[2], Load64(p + 16));
+        lanes[3] = Round(lanes[3], Load64(p + 24));
+    }
+    return p;
+}
+
+static uint64_t MergeLanes(const uint64_t* lanes) {
+    uint64_t hash = std::rotl(lanes[0], 1) + std::rotl(lanes[1], 7) + std::rotl(lanes[2], 12) + std::rotl(lanes[3], 18);
+    for (int i = 0; i < 4; i++) {
+        hash = MergeRound(hash, lanes[i]);
+    }
+    return hash;
+}
+
+// Folds in the final 0..31 bytes and mixes the result.
+static uint64_t Finish(uint64_t hash, const uint8_t* p, const uint8_t* end) {
+    for (; p + 8 <= end; p += 8) {
+        hash ^= Round(0, Load64(p));
+        hash = std::rotl(hash, 27) * kPrime1 + kPrime4;
+    }
+    if (p + 4 <= end) {
+        hash ^= static_cast<uint64_t>(Load32(p)) * kPrime1;
+        hash = std::rotl(hash, 23) * kPrime2 + kPrime3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        hash ^= static_cast<uint64_t>(*p) * kPrime5;
+        hash = std::rotl(hash, 11) * kPrime1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+uint64_t Hash64(std::span<const uint8_t> data, uint64_t seed) {
+    const uint8_t* p = data.data();
+    const uint8_t* end = p + data.size();
+    uint64_t hash;
+    if (data.size() >= 32) {
+        uint64_t lanes[4];
+        InitLanes(lanes, seed);
+        p = ConsumeStripes(lanes, p, end);
+        hash = MergeLanes(lanes);
+    } else {
+        hash = seed + kPrime5;
+    }
+    return Finish(hash + static_cast<uint64_t>(data.size()), p, end);
+}
+
+Hash64Stream::Hash64Stream(uint64_t seed) : seed(seed) {
+    InitLanes(lanes, seed);
+}
+
+void Hash64Stream::Update(std::span<const uint8_t> data) {
+    if (data.empty()) {
+        return;
+    }
+    const uint8_t* p = data.data();
+    const uint8_t* end = p + data.size();
+    length += data.size();
+    if (pendingSize > 0) {
+        size_t take = std::min(sizeof(pending) - pendingSize, data.size());
+        std::memcpy(pending + pendingSize, p, take);
+        pendingSize += take;
+        p += take;
+        if (pendingSize < sizeof(pending)) {
+            return;
+        }
+        ConsumeStripes(lanes, pending, pending + sizeof(pending));
+        pendingSize = 0;
+    }
+    p = ConsumeStripes(lanes, p, end);
+    pendingSize = static_cast<size_t>(end - p);
+    std::memcpy(pending, p, pendingSize);
+}
+
+uint64_t Hash64Stream::Digest() const {
+    uint64_t hash = length >= 32 ? MergeLanes(lanes) : seed + kPrime5;
+    return Finish(hash + length, pending, pending + pendingSize);
+}
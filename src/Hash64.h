@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+// 64-bit XXH64 hash. Fast enough to fingerprint whole PCM payloads (several
+// GB/s); not suitable where an adversary picks the input.
+uint64_t Hash64(std::span<const uint8_t> data, uint64_t seed = 0);
+
+// Hash64 of data fed in pieces: Update with each piece in order, and Digest
+// gives the same value as Hash64 over all of them back to back.
+class Hash64Stream {
+public:
+    explicit Hash64Stream(uint64_t seed = 0);
+
+    void Update(std::span<const uint8_t> data);
+    uint64_t Digest() const;
+
+private:
+    uint64_t seed;
+    uint64_t lanes[4];
+    uint64_t length = 0;
+    uint8_t pending[32];
+    size_t pendingSize = 0;
+};
@@ -0,0 +1,521 @@
+#include "LoopFinder.h"
+
+#include "AudioFormats.h"
+#include "PredictorSearch.h"
+#include "Resampler.h"
+#include "VadpcmStream.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+extern "C" {
+#include "codec/vadpcm.h"
+}
+
+// Lead-in compared at each loop point. Shorter samples use a power of two
+// down to kMinSearchWindow.
+static constexpr size_t kSearchWindow = 4096;
+static constexpr size_t kMinSearchWindow = 256;
+// The coarse pass averages the samples down until at most this many remain,
+// so a long track costs about as much as a short one.
+static constexpr size_t kCoarseMaxSamples = size_t(1) << 18;
+static constexpr size_t kMaxDecimation = 16;
+// Ends tried, each kEndStep samples before the last; a whole number of
+// frames apart so snapped ends stay on the grid.
+static constexpr size_t kEndCandidates = 4;
+static constexpr size_t kEndStep = 256;
+// Coarse matches refined at full rate, and how many of those get their seam
+// encoded at the least.
+static constexpr size_t kCoarseCandidates = 32;
+static constexpr size_t kSeamCandidates = 16;
+// Samples either side of the seam that its score covers.
+static constexpr size_t kSeamContext = 64;
+// Frames encoded ahead of each scored stretch so the encoder state has
+// settled by the time it gets there.
+static constexpr size_t kWarmupFrames = 4;
+
+// Radix-2 FFT over split real and imaginary arrays. The inverse is not
+// scaled.
+class FftPlan {
+public:
+    explicit FftPlan(size_t size) : size(size), reversed(size), cosines(size / 2), sines(size / 2) {
+        size_t bits = 0;
+        while ((size_t(1) << bits) < size) {
+            bits++;
+        }
+        for (size_t i = 0; i < size; i++) {
+            size_t r = 0;
+            for (size_t b = 0; b < bits; b++) {
+                r |= ((i >> b) & 1) << (bits - 1 - b);
+            }
+            reversed[i] = static_cast<uint32_t>(r);
+        }
+        for (size_t i = 0; i < size / 2; i++) {
+            double angle = -2.0 * std::numbers::pi * static_cast<double>(i) / static_cast<double>(size);
+            cosines[i] = static_cast<float>(std::cos(angle));
+            sines[i] = static_cast<float>(std::sin(angle));
+        }
+    }
+
+    size_t GetSize() const {
+        return size;
+    }
+
+    void Transform(float* re, float* im, bool inverse) const {
+        for (size_t i = 0; i < size; i++) {
+            size_t j = reversed[i];
+            if (i < j) {
+                std::swap(re[i], re[j]);
+                std::swap(im[i], im[j]);
+            }
+        }
+        for (size_t half = 1; half < size; half *= 2) {
+            size_t stride = size / (half * 2);
+            float sign = inverse ? -1.0f : 1.0f;
+            for (size_t first = 0; first < size; first += half * 2) {
+                float* re0 = re + first;
+                float* im0 = im + first;
+                float* re1 = re0 + half;
+                float* im1 = im0 + half;
+                for (size_t k = 0; k < half; k++) {
+                    float wr = cosines[k * stride];
+                    float wi = sign * sines[k * stride];
+                    float tr = re1[k] * wr - im1[k] * wi;
+                    float ti = re1[k] * wi + im1[k] * wr;
+                    re1[k] = re0[k] - tr;
+                    im1[k] = im0[k] - ti;
+                    re0[k] += tr;
+                    im0[k] += ti;
+                }
+            }
+        }
+    }
+
+private:
+    size_t size;
+    std::vector<uint32_t> reversed;
+    std::vector<float> cosines;
+    std::vector<float> sines;
+};
+
+static bool IsCancelled(const std::atomic<bool>* cancel, std::string& error) {
+    if (cancel && cancel->load(std::memory_order_relaxed)) {
+        error = "Cancelled.";
+        return true;
+    }
+    return false;
+}
+
+static int16_t SampleAt(std::span<const int16_t> samples, int64_t index) {
+    return index >= 0 && static_cast<uint64_t>(index) < samples.size() ? samples[static_cast<size_t>(index)] : 0;
+}
+
+// out[t][lag] = sum of templates[t][k] * signal[lag + k] for every lag where
+// the template fits whole. Overlap-save with FFTs eight windows long; two
+// templates share each inverse transform, one in the real part and one in
+// the imaginary, since both correlations are real.
+static bool CorrelateTemplates(std::span<const float> signal,
+                               const std::vector<std::vector<float>>& templates,
+                               size_t window,
+                               std::vector<std::vector<float>>& out,
+                               std::string& error,
+                               const std::atomic<bool>* cancel) {
+    FftPlan plan(window * 8);
+    size_t fftSize = plan.GetSize();
+    size_t lagCount = signal.size() - window + 1;
+    size_t blockLags = fftSize - window + 1;
+
+    std::vector<std::vector<float>> spectraRe(templates.size()), spectraIm(templates.size());
+    for (size_t t = 0; t < templates.size(); t++) {
+        spectraRe[t].assign(fftSize, 0.0f);
+        spectraIm[t].assign(fftSize, 0.0f);
+        std::copy(templates[t].begin(), templates[t].end(), spectraRe[t].begin());
+        plan.Transform(spectraRe[t].data(), spectraIm[t].data(), false);
+        out[t].resize(lagCount);
+    }
+
+    std::vector<float> blockRe(fftSize), blockIm(fftSize), productRe(fftSize), productIm(fftSize);
+    float scale = 1.0f / static_cast<float>(fftSize);
+    for (size_t first = 0; first < lagCount; first += blockLags) {
+        if (IsCancelled(cancel, error)) {
+            return false;
+        }
+        size_t available = std::min(fftSize, signal.size() - first);
+        std::copy_n(signal.begin() + first, available, blockRe.begin());
+        std::fill(blockRe.begin() + available, blockRe.end(), 0.0f);
+        std::fill(blockIm.begin(), blockIm.end(), 0.0f);
+        plan.Transform(blockRe.data(), blockIm.data(), false);
+
+        size_t count = std::min(blockLags, lagCount - first);
+        for (size_t t = 0; t < templates.size(); t += 2) {
+            bool pair = t + 1 < templates.size();
+            for (size_t i = 0; i < fftSize; i++) {
+                // A = Y conj(T0), B = Y conj(T1); the product is A + iB.
+                float yr = blockRe[i], yi = blockIm[i];
+                float ar = yr * spectraRe[t][i] + yi * spectraIm[t][i];
+                float ai = yi * spectraRe[t][i] - yr * spectraIm[t][i];
+                float br = pair ? yr * spectraRe[t + 1][i] + yi * spectraIm[t + 1][i] : 0.0f;
+                float bi = pair ? yi * spectraRe[t + 1][i] - yr * spectraIm[t + 1][i] : 0.0f;
+                productRe[i] = ar - bi;
+                productIm[i] = ai + br;
+            }
+            plan.Transform(productRe.data(), productIm.data(), true);
+            for (size_t i = 0; i < count; i++) {
+                out[t][first + i] = productRe[i] * scale;
+            }
+            if (pair) {
+                for (size_t i = 0; i < count; i++) {
+                    out[t + 1][first + i] = productIm[i] * scale;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Normalised correlation of the window samples before a and before b.
+static double LeadInCorrelation(std::span<const int16_t> samples, size_t a, size_t b, size_t window) {
+    int64_t cross = 0, energyA = 0, energyB = 0;
+    const int16_t* x = samples.data() + a - window;
+    const int16_t* y = samples.data() + b - window;
+    for (size_t k = 0; k < window; k++) {
+        cross += static_cast<int64_t>(x[k]) * y[k];
+        energyA += static_cast<int64_t>(x[k]) * x[k];
+        energyB += static_cast<int64_t>(y[k]) * y[k];
+    }
+    if (energyA == 0 || energyB == 0) {
+        return 0.0;
+    }
+    return static_cast<double>(cross) / std::sqrt(static_cast<double>(energyA) * static_cast<double>(energyB));
+}
+
+// Hann-windowed magnitude spectrum of the plan's size of samples before end.
+static void LeadInSpectrum(std::span<const int16_t> samples,
+                           size_t end,
+                           const FftPlan& plan,
+                           std::vector<float>& re,
+                           std::vector<float>& im,
+                           std::vector<float>& magnitudes) {
+    size_t size = plan.GetSize();
+    re.resize(size);
+    im.assign(size, 0.0f);
+    for (size_t k = 0; k < size; k++) {
+        double hann = 0.5 - 0.5 * std::cos(2.0 * std::numbers::pi * static_cast<double>(k) / static_cast<double>(size));
+        re[k] = static_cast<float>(samples[end - size + k] * hann);
+    }
+    plan.Transform(re.data(), im.data(), false);
+    magnitudes.resize(size / 2);
+    for (size_t k = 0; k < size / 2; k++) {
+        magnitudes[k] = std::sqrt(re[k] * re[k] + im[k] * im[k]);
+    }
+}
+
+static double SpectralMatch(const std::vector<float>& a, const std::vector<float>& b) {
+    double cross = 0.0, energyA = 0.0, energyB = 0.0;
+    for (size_t k = 0; k < a.size(); k++) {
+        cross += static_cast<double>(a[k]) * b[k];
+        energyA += static_cast<double>(a[k]) * a[k];
+        energyB += static_cast<double>(b[k]) * b[k];
+    }
+    return energyA > 0.0 && energyB > 0.0 ? cross / std::sqrt(energyA * energyB) : 0.0;
+}
+
+// Encodes frames [firstFrame, endFrame) from a fresh encoder state; frames
+// past the end of samples are zero-padded as the encoder pads them.
+static void EncodeFrames(std::span<const int16_t> samples,
+                         size_t firstFrame,
+                         size_t endFrame,
+                         const VadpcmAifc& codebook,
+                         std::vector<uint8_t>& bytes,
+                         std::vector<int16_t>& decoded) {
+    VadpcmFrameEncoder encoder(codebook.book, codebook.order, codebook.predictors);
+    size_t frameCount = endFrame - firstFrame;
+    bytes.resize(frameCount * kVADPCMFrameByteSize);
+    decoded.resize(frameCount * kVADPCMFrameSampleCount);
+    int16_t input[kVADPCMFrameSampleCount];
+    for (size_t frame = 0; frame < frameCount; frame++) {
+        int64_t first = static_cast<int64_t>((firstFrame + frame) * kVADPCMFrameSampleCount);
+        for (size_t i = 0; i < kVADPCMFrameSampleCount; i++) {
+            input[i] = SampleAt(samples, first + static_cast<int64_t>(i));
+        }
+        encoder.EncodeFrame(input, bytes.data() + frame * kVADPCMFrameByteSize,
+                            decoded.data() + frame * kVADPCMFrameSampleCount);
+    }
+}
+
+// Plays the seam as SamplePlayer does, the end's lead-in followed by a
+// restart from the loop state, and compares it with the decoded audio
+// around loopStart it stands in for. Both sides go through the codec, so
+// what is left is the seam itself: lead-ins that differ, and the restart
+// state missing the frame it lands in.
+static double SeamSnrDb(std::span<const int16_t> samples, size_t start, size_t end, const VadpcmAifc& codebook) {
+    std::vector<uint8_t> bytes;
+    std::vector<int16_t> decoded;
+    std::vector<int16_t> reference, played;
+    reference.reserve(kSeamContext * 2);
+    played.reserve(kSeamContext * 2);
+
+    size_t endFirst = (end - kSeamContext) / kVADPCMFrameSampleCount;
+    endFirst -= std::min(endFirst, kWarmupFrames);
+    size_t endLast = (end + kVADPCMFrameSampleCount - 1) / kVADPCMFrameSampleCount;
+    EncodeFrames(samples, endFirst, endLast, codebook, bytes, decoded);
+    size_t base = endFirst * kVADPCMFrameSampleCount;
+    played.insert(played.end(), decoded.begin() + (end - kSeamContext - base), decoded.begin() + (end - base));
+
+    size_t startFrame = start / kVADPCMFrameSampleCount;
+    size_t startFirst = (start >= kSeamContext ? start - kSeamContext : 0) / kVADPCMFrameSampleCount;
+    startFirst -= std::min(startFirst, kWarmupFrames);
+    size_t startLast = (start + kSeamContext + kVADPCMFrameSampleCount - 1) / kVADPCMFrameSampleCount;
+    EncodeFrames(samples, startFirst, startLast, codebook, bytes, decoded);
+    base = startFirst * kVADPCMFrameSampleCount;
+    // The last 8 of the 16 decoded samples BuildLoopState saves, zero
+    // before the first sample.
+    int16_t state[8];
+    for (size_t i = 0; i < 8; i++) {
+        size_t index = start + i;
+        state[i] = index >= 8 + base ? decoded[index - 8 - base] : 0;
+    }
+    size_t restartFrames = startLast - startFrame;
+    std::vector<int16_t> restart(restartFrames * kVADPCMFrameSampleCount);
+    vadpcm_error err = vadpcm_decode(codebook.predictors, codebook.order,
+                                     reinterpret_cast<const vadpcm_vector*>(codebook.book.data()),
+                                     reinterpret_cast<vadpcm_vector*>(state), static_cast<int>(restartFrames),
+                                     restart.data(), bytes.data() + (startFrame - startFirst) * kVADPCMFrameByteSize);
+    if (err != kVADPCMErrNone) {
+        return -std::numeric_limits<double>::infinity();
+    }
+    size_t offset = start % kVADPCMFrameSampleCount;
+    played.insert(played.end(), restart.begin() + offset, restart.begin() + offset + kSeamContext);
+
+    // Offset by kSeamContext so positions before the first sample, which
+    // the decoder treats as zero, stay unsigned.
+    for (size_t shifted = start; shifted < start + kSeamContext * 2; shifted++) {
+        reference.push_back(shifted >= kSeamContext + base ? decoded[shifted - kSeamContext - base] : 0);
+    }
+    SnrAccumulator snr;
+    snr.Add(reference, played);
+    return snr.Db();
+}
+
+bool FindLoopPoints(std::span<const int16_t> samples,
+                    uint32_t sampleRate,
+                    const LoopSearchOptions& options,
+                    std::vector<LoopCandidate>& candidates,
+                    std::string& error,
+                    const std::atomic<bool>* cancel) {
+    candidates.clear();
+    if (samples.empty()) {
+        error = "Sample is empty.";
+        return false;
+    }
+
+    // Loop points here are boundaries: the loop plays [start, end), so the
+    // jump goes from sample end - 1 back to start.
+    size_t lastEnd = options.loopEnd != 0 ? std::min<size_t>(options.loopEnd, samples.size() - 1) : samples.size() - 1;
+    size_t end = lastEnd + 1;
+    size_t step = options.snapToFrames ? kVADPCMFrameSampleCount : 1;
+    end -= end % step;
+
+    size_t window = kSearchWindow;
+    while (window > kMinSearchWindow && window * 3 > end) {
+        window /= 2;
+    }
+    size_t minLength = std::max<size_t>(options.minLoopLength, window);
+    if (end < window + minLength) {
+        error = "Sample is too short to search for a loop.";
+        return false;
+    }
+
+    std::vector<size_t> ends;
+    for (size_t i = 0; i < kEndCandidates && end >= i * kEndStep + window + minLength; i++) {
+        ends.push_back(end - i * kEndStep);
+    }
+
+    // Coarse pass: box-averaged samples and windows, every start at once.
+    size_t decimation = 1;
+    while (decimation < kMaxDecimation && end / decimation > kCoarseMaxSamples) {
+        decimation *= 2;
+    }
+    size_t coarseWindow = window / decimation;
+    std::vector<float> coarse(end / decimation);
+    for (size_t i = 0; i < coarse.size(); i++) {
+        int32_t sum = 0;
+        for (size_t k = 0; k < decimation; k++) {
+            sum += samples[i * decimation + k];
+        }
+        coarse[i] = static_cast<float>(sum) / static_cast<float>(decimation);
+    }
+    std::vector<std::vector<float>> templates(ends.size());
+    for (size_t t = 0; t < ends.size(); t++) {
+        size_t coarseEnd = ends[t] / decimation;
+        templates[t].assign(coarse.begin() + (coarseEnd - coarseWindow), coarse.begin() + coarseEnd);
+    }
+    std::vector<std::vector<float>> correlations(ends.size());
+    if (!CorrelateTemplates(coarse, templates, coarseWindow, correlations, error, cancel)) {
+        return false;
+    }
+
+    // Window energies for normalising, from running sums.
+    std::vector<double> energySums(coarse.size() + 1, 0.0);
+    for (size_t i = 0; i < coarse.size(); i++) {
+        energySums[i + 1] = energySums[i] + static_cast<double>(coarse[i]) * coarse[i];
+    }
+    struct CoarseMatch {
+        double score;
+        size_t endIndex;
+        size_t start;
+    };
+    std::vector<CoarseMatch> matches;
+    // The best lag in each stretch of a quarter window, so one strong peak
+    // does not fill every slot.
+    size_t bucket = std::max<size_t>(coarseWindow / 4, 1);
+    for (size_t t = 0; t < ends.size(); t++) {
+        size_t coarseEnd = ends[t] / decimation;
+        double templateEnergy = energySums[coarseEnd] - energySums[coarseEnd - coarseWindow];
+        size_t lastLag = (ends[t] - minLength) / decimation - coarseWindow;
+        if (templateEnergy <= 0.0) {
+            continue;
+        }
+        for (size_t first = 0; first <= lastLag; first += bucket) {
+            CoarseMatch best{-2.0, t, 0};
+            for (size_t lag = first; lag <= std::min(lastLag, first + bucket - 1); lag++) {
+                double energy = energySums[lag + coarseWindow] - energySums[lag];
+                double score = energy > 0.0 ? correlations[t][lag] / std::sqrt(energy * templateEnergy) : 0.0;
+                if (score > best.score) {
+                    best = {score, t, (lag + coarseWindow) * decimation};
+                }
+            }
+            matches.push_back(best);
+        }
+    }
+    correlations.clear();
+    size_t keep = std::min(matches.size(), kCoarseCandidates);
+    std::partial_sort(matches.begin(), matches.begin() + keep, matches.end(),
+                      [](const CoarseMatch& a, const CoarseMatch& b) { return a.score > b.score; });
+    matches.resize(keep);
+    if (IsCancelled(cancel, error)) {
+        return false;
+    }
+
+    // Full-rate pass: the best start near each coarse match, on the frame
+    // grid when snapping, then spectral similarity of the two lead-ins.
+    FftPlan spectrumPlan(window);
+    std::vector<float> re, im, endSpectrum, startSpectrum;
+    size_t radius = std::max(decimation, step);
+    for (const CoarseMatch& match : matches) {
+        size_t boundary = ends[match.endIndex];
+        size_t low = match.start > window + radius ? match.start - radius : window;
+        low = (low + step - 1) / step * step;
+        size_t high = std::min(match.start + radius, boundary - minLength);
+        LoopCandidate best;
+        best.correlation = -2.0;
+        for (size_t start = low; start <= high; start += step) {
+            double correlation = LeadInCorrelation(samples, start, boundary, window);
+            if (correlation > best.correlation) {
+                best.loopStart = static_cast<uint32_t>(start);
+                best.correlation = correlation;
+            }
+        }
+        best.loopEnd = static_cast<uint32_t>(boundary - 1);
+        bool duplicate = std::any_of(candidates.begin(), candidates.end(), [&](const LoopCandidate& c) {
+            return c.loopStart == best.loopStart && c.loopEnd == best.loopEnd;
+        });
+        if (best.correlation < -1.0 || duplicate) {
+            continue;
+        }
+        LeadInSpectrum(samples, boundary, spectrumPlan, re, im, endSpectrum);
+        LeadInSpectrum(samples, best.loopStart, spectrumPlan, re, im, startSpectrum);
+        best.spectralMatch = SpectralMatch(endSpectrum, startSpectrum);
+        candidates.push_back(best);
+    }
+    if (candidates.empty()) {
+        error = "No loop start found before the loop end.";
+        return false;
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const LoopCandidate& a, const LoopCandidate& b) {
+        return a.correlation + a.spectralMatch > b.correlation + b.spectralMatch;
+    });
+    candidates.resize(std::min(candidates.size(), std::max(options.candidateCount, kSeamCandidates)));
+    if (IsCancelled(cancel, error)) {
+        return false;
+    }
+
+    // Seam pass: a codebook trained on the stretches around every remaining
+    // candidate stands in for the one the whole sample will get.
+    std::vector<int16_t> training;
+    for (const LoopCandidate& candidate : candidates) {
+        for (size_t seam : {static_cast<size_t>(candidate.loopStart), static_cast<size_t>(candidate.loopEnd) + 1}) {
+            int64_t first = static_cast<int64_t>(seam / kVADPCMFrameSampleCount * kVADPCMFrameSampleCount) -
+                            static_cast<int64_t>(kSeamContext + kWarmupFrames * kVADPCMFrameSampleCount);
+            for (size_t i = 0; i < kSeamContext * 2 + kWarmupFrames * kVADPCMFrameSampleCount; i++) {
+                training.push_back(SampleAt(samples, first + static_cast<int64_t>(i)));
+            }
+        }
+    }
+    VadpcmAifc codebook;
+    if (!EncodeVadpcm(training, sampleRate, options.predictorCount, codebook, error)) {
+        return false;
+    }
+    for (LoopCandidate& candidate : candidates) {
+        candidate.seamSnrDb = SeamSnrDb(samples, candidate.loopStart, candidate.loopEnd + 1, codebook);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const LoopCandidate& a, const LoopCandidate& b) {
+        if (a.seamSnrDb != b.seamSnrDb) {
+            return a.seamSnrDb > b.seamSnrDb;
+        }
+        return a.correlation + a.spectralMatch > b.correlation + b.spectralMatch;
+    });
+    candidates.resize(std::min(candidates.size(), options.candidateCount));
+    return true;
+}
+
+// Maps a position found at the target rate back to input samples. Rounding
+// can land on an input sample the conversion maps to a neighbouring
+// position; an input sample next to it that maps back exactly is taken
+// instead, so a frame-aligned point is still aligned when the encoder sees
+// it. Upsampling skips some target positions; those keep the nearest input
+// sample. Nothing maps past lastSample.
+static uint32_t MapToInputRate(uint32_t position, uint32_t targetRate, uint32_t inputRate, uint32_t lastSample) {
+    uint32_t mapped = std::min(ResamplePosition(position, targetRate, inputRate), lastSample);
+    for (uint32_t nearby : {mapped, mapped + 1, mapped - 1}) {
+        if (nearby <= lastSample && ResamplePosition(nearby, inputRate, targetRate) == position) {
+            return nearby;
+        }
+    }
+    return mapped;
+}
+
+bool FindJobLoopPoints(const ConvertJob& job,
+                       bool dither,
+                       const LoopSearchOptions& options,
+                       std::vector<LoopCandidate>& candidates,
+                       std::string& error,
+                       const std::atomic<bool>* cancel) {
+    PcmView wav;
+    if (!OpenWavView(job.inputPath, wav, error, dither)) {
+        return false;
+    }
+    uint32_t inputRate = wav.sampleRate;
+    if (job.targetSampleRate == 0 || job.targetSampleRate == inputRate) {
+        return FindLoopPoints(wav.samples, inputRate, options, candidates, error, cancel);
+    }
+
+    std::vector<int16_t> resampled;
+    if (!ResamplePcm(wav.samples, inputRate, job.targetSampleRate, resampled, error)) {
+        return false;
+    }
+    LoopSearchOptions scaled = options;
+    scaled.loopEnd = ResamplePosition(options.loopEnd, inputRate, job.targetSampleRate);
+    scaled.minLoopLength = ResamplePosition(options.minLoopLength, inputRate, job.targetSampleRate);
+    if (!FindLoopPoints(resampled, job.targetSampleRate, scaled, candidates, error, cancel)) {
+        return false;
+    }
+    uint32_t lastSample = static_cast<uint32_t>(wav.samples.size() - 1);
+    for (LoopCandidate& candidate : candidates) {
+        candidate.loopStart = MapToInputRate(candidate.loopStart, job.targetSampleRate, inputRate, lastSample);
+        candidate.loopEnd = MapToInputRate(candidate.loopEnd, job.targetSampleRate, inputRate, lastSample);
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Convert.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+struct LoopCandidate {
+    uint32_t loopStart = 0;
+    // Last looped sample, as in ConvertJob.
+    uint32_t loopEnd = 0;
+    // Normalised cross-correlation of the audio leading up to the two loop
+    // points, -1 to 1.
+    double correlation = 0.0;
+    // Cosine similarity of the same two stretches' magnitude spectra, 0 to 1.
+    double spectralMatch = 0.0;
+    // Of the seam as the decoder plays it, against the audio it stands in
+    // for; higher is cleaner and infinite when exact.
+    double seamSnrDb = 0.0;
+};
+
+struct LoopSearchOptions {
+    // Last looped sample to search around; 0 for the end of the sample. The
+    // search also tries a few slightly earlier ends.
+    uint32_t loopEnd = 0;
+    // Shortest loop returned, in samples. 0 allows anything longer than the
+    // comparison window.
+    uint32_t minLoopLength = 0;
+    // Keeps both loop points on VADPCM frame boundaries, so the decoder
+    // restarts on a whole frame with the state it expects.
+    bool snapToFrames = true;
+    // For the codebook the seams are scored with.
+    int predictorCount = 4;
+    size_t candidateCount = 8;
+};
+
+// Searches samples for loop starts whose lead-in matches the lead-in of the
+// loop end, so the jump back is inaudible. Every start is compared at once by
+// FFT cross-correlation on a decimated copy of the samples, the best matches
+// are refined sample by sample and weighed by spectral similarity, and the
+// survivors are encoded around both loop points to score the seam the
+// decoder will actually play. candidates ends up best first.
+bool FindLoopPoints(std::span<const int16_t> samples,
+                    uint32_t sampleRate,
+                    const LoopSearchOptions& options,
+                    std::vector<LoopCandidate>& candidates,
+                    std::string& error,
+                    const std::atomic<bool>* cancel = nullptr);
+
+// FindLoopPoints on what the encoder will see for job: its WAV, resampled to
+// job.targetSampleRate when set. options.loopEnd and the candidates are in
+// input samples, like the job's own loop points. With a target rate,
+// snapToFrames aligns the points at that rate, where the decoder plays
+// them; in input samples they are the positions the conversion maps onto
+// those frame boundaries, and need not be multiples of 16 themselves.
+bool FindJobLoopPoints(const ConvertJob& job,
+                       bool dither,
+                       const LoopSearchOptions& options,
+                       std::vector<LoopCandidate>& candidates,
+                       std::string& error,
+                       const std::atomic<bool>* cancel = nullptr);
@@ -0,0 +1,478 @@
+#include "O2rArchive.h"
+
+#include "BinaryWriter.h"
+#include "Crc32.h"
+#include "MappedFile.h"
+#include "PathUtils.h"
+
+#include <algorithm>
+#include <system_error>
+
+static constexpr uint32_t kLocalSignature = 0x04034b50;
+static constexpr uint32_t kCentralSignature = 0x02014b50;
+static constexpr uint32_t kEndSignature = 0x06054b50;
+static constexpr uint32_t kDescriptorSignature = 0x08074b50;
+static constexpr size_t kLocalHeaderSize = 30;
+static constexpr size_t kCentralHeaderSize = 46;
+static constexpr size_t kEndRecordSize = 22;
+static constexpr size_t kCentralOffsetField = 42;
+static constexpr uint64_t kMaxZipOffset = 0xFFFFFFFF;
+static constexpr size_t kMaxZipEntries = 0xFFFF;
+// Room for typical resource paths, so building a header rarely reallocates.
+static constexpr size_t kNameReserve = 96;
+
+static constexpr uint16_t kVersionStored = 10;
+static constexpr uint16_t kFlagDescriptor = 0x0008;
+static constexpr uint16_t kFlagUtf8 = 0x0800;
+// Fixed 1980-01-01 00:00 timestamp, so identical inputs give identical
+// archives.
+static constexpr uint16_t kDosTime = 0;
+static constexpr uint16_t kDosDate = (1 << 5) | 1;
+
+static uint16_t Read16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+static uint32_t Read32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Fields shared by the local and central headers, from "version needed"
+// through the extra field length.
+static void PutEntryFields(BinaryWriter& writer, const std::string& name, uint32_t crc, uint32_t size) {
+    writer.PutU16LE(kVersionStored);
+    writer.PutU16LE(kFlagUtf8);
+    writer.PutU16LE(0);
+    writer.PutU16LE(kDosTime);
+    writer.PutU16LE(kDosDate);
+    writer.PutU32LE(crc);
+    writer.PutU32LE(size);
+    writer.PutU32LE(size);
+    writer.PutU16LE(static_cast<uint16_t>(name.size()));
+    writer.PutU16LE(0);
+}
+
+static std::vector<uint8_t> BuildLocalHeader(const std::string& name, uint32_t crc, uint32_t size) {
+    std::vector<uint8_t> header;
+    BinaryWriter writer(header);
+    writer.Reserve(kLocalHeaderSize + kNameReserve);
+    writer.PutU32LE(kLocalSignature);
+    PutEntryFields(writer, name, crc, size);
+    writer.PutBytes(name.data(), name.size());
+    return header;
+}
+
+// The local header offset is left zero for BuildDirectory.
+static std::vector<uint8_t> BuildCentralHeader(const std::string& name, uint32_t crc, uint32_t size) {
+    std::vector<uint8_t> header;
+    BinaryWriter writer(header);
+    writer.Reserve(kCentralHeaderSize + kNameReserve);
+    writer.PutU32LE(kCentralSignature);
+    writer.PutU16LE(kVersionStored);
+    PutEntryFields(writer, name, crc, size);
+    writer.PutU16LE(0);
+    writer.PutU16LE(0);
+    writer.PutU16LE(0);
+    writer.PutU32LE(0);
+    writer.PutU32LE(0);
+    writer.PutBytes(name.data(), name.size());
+    return header;
+}
+
+O2rArchive::O2rArchive(std::string resourcePrefix) : resourcePrefix(std::move(resourcePrefix)) {
+}
+
+O2rArchive::~O2rArchive() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (file.is_open()) {
+        std::string error;
+        FinishLocked(error);
+    }
+}
+
+bool O2rArchive::Open(const std::filesystem::path& path, std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->path = path;
+    entries.clear();
+    appendOffset = 0;
+    deadBytes = 0;
+    modified = false;
+    stats = Stats{};
+
+    std::error_code ec;
+    if (std::filesystem::exists(path, ec)) {
+        MappedFile existing;
+        if (!existing.Open(path, error)) {
+            return false;
+        }
+        if (existing.GetSize() == 0) {
+            modified = true;
+        } else if (!ReadDirectory(existing.GetData(), existing.GetSize(), error)) {
+            error = PathToUtf8(path) + ": " + error;
+            return false;
+        }
+    } else {
+        modified = true;
+        if (path.has_parent_path()) {
+            std::filesystem::create_directories(path.parent_path(), ec);
+        }
+        std::ofstream create(path, std::ios::binary);
+    }
+
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file) {
+        error = "Failed to open archive " + PathToUtf8(path) + ".";
+        return false;
+    }
+    return true;
+}
+
+bool O2rArchive::ReadDirectory(const uint8_t* data, size_t size, std::string& error) {
+    if (size < kEndRecordSize) {
+        error = "not a zip archive.";
+        return false;
+    }
+    // The end record sits at the very end, after it only the archive comment.
+    // An update that never reached Finish leaves appended records after it
+    // instead, and then the directory it points at ends right where it
+    // starts. Anything else that looks like one is sample data.
+    size_t end = size - kEndRecordSize;
+    const uint8_t* record = nullptr;
+    for (;; end--) {
+        const uint8_t* candidate = data + end;
+        if (Read32(candidate) == kEndSignature) {
+            uint64_t directoryEnd = uint64_t(Read32(candidate + 16)) + Read32(candidate + 12);
+            if (end + kEndRecordSize + Read16(candidate + 20) == size || directoryEnd == end) {
+                record = candidate;
+                break;
+            }
+        }
+        if (end == 0) {
+            error = "not a zip archive.";
+            return false;
+        }
+    }
+    // Leftovers of an interrupted update are dead space; the next Finish
+    // writes a directory after them.
+    modified = end + kEndRecordSize + Read16(record + 20) != size;
+
+    uint16_t entryCount = Read16(record + 10);
+    uint32_t directorySize = Read32(record + 12);
+    uint32_t directoryOffset = Read32(record + 16);
+    if (Read16(record + 4) != 0 || Read16(record + 6) != 0 || Read16(record + 8) != entryCount) {
+        error = "split archives are not supported.";
+        return false;
+    }
+    if (entryCount == 0xFFFF || directorySize == 0xFFFFFFFF || directoryOffset == 0xFFFFFFFF) {
+        error = "zip64 archives are not supported.";
+        return false;
+    }
+    if (static_cast<uint64_t>(directoryOffset) + directorySize > end) {
+        error = "corrupt central directory.";
+        return false;
+    }
+
+    uint64_t liveBytes = 0;
+    size_t position = directoryOffset;
+    size_t directoryEnd = directoryOffset + directorySize;
+    for (uint16_t i = 0; i < entryCount; i++) {
+        const uint8_t* header = data + position;
+        if (position + kCentralHeaderSize > directoryEnd || Read32(header) != kCentralSignature) {
+            error = "corrupt central directory.";
+            return false;
+        }
+        size_t headerSize = kCentralHeaderSize + Read16(header + 28) + Read16(header + 30) + Read16(header + 32);
+        if (position + headerSize > directoryEnd) {
+            error = "corrupt central directory.";
+            return false;
+        }
+
+        Entry entry;
+        entry.central.assign(header, header + headerSize);
+        entry.offset = Read32(header + kCentralOffsetField);
+        entry.crc = Read32(header + 16);
+        entry.size = Read32(header + 24);
+        uint32_t storedSize = Read32(header + 20);
+
+        if (entry.offset + kLocalHeaderSize > directoryOffset || Read32(data + entry.offset) != kLocalSignature) {
+            error = "corrupt local header.";
+            return false;
+        }
+        const uint8_t* local = data + entry.offset;
+        entry.recordSize = kLocalHeaderSize + Read16(local + 26) + Read16(local + 28) + uint64_t(storedSize);
+        if (Read16(header + 8) & kFlagDescriptor) {
+            // The descriptor's signature is optional.
+            uint64_t descriptor = entry.offset + entry.recordSize;
+            bool hasSignature = descriptor + 4 <= directoryOffset && Read32(data + descriptor) == kDescriptorSignature;
+            entry.recordSize += hasSignature ? 16 : 12;
+        }
+        if (entry.offset + entry.recordSize > directoryOffset) {
+            error = "corrupt local header.";
+            return false;
+        }
+
+        std::string name(reinterpret_cast<const char*>(header + kCentralHeaderSize), Read16(header + 28));
+        liveBytes += entry.recordSize;
+        auto [it, inserted] = entries.try_emplace(std::move(name), std::move(entry));
+        if (!inserted) {
+            // Duplicate names: the later record wins, like most readers.
+            liveBytes -= it->second.recordSize;
+            it->second = std::move(entry);
+        }
+        position += headerSize;
+    }
+
+    // New records go after the end record, so the old directory stays valid
+    // until Finish writes the new one behind them.
+    appendOffset = size;
+    deadBytes = liveBytes < appendOffset ? appendOffset - liveBytes : 0;
+    return true;
+}
+
+bool O2rArchive::AddEntry(const std::string& name, std::span<const uint8_t> data, std::string& error) {
+    if (name.empty() || name.size() > 0xFFFF) {
+        error = "Invalid archive entry name.";
+        return false;
+    }
+    if (data.size() > kMaxZipOffset) {
+        error = "Archive entries over 4 GB are not supported.";
+        return false;
+    }
+
+    // Checksum and headers outside the lock, so workers only queue for the
+    // write itself.
+    uint32_t crc = Crc32(data);
+    uint32_t size = static_cast<uint32_t>(data.size());
+    std::vector<uint8_t> local = BuildLocalHeader(name, crc, size);
+    Entry entry;
+    entry.central = BuildCentralHeader(name, crc, size);
+    entry.crc = crc;
+    entry.size = size;
+    entry.recordSize = local.size() + data.size();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file.is_open()) {
+        error = "Archive is not open.";
+        return false;
+    }
+    auto it = entries.find(name);
+    if (it != entries.end() && it->second.size == entry.size && it->second.crc == crc) {
+        stats.unchanged++;
+        return true;
+    }
+    if (appendOffset + entry.recordSize > kMaxZipOffset) {
+        error = "Archive would pass 4 GB, which needs zip64.";
+        return false;
+    }
+
+    file.seekp(static_cast<std::streamoff>(appendOffset));
+    file.write(reinterpret_cast<const char*>(local.data()), static_cast<std::streamsize>(local.size()));
+    if (!data.empty()) {
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+    }
+    // Flushed so ReadEntry, which reads through its own stream, sees it.
+    file.flush();
+    if (!file) {
+        file.clear();
+        error = "Failed to write archive " + PathToUtf8(path) + ".";
+        return false;
+    }
+
+    entry.offset = appendOffset;
+    appendOffset += entry.recordSize;
+    modified = true;
+    if (it != entries.end()) {
+        deadBytes += it->second.recordSize;
+        it->second = std::move(entry);
+        stats.replaced++;
+    } else {
+        entries.emplace(name, std::move(entry));
+        stats.added++;
+    }
+    return true;
+}
+
+bool O2rArchive::FindEntry(const std::string& name, EntryInfo& info) const {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(name);
+    if (it == entries.end()) {
+        return false;
+    }
+    info.size = it->second.size;
+    info.crc = it->second.crc;
+    return true;
+}
+
+bool O2rArchive::Finish(std::string& error) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!file.is_open()) {
+        error = "Archive is not open.";
+        return false;
+    }
+    return FinishLocked(error);
+}
+
+bool O2rArchive::ReadEntry(const std::string& name, std::vector<uint8_t>& data, std::string& error) const {
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    uint16_t method = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(name);
+        if (it == entries.end()) {
+            error = "Archive has no entry " + name + ".";
+            return false;
+        }
+        offset = it->second.offset;
+        size = it->second.size;
+        method = Read16(it->second.central.data() + 10);
+    }
+    if (method != 0) {
+        error = "Archive entry " + name + " is compressed.";
+        return false;
+    }
+
+    std::ifstream in(path, std::ios::binary);
+    uint8_t local[kLocalHeaderSize];
+    if (!in || !in.seekg(static_cast<std::streamoff>(offset)) ||
+        !in.read(reinterpret_cast<char*>(local), sizeof(local)) || Read32(local) != kLocalSignature) {
+        error = "Failed to read archive entry " + name + ".";
+        return false;
+    }
+    data.resize(size);
+    in.seekg(static_cast<std::streamoff>(offset + kLocalHeaderSize + Read16(local + 26) + Read16(local + 28)));
+    if (!in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(size))) {
+        error = "Failed to read archive entry " + name + ".";
+        return false;
+    }
+    return true;
+}
+
+std::string O2rArchive::ResourcePath(const std::string& outputName) const {
+    std::string resource = resourcePrefix + outputName;
+    std::replace(resource.begin(), resource.end(), '\\', '/');
+    return resource;
+}
+
+O2rArchive::Stats O2rArchive::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result = stats;
+    result.entries = entries.size();
+    return result;
+}
+
+// Central directory in file order, followed by the end record. Entry
+// offsets must already be final.
+std::vector<uint8_t> O2rArchive::BuildDirectory(uint64_t offset) const {
+    std::vector<const Entry*> sorted;
+    size_t directorySize = 0;
+    for (const auto& [name, entry] : entries) {
+        sorted.push_back(&entry);
+        directorySize += entry.central.size();
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) { return a->offset < b->offset; });
+
+    std::vector<uint8_t> directory;
+    BinaryWriter writer(directory);
+    writer.Reserve(directorySize + kEndRecordSize);
+    for (const Entry* entry : sorted) {
+        size_t start = writer.GetSize();
+        writer.PutBytes(entry->central.data(), entry->central.size());
+        uint32_t localOffset = static_cast<uint32_t>(entry->offset);
+        for (size_t i = 0; i < 4; i++) {
+            directory[start + kCentralOffsetField + i] = static_cast<uint8_t>(localOffset >> (i * 8));
+        }
+    }
+    writer.PutU32LE(kEndSignature);
+    writer.PutU16LE(0);
+    writer.PutU16LE(0);
+    writer.PutU16LE(static_cast<uint16_t>(sorted.size()));
+    writer.PutU16LE(static_cast<uint16_t>(sorted.size()));
+    writer.PutU32LE(static_cast<uint32_t>(directorySize));
+    writer.PutU32LE(static_cast<uint32_t>(offset));
+    writer.PutU16LE(0);
+    return directory;
+}
+
+bool O2rArchive::FinishLocked(std::string& error) {
+    if (entries.size() > kMaxZipEntries) {
+        file.close();
+        error = "Archives with more than 65535 entries need zip64.";
+        return false;
+    }
+    if (deadBytes > appendOffset / 2) {
+        file.close();
+        return CompactLocked(error);
+    }
+    if (!modified) {
+        // Nothing appended, so the directory on disk is still the right one.
+        file.close();
+        return true;
+    }
+
+    std::vector<uint8_t> directory = BuildDirectory(appendOffset);
+    file.seekp(static_cast<std::streamoff>(appendOffset));
+    file.write(reinterpret_cast<const char*>(directory.data()), static_cast<std::streamsize>(directory.size()));
+    file.close();
+    if (file.fail()) {
+        error = "Failed to write archive " + PathToUtf8(path) + ".";
+        return false;
+    }
+    // A failed write may have left part of a record past the new end.
+    std::error_code ec;
+    std::filesystem::resize_file(path, appendOffset + directory.size(), ec);
+    if (ec) {
+        error = "Failed to truncate archive " + PathToUtf8(path) + ".";
+        return false;
+    }
+    return true;
+}
+
+// Copies the live records into a fresh file, in their current order, and
+// swaps it in.
+bool O2rArchive::CompactLocked(std::string& error) {
+    MappedFile source;
+    if (!source.Open(path, error)) {
+        return false;
+    }
+
+    std::vector<Entry*> sorted;
+    for (auto& [name, entry] : entries) {
+        sorted.push_back(&entry);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const Entry* a, const Entry* b) { return a->offset < b->offset; });
+
+    std::filesystem::path temp = path;
+    temp += ".tmp";
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    uint64_t offset = 0;
+    for (Entry* entry : sorted) {
+        out.write(reinterpret_cast<const char*>(source.GetData() + entry->offset),
+                  static_cast<std::streamsize>(entry->recordSize));
+        entry->offset = offset;
+        offset += entry->recordSize;
+    }
+    std::vector<uint8_t> directory = BuildDirectory(offset);
+    out.write(reinterpret_cast<const char*>(directory.data()), static_cast<std::streamsize>(directory.size()));
+    out.close();
+    source.Close();
+
+    std::error_code ec;
+    if (out.fail()) {
+        std::filesystem::remove(temp, ec);
+        error = "Failed to write archive " + PathToUtf8(temp) + ".";
+        return false;
+    }
+    std::filesystem::rename(temp, path, ec);
+    if (ec) {
+        std::filesystem::remove(temp, ec);
+        error = "Failed to replace archive " + PathToUtf8(path) + ".";
+        return false;
+    }
+    appendOffset = offset;
+    deadBytes = 0;
+    modified = false;
+    stats.compacted = true;
+    return true;
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Folder SoH loads replacement samples from inside a mod archive.
+constexpr const char* kDefaultSampleResourcePrefix = "audio/samples/";
+
+// Zip-based .o2r mod archive that converted samples are written straight
+// into, uncompressed. Opening an existing archive keeps its entries. Adding
+// an entry whose CRC-32 and size already match leaves the archive alone; a
+// changed entry is appended after the old end record, so the old copy and the
+// old directory become dead space. Finish writes the new directory at the
+// end, first compacting the file when dead space passes half of it. Until
+// then the old directory still describes the archive as it was; reopening
+// an archive whose update was interrupted picks that directory up again.
+// AddEntry and FindEntry are safe to call from several workers at once.
+class O2rArchive {
+public:
+    struct EntryInfo {
+        uint64_t size = 0;
+        uint32_t crc = 0;
+    };
+
+    struct Stats {
+        size_t entries = 0;
+        size_t added = 0;
+        size_t replaced = 0;
+        size_t unchanged = 0;
+        bool compacted = false;
+    };
+
+    explicit O2rArchive(std::string resourcePrefix = kDefaultSampleResourcePrefix);
+    // Finishes the archive if Finish was not called.
+    ~O2rArchive();
+
+    O2rArchive(const O2rArchive&) = delete;
+    O2rArchive& operator=(const O2rArchive&) = delete;
+
+    // Creates the archive when it does not exist. Refuses files that are not
+    // plain zip archives (including zip64) rather than overwriting them.
+    bool Open(const std::filesystem::path& path, std::string& error);
+    bool AddEntry(const std::string& name, std::span<const uint8_t> data, std::string& error);
+    bool FindEntry(const std::string& name, EntryInfo& info) const;
+    bool Finish(std::string& error);
+    // Reads a stored entry back from disk, including one added since the
+    // archive was opened.
+    bool ReadEntry(const std::string& name, std::vector<uint8_t>& data, std::string& error) const;
+
+    // Resource path of a sample: the prefix, then outputName with forward
+    // slashes.
+    std::string ResourcePath(const std::string& outputName) const;
+    const std::filesystem::path& GetPath() const {
+        return path;
+    }
+    Stats GetStats() const;
+
+private:
+    struct Entry {
+        // Central directory record; its local header offset is filled in
+        // when the directory is written.
+        std::vector<uint8_t> central;
+        uint64_t offset = 0;
+        // Local header, data and any data descriptor.
+        uint64_t recordSize = 0;
+        uint64_t size = 0;
+        uint32_t crc = 0;
+    };
+
+    bool ReadDirectory(const uint8_t* data, size_t size, std::string& error);
+    std::vector<uint8_t> BuildDirectory(uint64_t offset) const;
+    bool FinishLocked(std::string& error);
+    bool CompactLocked(std::string& error);
+
+    std::string resourcePrefix;
+    std::filesystem::path path;
+    std::fstream file;
+    mutable std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    uint64_t appendOffset = 0;
+    uint64_t deadBytes = 0;
+    // Whether the directory on disk is out of date.
+    bool modified = false;
+    Stats stats;
+};
@@ -0,0 +1,86 @@
+#include "PathUtils.h"
+
+#include <cstdio>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+std::string ToUtf8(const std::wstring& input) {
+#ifdef _WIN32
+    if (input.empty()) {
+        return {};
+    }
+    int size = WideCharToMultiByte(CP_UTF8, 0, input.c_str(), static_cast<int>(input.size()), nullptr, 0, nullptr, nullptr);
+    std::string result(size, '\0');
+    WideCharToMultiByte(CP_UTF8, 0, input.c_str(), static_cast<int>(input.size()), result.data(), size, nullptr, nullptr);
+    return result;
+#else
+    return std::string(input.begin(), input.end());
+#endif
+}
+
+std::wstring ToWide(const std::string& input) {
+#ifdef _WIN32
+    if (input.empty()) {
+        return {};
+    }
+    int size = MultiByteToWideChar(CP_UTF8, 0, input.c_str(), static_cast<int>(input.size()), nullptr, 0);
+    std::wstring result(size, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, input.c_str(), static_cast<int>(input.size()), result.data(), size);
+    return result;
+#else
+    return std::wstring(input.begin(), input.end());
+#endif
+}
+
+std::string PathToUtf8(const std::filesystem::path& path) {
+#ifdef _WIN32
+    return ToUtf8(path.wstring());
+#else
+    try {
+        auto u8 = path.u8string();
+        return std::string(u8.begin(), u8.end());
+    } catch (const std::exception&) {
+        return path.string();
+    }
+#endif
+}
+
+std::filesystem::path Utf8ToPath(const std::string& value) {
+#ifdef _WIN32
+    return std::filesystem::path(ToWide(value));
+#else
+    std::u8string u8(value.begin(), value.end());
+    return std::filesystem::path(u8);
+#endif
+}
+
+void AppendJsonString(std::string& out, const std::string& text) {
+    out += '"';
+    for (char ch : text) {
+        switch (ch) {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if (static_cast<unsigned char>(ch) < 0x20) {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+                    out += escaped;
+                } else {
+                    out += ch;
+                }
+        }
+    }
+    out += '"';
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+
+std::string ToUtf8(const std::wstring& input);
+std::wstring ToWide(const std::string& input);
+std::string PathToUtf8(const std::filesystem::path& path);
+std::filesystem::path Utf8ToPath(const std::string& value);
+
+// Appends text as a quoted, escaped JSON string.
+void AppendJsonString(std::string& out, const std::string& text);
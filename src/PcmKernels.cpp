@@ -0,0 +1,1034 @@
+#include "PcmKernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SOH_PCM_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#if defined(SOH_PCM_X86) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define SOH_PCM_SSE2 1
+#endif
+
+#if defined(SOH_PCM_X86) && (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER))
+#define SOH_PCM_AVX2 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#define SOH_TARGET_AVX2
+#else
+#define SOH_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define SOH_PCM_NEON 1
+#include <arm_neon.h>
+#endif
+
+struct PcmKernelTable {
+    PcmIsa isa;
+    void (*swapS16)(const uint8_t* src, uint8_t* dst, size_t count);
+    void (*widenS16ToS32)(const int16_t* src, int32_t* dst, size_t count);
+    void (*narrowS32ToS16)(const int32_t* src, int16_t* dst, size_t count);
+    void (*widenS16ToF32)(const int16_t* src, float* dst, size_t count);
+    void (*narrowF32ToS16)(const float* src, int16_t* dst, size_t count);
+    void (*widenS24LEToF32)(const uint8_t* src, float* dst, size_t count);
+    void (*widenS32LEToF32)(const uint8_t* src, float* dst, size_t count);
+    void (*downmixF32)(const float* src, float* dst, size_t frameCount, size_t channelCount);
+    void (*accumulateError)(const int16_t* source, const int16_t* decoded, size_t count, PcmErrorSums& sums);
+    void (*peakBlocksS16)(const int16_t* src, int16_t* dst, size_t blockCount);
+    float (*dotF32)(const float* a, const float* b, size_t count);
+};
+
+// Vectors per block in the error kernels. Their 16-bit clip counters and
+// 32-bit error sums are flushed after each block, long before they could
+// overflow.
+static constexpr size_t kErrorBlockVectors = 4096;
+
+static constexpr float kS16ToF32 = 1.0f / 32768.0f;
+// Wider samples are shifted to the top of 32 bits first, so one scale
+// serves 24- and 32-bit input.
+static constexpr float kS32ToF32 = 1.0f / 2147483648.0f;
+
+// Scalar reference implementations. The vector versions below handle whole
+// registers and hand any tail to these.
+
+static void SwapS16Scalar(const uint8_t* src, uint8_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        uint8_t lo = src[i * 2];
+        uint8_t hi = src[i * 2 + 1];
+        dst[i * 2] = hi;
+        dst[i * 2 + 1] = lo;
+    }
+}
+
+static void WidenS16ToS32Scalar(const int16_t* src, int32_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = src[i];
+    }
+}
+
+static void NarrowS32ToS16Scalar(const int32_t* src, int16_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        int32_t value = src[i];
+        if (value > 32767) {
+            value = 32767;
+        } else if (value < -32768) {
+            value = -32768;
+        }
+        dst[i] = static_cast<int16_t>(value);
+    }
+}
+
+static void WidenS16ToF32Scalar(const int16_t* src, float* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = static_cast<float>(src[i]) * kS16ToF32;
+    }
+}
+
+static int16_t F32ToS16(float value) {
+    float scaled = value * 32768.0f;
+    // Written so NaN lands on the low clamp, matching the vector paths.
+    if (!(scaled >= -32768.0f)) {
+        scaled = -32768.0f;
+    }
+    if (scaled > 32767.0f) {
+        scaled = 32767.0f;
+    }
+    // Round half to even, like the default SSE/NEON conversion mode.
+    return static_cast<int16_t>(std::nearbyint(scaled));
+}
+
+static void NarrowF32ToS16Scalar(const float* src, int16_t* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        dst[i] = F32ToS16(src[i]);
+    }
+}
+
+static void WidenS24LEToF32Scalar(const uint8_t* src, float* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* p = src + i * 3;
+        uint32_t value = (static_cast<uint32_t>(p[0]) << 8) | (static_cast<uint32_t>(p[1]) << 16) |
+                         (static_cast<uint32_t>(p[2]) << 24);
+        dst[i] = static_cast<float>(static_cast<int32_t>(value)) * kS32ToF32;
+    }
+}
+
+static void WidenS32LEToF32Scalar(const uint8_t* src, float* dst, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* p = src + i * 4;
+        uint32_t value = static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                         (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+        dst[i] = static_cast<float>(static_cast<int32_t>(value)) * kS32ToF32;
+    }
+}
+
+static void DownmixF32Scalar(const float* src, float* dst, size_t frameCount, size_t channelCount) {
+    if (channelCount == 2) {
+        for (size_t i = 0; i < frameCount; i++) {
+            dst[i] = (src[i * 2] + src[i * 2 + 1]) * 0.5f;
+        }
+        return;
+    }
+    float scale = 1.0f / static_cast<float>(channelCount);
+    for (size_t i = 0; i < frameCount; i++) {
+        const float* frame = src + i * channelCount;
+        float sum = frame[0];
+        for (size_t channel = 1; channel < channelCount; channel++) {
+            sum += frame[channel];
+        }
+        dst[i] = sum * scale;
+    }
+}
+
+static void AccumulateErrorScalar(const int16_t* source, const int16_t* decoded, size_t count, PcmErrorSums& sums) {
+    for (size_t i = 0; i < count; i++) {
+        int32_t s = source[i];
+        int32_t d = decoded[i];
+        int32_t error = d - s;
+        uint32_t magnitude = static_cast<uint32_t>(error < 0 ? -error : error);
+        sums.signalEnergy += static_cast<uint64_t>(s * s);
+        sums.noiseEnergy += static_cast<uint64_t>(magnitude) * magnitude;
+        sums.errorSum += error;
+        sums.peakError = std::max(sums.peakError, magnitude);
+        sums.clippedSamples += (d == 32767 || d == -32768) ? 1 : 0;
+    }
+}
+
+static void PeakBlocksS16Scalar(const int16_t* src, int16_t* dst, size_t blockCount) {
+    for (size_t block = 0; block < blockCount; block++) {
+        const int16_t* samples = src + block * kPeakBlockSamples;
+        int16_t low = samples[0];
+        int16_t high = samples[0];
+        for (size_t i = 1; i < kPeakBlockSamples; i++) {
+            low = std::min(low, samples[i]);
+            high = std::max(high, samples[i]);
+        }
+        dst[block * 2] = low;
+        dst[block * 2 + 1] = high;
+    }
+}
+
+// Lane j sums the products at indices j, j + 8, ...; lanes are then folded
+// in halves, as a vector register would be.
+static float DotF32Scalar(const float* a, const float* b, size_t count) {
+    float lanes[8] = {};
+    for (size_t i = 0; i < count; i += 8) {
+        for (size_t lane = 0; lane < 8; lane++) {
+            lanes[lane] += a[i + lane] * b[i + lane];
+        }
+    }
+    for (size_t lane = 0; lane < 4; lane++) {
+        lanes[lane] += lanes[lane + 4];
+    }
+    return (lanes[0] + lanes[2]) + (lanes[1] + lanes[3]);
+}
+
+static const PcmKernelTable kScalarTable = {
+    PcmIsa::Scalar,
+    SwapS16Scalar,
+    WidenS16ToS32Scalar,
+    NarrowS32ToS16Scalar,
+    WidenS16ToF32Scalar,
+    NarrowF32ToS16Scalar,
+    WidenS24LEToF32Scalar,
+    WidenS32LEToF32Scalar,
+    DownmixF32Scalar,
+    AccumulateErrorScalar,
+    PeakBlocksS16Scalar,
+    DotF32Scalar,
+};
+
+#ifdef SOH_PCM_SSE2
+static void SwapS16Sse2(const uint8_t* src, uint8_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 2));
+        v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i * 2), v);
+    }
+    SwapS16Scalar(src + i * 2, dst + i * 2, count - i);
+}
+
+static void WidenS16ToS32Sse2(const int16_t* src, int32_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 4), hi);
+    }
+    WidenS16ToS32Scalar(src + i, dst + i, count - i);
+}
+
+static void NarrowS32ToS16Sse2(const int32_t* src, int16_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(lo, hi));
+    }
+    NarrowS32ToS16Scalar(src + i, dst + i, count - i);
+}
+
+static void WidenS16ToF32Sse2(const int16_t* src, float* dst, size_t count) {
+    const __m128 scale = _mm_set1_ps(kS16ToF32);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+        __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+        _mm_storeu_ps(dst + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+    }
+    WidenS16ToF32Scalar(src + i, dst + i, count - i);
+}
+
+static void NarrowF32ToS16Sse2(const float* src, int16_t* dst, size_t count) {
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 low = _mm_set1_ps(-32768.0f);
+    const __m128 high = _mm_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128 a = _mm_mul_ps(_mm_loadu_ps(src + i), scale);
+        __m128 b = _mm_mul_ps(_mm_loadu_ps(src + i + 4), scale);
+        // maxps returns its second operand for NaN, so NaN clamps low.
+        a = _mm_min_ps(_mm_max_ps(a, low), high);
+        b = _mm_min_ps(_mm_max_ps(b, low), high);
+        __m128i packed = _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), packed);
+    }
+    NarrowF32ToS16Scalar(src + i, dst + i, count - i);
+}
+
+static void WidenS32LEToF32Sse2(const uint8_t* src, float* dst, size_t count) {
+    const __m128 scale = _mm_set1_ps(kS32ToF32);
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i * 4));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_cvtepi32_ps(v), scale));
+    }
+    WidenS32LEToF32Scalar(src + i * 4, dst + i, count - i);
+}
+
+static void DownmixF32Sse2(const float* src, float* dst, size_t frameCount, size_t channelCount) {
+    if (channelCount != 2) {
+        DownmixF32Scalar(src, dst, frameCount, channelCount);
+        return;
+    }
+    const __m128 half = _mm_set1_ps(0.5f);
+    size_t i = 0;
+    for (; i + 4 <= frameCount; i += 4) {
+        __m128 a = _mm_loadu_ps(src + i * 2);
+        __m128 b = _mm_loadu_ps(src + i * 2 + 4);
+        __m128 left = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m128 right = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        _mm_storeu_ps(dst + i, _mm_mul_ps(_mm_add_ps(left, right), half));
+    }
+    DownmixF32Scalar(src + i * 2, dst + i, frameCount - i, channelCount);
+}
+
+static __m128i AbsS32Sse2(__m128i v) {
+    __m128i sign = _mm_srai_epi32(v, 31);
+    return _mm_sub_epi32(_mm_xor_si128(v, sign), sign);
+}
+
+// Only for values below 2^31, where signed and unsigned order agree.
+static __m128i MaxS32Sse2(__m128i a, __m128i b) {
+    __m128i greater = _mm_cmpgt_epi32(a, b);
+    return _mm_or_si128(_mm_and_si128(greater, a), _mm_andnot_si128(greater, b));
+}
+
+// Squares of four values below 2^32, added to two 64-bit lanes.
+static __m128i AddSquaresU32Sse2(__m128i sum, __m128i v) {
+    __m128i odd = _mm_srli_epi64(v, 32);
+    sum = _mm_add_epi64(sum, _mm_mul_epu32(v, v));
+    return _mm_add_epi64(sum, _mm_mul_epu32(odd, odd));
+}
+
+static void AccumulateErrorSse2(const int16_t* source, const int16_t* decoded, size_t count, PcmErrorSums& sums) {
+    const __m128i zero = _mm_setzero_si128();
+    // madd of interleaved (decoded, source) pairs with (1, -1) gives the
+    // 32-bit error directly.
+    const __m128i plusMinus = _mm_set1_epi32(static_cast<int>(0xFFFF0001u));
+    const __m128i ones = _mm_set1_epi16(1);
+    const __m128i clipHigh = _mm_set1_epi16(32767);
+    const __m128i clipLow = _mm_set1_epi16(-32768);
+    __m128i signal = zero;
+    __m128i noise = zero;
+    __m128i peak = zero;
+    size_t i = 0;
+    while (i + 8 <= count) {
+        size_t blockEnd = std::min(count & ~size_t(7), i + kErrorBlockVectors * 8);
+        __m128i errors = zero;
+        __m128i clips = zero;
+        for (; i < blockEnd; i += 8) {
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+            __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(decoded + i));
+            // Pairs of squares reach 2^31 at most, which fits once read
+            // as unsigned.
+            __m128i squares = _mm_madd_epi16(s, s);
+            signal = _mm_add_epi64(signal, _mm_unpacklo_epi32(squares, zero));
+            signal = _mm_add_epi64(signal, _mm_unpackhi_epi32(squares, zero));
+
+            __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(d, s), plusMinus);
+            __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(d, s), plusMinus);
+            errors = _mm_add_epi32(errors, _mm_add_epi32(lo, hi));
+            lo = AbsS32Sse2(lo);
+            hi = AbsS32Sse2(hi);
+            noise = AddSquaresU32Sse2(noise, lo);
+            noise = AddSquaresU32Sse2(noise, hi);
+            peak = MaxS32Sse2(peak, MaxS32Sse2(lo, hi));
+
+            __m128i clipped = _mm_or_si128(_mm_cmpeq_epi16(d, clipHigh), _mm_cmpeq_epi16(d, clipLow));
+            clips = _mm_sub_epi16(clips, clipped);
+        }
+        alignas(16) int32_t errorLanes[4];
+        alignas(16) int32_t clipLanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(errorLanes), errors);
+        _mm_store_si128(reinterpret_cast<__m128i*>(clipLanes), _mm_madd_epi16(clips, ones));
+        for (size_t lane = 0; lane < 4; lane++) {
+            sums.errorSum += errorLanes[lane];
+            sums.clippedSamples += static_cast<uint64_t>(clipLanes[lane]);
+        }
+    }
+
+    alignas(16) uint64_t signalLanes[2];
+    alignas(16) uint64_t noiseLanes[2];
+    alignas(16) uint32_t peakLanes[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(signalLanes), signal);
+    _mm_store_si128(reinterpret_cast<__m128i*>(noiseLanes), noise);
+    _mm_store_si128(reinterpret_cast<__m128i*>(peakLanes), peak);
+    sums.signalEnergy += signalLanes[0] + signalLanes[1];
+    sums.noiseEnergy += noiseLanes[0] + noiseLanes[1];
+    sums.peakError = std::max({sums.peakError, peakLanes[0], peakLanes[1], peakLanes[2], peakLanes[3]});
+    AccumulateErrorScalar(source + i, decoded + i, count - i, sums);
+}
+
+// Folds eight lane minimums and maximums to one of each. Maximums are
+// complemented (max(x) == ~min(~x)) so both reduce in the same register.
+static void FoldPeakSse2(__m128i low, __m128i high, int16_t* dst) {
+    __m128i folded = _mm_xor_si128(high, _mm_set1_epi16(-1));
+    folded = _mm_min_epi16(_mm_unpacklo_epi64(low, folded), _mm_unpackhi_epi64(low, folded));
+    folded = _mm_min_epi16(folded, _mm_shufflehi_epi16(_mm_shufflelo_epi16(folded, _MM_SHUFFLE(1, 0, 3, 2)),
+                                                       _MM_SHUFFLE(1, 0, 3, 2)));
+    folded = _mm_min_epi16(folded, _mm_shufflehi_epi16(_mm_shufflelo_epi16(folded, _MM_SHUFFLE(2, 3, 0, 1)),
+                                                       _MM_SHUFFLE(2, 3, 0, 1)));
+    dst[0] = static_cast<int16_t>(_mm_extract_epi16(folded, 0));
+    dst[1] = static_cast<int16_t>(~_mm_extract_epi16(folded, 4));
+}
+
+static void PeakBlocksS16Sse2(const int16_t* src, int16_t* dst, size_t blockCount) {
+    for (size_t block = 0; block < blockCount; block++) {
+        const int16_t* samples = src + block * kPeakBlockSamples;
+        __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples));
+        __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(samples + 8));
+        FoldPeakSse2(_mm_min_epi16(first, second), _mm_max_epi16(first, second), dst + block * 2);
+    }
+}
+
+static float DotF32Sse2(const float* a, const float* b, size_t count) {
+    __m128 low = _mm_setzero_ps();
+    __m128 high = low;
+    for (size_t i = 0; i < count; i += 8) {
+        low = _mm_add_ps(low, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        high = _mm_add_ps(high, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 sum = _mm_add_ps(low, high);
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+static const PcmKernelTable kSse2Table = {
+    PcmIsa::Sse2,
+    SwapS16Sse2,
+    WidenS16ToS32Sse2,
+    NarrowS32ToS16Sse2,
+    WidenS16ToF32Sse2,
+    NarrowF32ToS16Sse2,
+    WidenS24LEToF32Scalar,
+    WidenS32LEToF32Sse2,
+    DownmixF32Sse2,
+    AccumulateErrorSse2,
+    PeakBlocksS16Sse2,
+    DotF32Sse2,
+};
+#endif
+
+#ifdef SOH_PCM_AVX2
+SOH_TARGET_AVX2 static void SwapS16Avx2(const uint8_t* src, uint8_t* dst, size_t count) {
+    const __m256i shuffle = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                             1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 2));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i * 2), _mm256_shuffle_epi8(v, shuffle));
+    }
+    SwapS16Scalar(src + i * 2, dst + i * 2, count - i);
+}
+
+SOH_TARGET_AVX2 static void WidenS16ToS32Avx2(const int16_t* src, int32_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cvtepi16_epi32(v));
+    }
+    WidenS16ToS32Scalar(src + i, dst + i, count - i);
+}
+
+SOH_TARGET_AVX2 static void NarrowS32ToS16Avx2(const int32_t* src, int16_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 8));
+        // packs works per 128-bit lane; restore the sample order afterwards.
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+    NarrowS32ToS16Scalar(src + i, dst + i, count - i);
+}
+
+SOH_TARGET_AVX2 static void WidenS16ToF32Avx2(const int16_t* src, float* dst, size_t count) {
+    const __m256 scale = _mm256_set1_ps(kS16ToF32);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(v));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(f, scale));
+    }
+    WidenS16ToF32Scalar(src + i, dst + i, count - i);
+}
+
+SOH_TARGET_AVX2 static void NarrowF32ToS16Avx2(const float* src, int16_t* dst, size_t count) {
+    const __m256 scale = _mm256_set1_ps(32768.0f);
+    const __m256 low = _mm256_set1_ps(-32768.0f);
+    const __m256 high = _mm256_set1_ps(32767.0f);
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m256 a = _mm256_mul_ps(_mm256_loadu_ps(src + i), scale);
+        __m256 b = _mm256_mul_ps(_mm256_loadu_ps(src + i + 8), scale);
+        a = _mm256_min_ps(_mm256_max_ps(a, low), high);
+        b = _mm256_min_ps(_mm256_max_ps(b, low), high);
+        __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+        packed = _mm256_permute4x64_epi64(packed, 0xD8);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), packed);
+    }
+    NarrowF32ToS16Scalar(src + i, dst + i, count - i);
+}
+
+SOH_TARGET_AVX2 static __m256i AddSquaresU32Avx2(__m256i sum, __m256i v) {
+    __m256i odd = _mm256_srli_epi64(v, 32);
+    sum = _mm256_add_epi64(sum, _mm256_mul_epu32(v, v));
+    return _mm256_add_epi64(sum, _mm256_mul_epu32(odd, odd));
+}
+
+SOH_TARGET_AVX2 static void AccumulateErrorAvx2(const int16_t* source,
+                                                const int16_t* decoded,
+                                                size_t count,
+                                                PcmErrorSums& sums) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i plusMinus = _mm256_set1_epi32(static_cast<int>(0xFFFF0001u));
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i clipHigh = _mm256_set1_epi16(32767);
+    const __m256i clipLow = _mm256_set1_epi16(-32768);
+    __m256i signal = zero;
+    __m256i noise = zero;
+    __m256i peak = zero;
+    size_t i = 0;
+    while (i + 16 <= count) {
+        size_t blockEnd = std::min(count & ~size_t(15), i + kErrorBlockVectors * 16);
+        __m256i errors = zero;
+        __m256i clips = zero;
+        for (; i < blockEnd; i += 16) {
+            __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(decoded + i));
+            __m256i squares = _mm256_madd_epi16(s, s);
+            signal = _mm256_add_epi64(signal, _mm256_unpacklo_epi32(squares, zero));
+            signal = _mm256_add_epi64(signal, _mm256_unpackhi_epi32(squares, zero));
+
+            // Unpacking works per 128-bit lane, which only reorders the
+            // errors; every total here is order-independent.
+            __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(d, s), plusMinus);
+            __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(d, s), plusMinus);
+            errors = _mm256_add_epi32(errors, _mm256_add_epi32(lo, hi));
+            lo = _mm256_abs_epi32(lo);
+            hi = _mm256_abs_epi32(hi);
+            noise = AddSquaresU32Avx2(noise, lo);
+            noise = AddSquaresU32Avx2(noise, hi);
+            peak = _mm256_max_epu32(peak, _mm256_max_epu32(lo, hi));
+
+            __m256i clipped = _mm256_or_si256(_mm256_cmpeq_epi16(d, clipHigh), _mm256_cmpeq_epi16(d, clipLow));
+            clips = _mm256_sub_epi16(clips, clipped);
+        }
+        alignas(32) int32_t errorLanes[8];
+        alignas(32) int32_t clipLanes[8];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(errorLanes), errors);
+        _mm256_store_si256(reinterpret_cast<__m256i*>(clipLanes), _mm256_madd_epi16(clips, ones));
+        for (size_t lane = 0; lane < 8; lane++) {
+            sums.errorSum += errorLanes[lane];
+            sums.clippedSamples += static_cast<uint64_t>(clipLanes[lane]);
+        }
+    }
+
+    alignas(32) uint64_t signalLanes[4];
+    alignas(32) uint64_t noiseLanes[4];
+    alignas(32) uint32_t peakLanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(signalLanes), signal);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(noiseLanes), noise);
+    _mm256_store_si256(reinterpret_cast<__m256i*>(peakLanes), peak);
+    for (size_t lane = 0; lane < 4; lane++) {
+        sums.signalEnergy += signalLanes[lane];
+        sums.noiseEnergy += noiseLanes[lane];
+    }
+    for (uint32_t lane : peakLanes) {
+        sums.peakError = std::max(sums.peakError, lane);
+    }
+    AccumulateErrorScalar(source + i, decoded + i, count - i, sums);
+}
+
+// SSE2 has no byte shuffle, so only AVX2 unpacks 24-bit samples.
+SOH_TARGET_AVX2 static void WidenS24LEToF32Avx2(const uint8_t* src, float* dst, size_t count) {
+    const __m256 scale = _mm256_set1_ps(kS32ToF32);
+    // Bytes 0-11 to the low lane and 12-23 to the high one, then each
+    // 3-byte sample to the top of a 32-bit lane.
+    const __m256i spread = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);
+    const __m256i unpack = _mm256_setr_epi8(-128, 0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11,
+                                            -128, 0, 1, 2, -128, 3, 4, 5, -128, 6, 7, 8, -128, 9, 10, 11);
+    size_t i = 0;
+    // Each load reads 32 bytes for 24, so stop while 8 spare bytes remain.
+    for (; i + 11 <= count; i += 8) {
+        __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 3));
+        __m256i values = _mm256_shuffle_epi8(_mm256_permutevar8x32_epi32(bytes, spread), unpack);
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(values), scale));
+    }
+    WidenS24LEToF32Scalar(src + i * 3, dst + i, count - i);
+}
+
+SOH_TARGET_AVX2 static void WidenS32LEToF32Avx2(const uint8_t* src, float* dst, size_t count) {
+    const __m256 scale = _mm256_set1_ps(kS32ToF32);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i * 4));
+        _mm256_storeu_ps(dst + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    WidenS32LEToF32Scalar(src + i * 4, dst + i, count - i);
+}
+
+SOH_TARGET_AVX2 static void DownmixF32Avx2(const float* src, float* dst, size_t frameCount, size_t channelCount) {
+    if (channelCount != 2) {
+        DownmixF32Scalar(src, dst, frameCount, channelCount);
+        return;
+    }
+    const __m256 half = _mm256_set1_ps(0.5f);
+    size_t i = 0;
+    for (; i + 8 <= frameCount; i += 8) {
+        __m256 a = _mm256_loadu_ps(src + i * 2);
+        __m256 b = _mm256_loadu_ps(src + i * 2 + 8);
+        // Per lane: frames 0, 1, 4, 5 and 2, 3, 6, 7; the permute restores
+        // the order.
+        __m256 left = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+        __m256 right = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+        __m256 mixed = _mm256_mul_ps(_mm256_add_ps(left, right), half);
+        mixed = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(mixed), 0xD8));
+        _mm256_storeu_ps(dst + i, mixed);
+    }
+    DownmixF32Scalar(src + i * 2, dst + i, frameCount - i, channelCount);
+}
+
+// Two blocks per step, one in each 128-bit half, folded as in the SSE2
+// kernel.
+SOH_TARGET_AVX2 static void PeakBlocksS16Avx2(const int16_t* src, int16_t* dst, size_t blockCount) {
+    const __m256i ones = _mm256_set1_epi16(-1);
+    size_t block = 0;
+    for (; block + 2 <= blockCount; block += 2) {
+        const int16_t* samples = src + block * kPeakBlockSamples;
+        __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples));
+        __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + kPeakBlockSamples));
+        __m256i lowHalves = _mm256_permute2x128_si256(first, second, 0x20);
+        __m256i highHalves = _mm256_permute2x128_si256(first, second, 0x31);
+        __m256i low = _mm256_min_epi16(lowHalves, highHalves);
+        __m256i high = _mm256_xor_si256(_mm256_max_epi16(lowHalves, highHalves), ones);
+        __m256i folded = _mm256_min_epi16(_mm256_unpacklo_epi64(low, high), _mm256_unpackhi_epi64(low, high));
+        folded = _mm256_min_epi16(folded, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(folded, _MM_SHUFFLE(1, 0, 3, 2)),
+                                                                 _MM_SHUFFLE(1, 0, 3, 2)));
+        folded = _mm256_min_epi16(folded, _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(folded, _MM_SHUFFLE(2, 3, 0, 1)),
+                                                                 _MM_SHUFFLE(2, 3, 0, 1)));
+        int16_t* out = dst + block * 2;
+        out[0] = static_cast<int16_t>(_mm256_extract_epi16(folded, 0));
+        out[1] = static_cast<int16_t>(~_mm256_extract_epi16(folded, 4));
+        out[2] = static_cast<int16_t>(_mm256_extract_epi16(folded, 8));
+        out[3] = static_cast<int16_t>(~_mm256_extract_epi16(folded, 12));
+    }
+    PeakBlocksS16Scalar(src + block * kPeakBlockSamples, dst + block * 2, blockCount - block);
+}
+
+SOH_TARGET_AVX2 static float DotF32Avx2(const float* a, const float* b, size_t count) {
+    __m256 lanes = _mm256_setzero_ps();
+    for (size_t i = 0; i < count; i += 8) {
+        lanes = _mm256_add_ps(lanes, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+    }
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(lanes), _mm256_extractf128_ps(lanes, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+static const PcmKernelTable kAvx2Table = {
+    PcmIsa::Avx2,
+    SwapS16Avx2,
+    WidenS16ToS32Avx2,
+    NarrowS32ToS16Avx2,
+    WidenS16ToF32Avx2,
+    NarrowF32ToS16Avx2,
+    WidenS24LEToF32Avx2,
+    WidenS32LEToF32Avx2,
+    DownmixF32Avx2,
+    AccumulateErrorAvx2,
+    PeakBlocksS16Avx2,
+    DotF32Avx2,
+};
+#endif
+
+#ifdef SOH_PCM_NEON
+static void SwapS16Neon(const uint8_t* src, uint8_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u8(dst + i * 2, vrev16q_u8(vld1q_u8(src + i * 2)));
+    }
+    SwapS16Scalar(src + i * 2, dst + i * 2, count - i);
+}
+
+static void WidenS16ToS32Neon(const int16_t* src, int32_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        vst1q_s32(dst + i, vmovl_s16(vget_low_s16(v)));
+        vst1q_s32(dst + i + 4, vmovl_s16(vget_high_s16(v)));
+    }
+    WidenS16ToS32Scalar(src + i, dst + i, count - i);
+}
+
+static void NarrowS32ToS16Neon(const int32_t* src, int16_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x4_t lo = vqmovn_s32(vld1q_s32(src + i));
+        int16x4_t hi = vqmovn_s32(vld1q_s32(src + i + 4));
+        vst1q_s16(dst + i, vcombine_s16(lo, hi));
+    }
+    NarrowS32ToS16Scalar(src + i, dst + i, count - i);
+}
+
+static void WidenS16ToF32Neon(const int16_t* src, float* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t v = vld1q_s16(src + i);
+        float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(v)));
+        float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(v)));
+        vst1q_f32(dst + i, vmulq_n_f32(lo, kS16ToF32));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(hi, kS16ToF32));
+    }
+    WidenS16ToF32Scalar(src + i, dst + i, count - i);
+}
+
+static int32x4_t ClampRoundNeon(float32x4_t value) {
+    const float32x4_t low = vdupq_n_f32(-32768.0f);
+    const float32x4_t high = vdupq_n_f32(32767.0f);
+    value = vmulq_n_f32(value, 32768.0f);
+    // Select rather than vmaxq so NaN clamps low like the scalar path.
+    value = vbslq_f32(vcgeq_f32(value, low), value, low);
+    value = vminq_f32(value, high);
+    return vcvtnq_s32_f32(value);
+}
+
+static void NarrowF32ToS16Neon(const float* src, int16_t* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x4_t lo = vqmovn_s32(ClampRoundNeon(vld1q_f32(src + i)));
+        int16x4_t hi = vqmovn_s32(ClampRoundNeon(vld1q_f32(src + i + 4)));
+        vst1q_s16(dst + i, vcombine_s16(lo, hi));
+    }
+    NarrowF32ToS16Scalar(src + i, dst + i, count - i);
+}
+
+static void AccumulateErrorNeon(const int16_t* source, const int16_t* decoded, size_t count, PcmErrorSums& sums) {
+    const int16x8_t clipHigh = vdupq_n_s16(32767);
+    const int16x8_t clipLow = vdupq_n_s16(-32768);
+    uint64x2_t signal = vdupq_n_u64(0);
+    uint64x2_t noise = vdupq_n_u64(0);
+    int64x2_t errors = vdupq_n_s64(0);
+    uint64x2_t clips = vdupq_n_u64(0);
+    uint32x4_t peak = vdupq_n_u32(0);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        int16x8_t s = vld1q_s16(source + i);
+        int16x8_t d = vld1q_s16(decoded + i);
+        // Single squares stay below 2^31.
+        signal = vpadalq_u32(signal, vreinterpretq_u32_s32(vmull_s16(vget_low_s16(s), vget_low_s16(s))));
+        signal = vpadalq_u32(signal, vreinterpretq_u32_s32(vmull_s16(vget_high_s16(s), vget_high_s16(s))));
+
+        int32x4_t lo = vsubl_s16(vget_low_s16(d), vget_low_s16(s));
+        int32x4_t hi = vsubl_s16(vget_high_s16(d), vget_high_s16(s));
+        errors = vpadalq_s32(errors, lo);
+        errors = vpadalq_s32(errors, hi);
+        uint32x4_t loMagnitude = vreinterpretq_u32_s32(vabsq_s32(lo));
+        uint32x4_t hiMagnitude = vreinterpretq_u32_s32(vabsq_s32(hi));
+        noise = vmlal_u32(noise, vget_low_u32(loMagnitude), vget_low_u32(loMagnitude));
+        noise = vmlal_u32(noise, vget_high_u32(loMagnitude), vget_high_u32(loMagnitude));
+        noise = vmlal_u32(noise, vget_low_u32(hiMagnitude), vget_low_u32(hiMagnitude));
+        noise = vmlal_u32(noise, vget_high_u32(hiMagnitude), vget_high_u32(hiMagnitude));
+        peak = vmaxq_u32(peak, vmaxq_u32(loMagnitude, hiMagnitude));
+
+        uint16x8_t clipped = vorrq_u16(vceqq_s16(d, clipHigh), vceqq_s16(d, clipLow));
+        clips = vpadalq_u32(clips, vpaddlq_u16(vshrq_n_u16(clipped, 15)));
+    }
+    sums.signalEnergy += vgetq_lane_u64(signal, 0) + vgetq_lane_u64(signal, 1);
+    sums.noiseEnergy += vgetq_lane_u64(noise, 0) + vgetq_lane_u64(noise, 1);
+    sums.errorSum += vgetq_lane_s64(errors, 0) + vgetq_lane_s64(errors, 1);
+    sums.clippedSamples += vgetq_lane_u64(clips, 0) + vgetq_lane_u64(clips, 1);
+    sums.peakError = std::max(sums.peakError, vmaxvq_u32(peak));
+    AccumulateErrorScalar(source + i, decoded + i, count - i, sums);
+}
+
+static void WidenS24LEToF32Neon(const uint8_t* src, float* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        uint8x8x3_t bytes = vld3_u8(src + i * 3);
+        // Each sample becomes byte0 << 8 | (byte2 << 8 | byte1) << 16.
+        uint16x8_t low = vshlq_n_u16(vmovl_u8(bytes.val[0]), 8);
+        uint16x8_t high = vorrq_u16(vshlq_n_u16(vmovl_u8(bytes.val[2]), 8), vmovl_u8(bytes.val[1]));
+        uint16x8x2_t words = vzipq_u16(low, high);
+        float32x4_t first = vcvtq_f32_s32(vreinterpretq_s32_u16(words.val[0]));
+        float32x4_t second = vcvtq_f32_s32(vreinterpretq_s32_u16(words.val[1]));
+        vst1q_f32(dst + i, vmulq_n_f32(first, kS32ToF32));
+        vst1q_f32(dst + i + 4, vmulq_n_f32(second, kS32ToF32));
+    }
+    WidenS24LEToF32Scalar(src + i * 3, dst + i, count - i);
+}
+
+static void WidenS32LEToF32Neon(const uint8_t* src, float* dst, size_t count) {
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        int32x4_t v = vreinterpretq_s32_u8(vld1q_u8(src + i * 4));
+        vst1q_f32(dst + i, vmulq_n_f32(vcvtq_f32_s32(v), kS32ToF32));
+    }
+    WidenS32LEToF32Scalar(src + i * 4, dst + i, count - i);
+}
+
+static void DownmixF32Neon(const float* src, float* dst, size_t frameCount, size_t channelCount) {
+    if (channelCount != 2) {
+        DownmixF32Scalar(src, dst, frameCount, channelCount);
+        return;
+    }
+    size_t i = 0;
+    for (; i + 4 <= frameCount; i += 4) {
+        float32x4x2_t frames = vld2q_f32(src + i * 2);
+        vst1q_f32(dst + i, vmulq_n_f32(vaddq_f32(frames.val[0], frames.val[1]), 0.5f));
+    }
+    DownmixF32Scalar(src + i * 2, dst + i, frameCount - i, channelCount);
+}
+
+static void PeakBlocksS16Neon(const int16_t* src, int16_t* dst, size_t blockCount) {
+    for (size_t block = 0; block < blockCount; block++) {
+        const int16_t* samples = src + block * kPeakBlockSamples;
+        int16x8_t first = vld1q_s16(samples);
+        int16x8_t second = vld1q_s16(samples + 8);
+        dst[block * 2] = vminvq_s16(vminq_s16(first, second));
+        dst[block * 2 + 1] = vmaxvq_s16(vmaxq_s16(first, second));
+    }
+}
+
+static float DotF32Neon(const float* a, const float* b, size_t count) {
+    float32x4_t low = vdupq_n_f32(0.0f);
+    float32x4_t high = low;
+    for (size_t i = 0; i < count; i += 8) {
+        low = vaddq_f32(low, vmulq_f32(vld1q_f32(a + i), vld1q_f32(b + i)));
+        high = vaddq_f32(high, vmulq_f32(vld1q_f32(a + i + 4), vld1q_f32(b + i + 4)));
+    }
+    float32x4_t sum = vaddq_f32(low, high);
+    float32x2_t pairs = vadd_f32(vget_low_f32(sum), vget_high_f32(sum));
+    return vget_lane_f32(pairs, 0) + vget_lane_f32(pairs, 1);
+}
+
+static const PcmKernelTable kNeonTable = {
+    PcmIsa::Neon,
+    SwapS16Neon,
+    WidenS16ToS32Neon,
+    NarrowS32ToS16Neon,
+    WidenS16ToF32Neon,
+    NarrowF32ToS16Neon,
+    WidenS24LEToF32Neon,
+    WidenS32LEToF32Neon,
+    DownmixF32Neon,
+    AccumulateErrorNeon,
+    PeakBlocksS16Neon,
+    DotF32Neon,
+};
+#endif
+
+#ifdef SOH_PCM_AVX2
+static bool CpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int regs[4];
+    __cpuid(regs, 0);
+    if (regs[0] < 7) {
+        return false;
+    }
+    __cpuid(regs, 1);
+    bool osxsave = (regs[2] & (1 << 27)) != 0;
+    bool avx = (regs[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+        return false;
+    }
+    __cpuidex(regs, 7, 0);
+    return (regs[1] & (1 << 5)) != 0;
+#else
+    unsigned int eax = 0;
+    unsigned int ebx = 0;
+    unsigned int ecx = 0;
+    unsigned int edx = 0;
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    bool osxsave = (ecx & (1u << 27)) != 0;
+    bool avx = (ecx & (1u << 28)) != 0;
+    if (!osxsave || !avx) {
+        return false;
+    }
+    unsigned int xcr0Lo = 0;
+    unsigned int xcr0Hi = 0;
+    __asm__("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+    if ((xcr0Lo & 6) != 6) {
+        return false;
+    }
+    if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        return false;
+    }
+    return (ebx & (1u << 5)) != 0;
+#endif
+}
+#endif
+
+static const PcmKernelTable* TableFor(PcmIsa isa) {
+    switch (isa) {
+        case PcmIsa::Scalar:
+            return &kScalarTable;
+        case PcmIsa::Sse2:
+#ifdef SOH_PCM_SSE2
+            return &kSse2Table;
+#else
+            return nullptr;
+#endif
+        case PcmIsa::Avx2: {
+#ifdef SOH_PCM_AVX2
+            static const bool hasAvx2 = CpuHasAvx2();
+            return hasAvx2 ? &kAvx2Table : nullptr;
+#else
+            return nullptr;
+#endif
+        }
+        case PcmIsa::Neon:
+#ifdef SOH_PCM_NEON
+            return &kNeonTable;
+#else
+            return nullptr;
+#endif
+    }
+    return nullptr;
+}
+
+static std::atomic<const PcmKernelTable*> activeTable{nullptr};
+
+static const PcmKernelTable& Kernels() {
+    const PcmKernelTable* table = activeTable.load(std::memory_order_acquire);
+    if (!table) {
+        for (PcmIsa isa : {PcmIsa::Avx2, PcmIsa::Neon, PcmIsa::Sse2, PcmIsa::Scalar}) {
+            table = TableFor(isa);
+            if (table) {
+                break;
+            }
+        }
+        activeTable.store(table, std::memory_order_release);
+    }
+    return *table;
+}
+
+const char* PcmIsaName(PcmIsa isa) {
+    switch (isa) {
+        case PcmIsa::Scalar:
+            return "scalar";
+        case PcmIsa::Sse2:
+            return "sse2";
+        case PcmIsa::Avx2:
+            return "avx2";
+        case PcmIsa::Neon:
+            return "neon";
+    }
+    return "";
+}
+
+PcmIsa GetPcmIsa() {
+    return Kernels().isa;
+}
+
+bool IsPcmIsaSupported(PcmIsa isa) {
+    return TableFor(isa) != nullptr;
+}
+
+bool SetPcmIsa(PcmIsa isa) {
+    const PcmKernelTable* table = TableFor(isa);
+    if (!table) {
+        return false;
+    }
+    activeTable.store(table, std::memory_order_release);
+    return true;
+}
+
+static void CopyNative(const void* src, void* dst, size_t bytes) {
+    if (src != dst) {
+        std::memmove(dst, src, bytes);
+    }
+}
+
+void CopyS16LE(const uint8_t* src, int16_t* dst, size_t count) {
+    if constexpr (std::endian::native == std::endian::little) {
+        CopyNative(src, dst, count * 2);
+    } else {
+        Kernels().swapS16(src, reinterpret_cast<uint8_t*>(dst), count);
+    }
+}
+
+void CopyS16BE(const uint8_t* src, int16_t* dst, size_t count) {
+    if constexpr (std::endian::native == std::endian::big) {
+        CopyNative(src, dst, count * 2);
+    } else {
+        Kernels().swapS16(src, reinterpret_cast<uint8_t*>(dst), count);
+    }
+}
+
+void StoreS16LE(const int16_t* src, uint8_t* dst, size_t count) {
+    if constexpr (std::endian::native == std::endian::little) {
+        CopyNative(src, dst, count * 2);
+    } else {
+        Kernels().swapS16(reinterpret_cast<const uint8_t*>(src), dst, count);
+    }
+}
+
+void StoreS16BE(const int16_t* src, uint8_t* dst, size_t count) {
+    if constexpr (std::endian::native == std::endian::big) {
+        CopyNative(src, dst, count * 2);
+    } else {
+        Kernels().swapS16(reinterpret_cast<const uint8_t*>(src), dst, count);
+    }
+}
+
+void WidenS16ToS32(const int16_t* src, int32_t* dst, size_t count) {
+    Kernels().widenS16ToS32(src, dst, count);
+}
+
+void NarrowS32ToS16(const int32_t* src, int16_t* dst, size_t count) {
+    Kernels().narrowS32ToS16(src, dst, count);
+}
+
+void WidenS16ToF32(const int16_t* src, float* dst, size_t count) {
+    Kernels().widenS16ToF32(src, dst, count);
+}
+
+void NarrowF32ToS16(const float* src, int16_t* dst, size_t count) {
+    Kernels().narrowF32ToS16(src, dst, count);
+}
+
+void AccumulatePcmError(const int16_t* source, const int16_t* decoded, size_t count, PcmErrorSums& sums) {
+    sums.sampleCount += count;
+    Kernels().accumulateError(source, decoded, count, sums);
+}
+
+void PeakBlocksS16(const int16_t* src, int16_t* dst, size_t blockCount) {
+    Kernels().peakBlocksS16(src, dst, blockCount);
+}
+
+float DotF32(const float* a, const float* b, size_t count) {
+    return Kernels().dotF32(a, b, count);
+}
+
+void WidenS24LEToF32(const uint8_t* src, float* dst, size_t count) {
+    Kernels().widenS24LEToF32(src, dst, count);
+}
+
+void WidenS32LEToF32(const uint8_t* src, float* dst, size_t count) {
+    Kernels().widenS32LEToF32(src, dst, count);
+}
+
+void DownmixF32(const float* src, float* dst, size_t frameCount, size_t channelCount) {
+    Kernels().downmixF32(src, dst, frameCount, channelCount);
+}
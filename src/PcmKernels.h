@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Bulk PCM conversion kernels. The first call picks the widest
+// implementation the CPU supports; every implementation gives bit-identical
+// results. Unless noted, src and dst may be the same buffer but must not
+// otherwise overlap.
+
+enum class PcmIsa : uint8_t {
+    Scalar,
+    Sse2,
+    Avx2,
+    Neon,
+};
+
+const char* PcmIsaName(PcmIsa isa);
+PcmIsa GetPcmIsa();
+bool IsPcmIsaSupported(PcmIsa isa);
+// Forces a specific implementation (for benchmarks). Returns false and keeps
+// the current one if the CPU cannot run it.
+bool SetPcmIsa(PcmIsa isa);
+
+// Little-endian 16-bit bytes to host-order samples.
+void CopyS16LE(const uint8_t* src, int16_t* dst, size_t count);
+// Big-endian 16-bit bytes to host-order samples.
+void CopyS16BE(const uint8_t* src, int16_t* dst, size_t count);
+// Host-order samples to little-endian 16-bit bytes.
+void StoreS16LE(const int16_t* src, uint8_t* dst, size_t count);
+// Host-order samples to big-endian 16-bit bytes.
+void StoreS16BE(const int16_t* src, uint8_t* dst, size_t count);
+
+// Sign-extends samples to 32 bits. src and dst must not overlap.
+void WidenS16ToS32(const int16_t* src, int32_t* dst, size_t count);
+// Narrows 32-bit values to 16 bits with saturation.
+void NarrowS32ToS16(const int32_t* src, int16_t* dst, size_t count);
+// Scales samples to [-1, 1). src and dst must not overlap.
+void WidenS16ToF32(const int16_t* src, float* dst, size_t count);
+// Scales [-1, 1] floats to samples, rounding to nearest and saturating.
+void NarrowF32ToS16(const float* src, int16_t* dst, size_t count);
+// Packed little-endian 24-bit samples to [-1, 1) floats.
+void WidenS24LEToF32(const uint8_t* src, float* dst, size_t count);
+// Little-endian 32-bit samples to [-1, 1) floats.
+void WidenS32LEToF32(const uint8_t* src, float* dst, size_t count);
+// Averages each frame of channelCount interleaved values into one. dst may
+// be the same buffer as src.
+void DownmixF32(const float* src, float* dst, size_t frameCount, size_t channelCount);
+
+// Running totals of how decoded audio differs from its source. Kept as
+// integers, so they are exact and identical across implementations.
+struct PcmErrorSums {
+    uint64_t sampleCount = 0;
+    uint64_t signalEnergy = 0;
+    uint64_t noiseEnergy = 0;
+    int64_t errorSum = 0;
+    uint32_t peakError = 0;
+    // Decoded samples at either end of the 16-bit range.
+    uint64_t clippedSamples = 0;
+};
+
+// Adds count (source, decoded) sample pairs to sums.
+void AccumulatePcmError(const int16_t* source, const int16_t* decoded, size_t count, PcmErrorSums& sums);
+
+// Samples per block of PeakBlocksS16.
+constexpr size_t kPeakBlockSamples = 16;
+
+// Minimum and maximum of each 16-sample block of src, written to dst as
+// (min, max) pairs: 2 * blockCount values.
+void PeakBlocksS16(const int16_t* src, int16_t* dst, size_t blockCount);
+
+// Dot product of two float arrays. count must be a multiple of 8; every
+// implementation sums in the same eight-lane order.
+float DotF32(const float* a, const float* b, size_t count);
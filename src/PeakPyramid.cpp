@@ -0,0 +1,112 @@
+#include "PeakPyramid.h"
+
+#include "PcmKernels.h"
+
+#include <algorithm>
+
+// Blocks reduced between cancel checks, about 1M samples.
+static constexpr size_t kBuildChunkBlocks = size_t(1) << 16;
+
+static void MergePeaks(const int16_t* pairs, size_t count, SamplePeak& peak) {
+    for (size_t i = 0; i < count; i++) {
+        peak.min = std::min(peak.min, pairs[i * 2]);
+        peak.max = std::max(peak.max, pairs[i * 2 + 1]);
+    }
+}
+
+bool PeakPyramid::Open(const std::filesystem::path& path, std::string& error, const std::atomic<bool>* cancel) {
+    levels.clear();
+    samples = {};
+    if (!OpenWavView(path, wav, error)) {
+        return false;
+    }
+    if (!Build(wav.samples, cancel)) {
+        error = "Cancelled.";
+        return false;
+    }
+    return true;
+}
+
+bool PeakPyramid::Build(std::span<const int16_t> input, const std::atomic<bool>* cancel) {
+    levels.clear();
+    samples = input;
+    if (samples.empty()) {
+        return true;
+    }
+
+    size_t fullBlocks = samples.size() / kPeakBlockSamples;
+    size_t tail = samples.size() % kPeakBlockSamples;
+    std::vector<int16_t> base((fullBlocks + (tail ? 1 : 0)) * 2);
+    for (size_t block = 0; block < fullBlocks; block += kBuildChunkBlocks) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) {
+            return false;
+        }
+        PeakBlocksS16(samples.data() + block * kPeakBlockSamples, base.data() + block * 2,
+                      std::min(kBuildChunkBlocks, fullBlocks - block));
+    }
+    if (tail) {
+        auto [low, high] = std::minmax_element(samples.end() - static_cast<ptrdiff_t>(tail), samples.end());
+        base[fullBlocks * 2] = *low;
+        base[fullBlocks * 2 + 1] = *high;
+    }
+    levels.push_back(std::move(base));
+
+    // Upper levels hold a sixteenth of the samples between them, so plain
+    // loops build them in a fraction of the base level's time.
+    while (levels.back().size() / 2 > kPeakFanOut) {
+        const std::vector<int16_t>& below = levels.back();
+        size_t belowCount = below.size() / 2;
+        std::vector<int16_t> level((belowCount + kPeakFanOut - 1) / kPeakFanOut * 2);
+        for (size_t i = 0; i * kPeakFanOut < belowCount; i++) {
+            SamplePeak peak{below[i * kPeakFanOut * 2], below[i * kPeakFanOut * 2 + 1]};
+            MergePeaks(below.data() + i * kPeakFanOut * 2, std::min<size_t>(kPeakFanOut, belowCount - i * kPeakFanOut),
+                       peak);
+            level[i * 2] = peak.min;
+            level[i * 2 + 1] = peak.max;
+        }
+        levels.push_back(std::move(level));
+    }
+    return true;
+}
+
+void PeakPyramid::Query(uint64_t start, uint64_t end, std::span<SamplePeak> out) const {
+    end = std::min<uint64_t>(end, samples.size());
+    if (out.empty() || start >= end) {
+        std::fill(out.begin(), out.end(), SamplePeak{});
+        return;
+    }
+    uint64_t length = end - start;
+    uint64_t columns = out.size();
+    uint64_t perColumn = length / columns;
+
+    // The coarsest level with at least two blocks per column keeps every
+    // column to at most 2 * kPeakFanOut + 1 blocks. Below one level-0 block
+    // per column the samples are cheaper than the summaries.
+    const std::vector<int16_t>* level = nullptr;
+    uint64_t blockSize = 0;
+    for (size_t index = 0; index < levels.size(); index++) {
+        uint64_t size = static_cast<uint64_t>(kPeakBlockSamples) << (2 * index);
+        if (size * 2 > perColumn) {
+            break;
+        }
+        level = &levels[index];
+        blockSize = size;
+    }
+
+    for (uint64_t column = 0; column < columns; column++) {
+        uint64_t first = start + length * column / columns;
+        uint64_t last = std::max(start + length * (column + 1) / columns, first + 1);
+        SamplePeak& peak = out[column];
+        if (!level) {
+            auto [low, high] = std::minmax_element(samples.begin() + static_cast<ptrdiff_t>(first),
+                                                   samples.begin() + static_cast<ptrdiff_t>(last));
+            peak = {*low, *high};
+            continue;
+        }
+        uint64_t firstBlock = first / blockSize;
+        uint64_t lastBlock = (last - 1) / blockSize;
+        const int16_t* pairs = level->data() + firstBlock * 2;
+        peak = {pairs[0], pairs[1]};
+        MergePeaks(pairs, static_cast<size_t>(lastBlock - firstBlock + 1), peak);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "AudioFormats.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+struct SamplePeak {
+    int16_t min = 0;
+    int16_t max = 0;
+};
+
+// Min/max summaries of a sample at falling resolutions, so a waveform can be
+// drawn at any zoom in time proportional to its width. Level 0 holds one
+// peak per 16 samples, the VADPCM frame grid, and each level above merges
+// kPeakFanOut peaks of the one below. Whole-file overviews read the top
+// levels; closer in, Query falls back to the samples themselves.
+class PeakPyramid {
+public:
+    static constexpr uint32_t kPeakFanOut = 4;
+
+    // Opens a WAV as the encoder would see it (mono 16-bit) and builds from
+    // it. The pyramid keeps the mapping for sample-level queries.
+    bool Open(const std::filesystem::path& path, std::string& error, const std::atomic<bool>* cancel = nullptr);
+    // Builds from samples, which must outlive the pyramid. Returns false
+    // only when cancelled.
+    bool Build(std::span<const int16_t> samples, const std::atomic<bool>* cancel = nullptr);
+
+    // Fills out with one peak per column, the columns splitting samples
+    // [start, end) evenly. Each column reads a bounded number of entries at
+    // any zoom; at coarse zooms columns may take in up to one summary block
+    // past their edges.
+    void Query(uint64_t start, uint64_t end, std::span<SamplePeak> out) const;
+
+    uint64_t GetSampleCount() const {
+        return samples.size();
+    }
+    std::span<const int16_t> GetSamples() const {
+        return samples;
+    }
+    uint32_t GetSampleRate() const {
+        return wav.sampleRate;
+    }
+    size_t GetLevelCount() const {
+        return levels.size();
+    }
+
+private:
+    PcmView wav;
+    std::span<const int16_t> samples;
+    // (min, max) pairs, as PeakBlocksS16 writes them.
+    std::vector<std::vector<int16_t>> levels;
+};
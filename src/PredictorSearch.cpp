@@ -0,0 +1,139 @@
+#include "PredictorSearch.h"
+
+#include "AudioFormats.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <vector>
+
+extern "C" {
+#include "codec/vadpcm.h"
+}
+
+// Candidates encoded at once by a parallel search. Wider waves mostly add
+// memory and candidates past the one that passes.
+static constexpr int kSearchWaveSize = 4;
+
+struct SearchCandidate {
+    VadpcmAifc aifc;
+    double snrDb = 0.0;
+    bool ok = false;
+    std::string error;
+};
+
+void SnrAccumulator::Add(std::span<const int16_t> input, std::span<const int16_t> decoded) {
+    for (size_t i = 0; i < input.size(); i++) {
+        double signal = input[i];
+        double noise = signal - decoded[i];
+        signalEnergy += signal * signal;
+        noiseEnergy += noise * noise;
+    }
+}
+
+double SnrAccumulator::Db() const {
+    if (noiseEnergy == 0.0) {
+        return std::numeric_limits<double>::infinity();
+    }
+    if (signalEnergy == 0.0) {
+        return -std::numeric_limits<double>::infinity();
+    }
+    return 10.0 * std::log10(signalEnergy / noiseEnergy);
+}
+
+static void EncodeCandidate(std::span<const int16_t> samples,
+                            uint32_t sampleRate,
+                            int predictorCount,
+                            SearchCandidate& candidate) {
+    if (!EncodeVadpcm(samples, sampleRate, predictorCount, candidate.aifc, candidate.error)) {
+        return;
+    }
+    std::vector<int16_t> decoded;
+    if (!DecodeVadpcm(candidate.aifc, decoded, candidate.error)) {
+        return;
+    }
+    if (decoded.size() < samples.size()) {
+        candidate.error = "Decoded audio is shorter than the input.";
+        return;
+    }
+    SnrAccumulator snr;
+    snr.Add(samples, decoded);
+    candidate.snrDb = snr.Db();
+    candidate.ok = true;
+}
+
+bool SearchPredictorCount(std::span<const int16_t> samples,
+                          uint32_t sampleRate,
+                          int maxPredictors,
+                          double targetSnrDb,
+                          VadpcmAifc& out,
+                          PredictorChoice& choice,
+                          std::string& error,
+                          const std::atomic<bool>* cancel,
+                          bool parallel) {
+    if (maxPredictors < 1 || maxPredictors > kVADPCMMaxPredictorCount) {
+        error = "Predictor count must be between 1 and 16.";
+        return false;
+    }
+
+    int waveSize = parallel ? std::min(kSearchWaveSize, maxPredictors) : 1;
+    std::optional<ThreadPool> pool;
+    if (waveSize > 1) {
+        pool.emplace(static_cast<size_t>(waveSize));
+    }
+    choice = PredictorChoice{};
+    VadpcmAifc best;
+    for (int first = 1; first <= maxPredictors; first += waveSize) {
+        if (cancel && cancel->load(std::memory_order_relaxed)) {
+            error = "Cancelled.";
+            return false;
+        }
+
+        int count = std::min(waveSize, maxPredictors - first + 1);
+        std::vector<SearchCandidate> wave(static_cast<size_t>(count));
+        // Stage timers only see the calling thread's profile scope, so the
+        // workers are timed from here as one encode stage.
+        {
+            ScopedStageTimer timer(ProfileStage::Encode);
+            if (!pool) {
+                EncodeCandidate(samples, sampleRate, first, wave[0]);
+            } else {
+                for (int i = 0; i < count; i++) {
+                    SearchCandidate* candidate = &wave[static_cast<size_t>(i)];
+                    pool->Submit([samples, sampleRate, first, i, candidate] {
+                        EncodeCandidate(samples, sampleRate, first + i, *candidate);
+                    });
+                }
+                pool->Wait();
+            }
+        }
+
+        choice.candidatesEncoded += count;
+        // Ascending order, so the first passing candidate is the smallest.
+        for (int i = 0; i < count; i++) {
+            SearchCandidate& candidate = wave[static_cast<size_t>(i)];
+            if (!candidate.ok) {
+                error = candidate.error;
+                return false;
+            }
+            if (candidate.snrDb >= targetSnrDb) {
+                out = std::move(candidate.aifc);
+                choice.predictorCount = first + i;
+                choice.snrDb = candidate.snrDb;
+                choice.metTarget = true;
+                return true;
+            }
+            if (choice.predictorCount == 0 || candidate.snrDb > choice.snrDb) {
+                best = std::move(candidate.aifc);
+                choice.predictorCount = first + i;
+                choice.snrDb = candidate.snrDb;
+            }
+        }
+    }
+
+    out = std::move(best);
+    return true;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <span>
+#include <string>
+
+struct VadpcmAifc;
+
+// Outcome of a predictor-count search for one sample.
+struct PredictorChoice {
+    int predictorCount = 0;
+    // Round-trip SNR of the chosen encoding; infinite when lossless.
+    double snrDb = 0.0;
+    // False when no candidate reached the target and the best one was kept.
+    bool metTarget = false;
+    int candidatesEncoded = 0;
+};
+
+// Running signal-to-noise ratio of a decoded stream against its input.
+struct SnrAccumulator {
+    double signalEnergy = 0.0;
+    double noiseEnergy = 0.0;
+
+    // Compares the first input.size() samples of decoded.
+    void Add(std::span<const int16_t> input, std::span<const int16_t> decoded);
+    // In dB; infinite when every sample matched.
+    double Db() const;
+};
+
+// Encodes predictor counts 1..maxPredictors in ascending order and keeps the
+// smallest count whose round-trip SNR reaches targetSnrDb, stopping at the
+// first that passes. When nothing passes, the highest SNR wins. With parallel
+// set, counts are encoded a few at a time on a pool of the search's own;
+// otherwise everything runs on the calling thread, which is what a worker of
+// a batch wants.
+bool SearchPredictorCount(std::span<const int16_t> samples,
+                          uint32_t sampleRate,
+                          int maxPredictors,
+                          double targetSnrDb,
+                          VadpcmAifc& out,
+                          PredictorChoice& choice,
+                          std::string& error,
+                          const std::atomic<bool>* cancel = nullptr,
+                          bool parallel = false);
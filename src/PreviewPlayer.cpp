@@ -0,0 +1,82 @@
+#include "PreviewPlayer.h"
+
+#include <SDL3/SDL.h>
+
+#include <algorithm>
+
+// Samples decoded per step of the callback, about 16 ms at 32 kHz. SDL asks
+// again for whatever one call does not cover.
+static constexpr size_t kFeedBlockSamples = 512;
+
+PreviewPlayer::~PreviewPlayer() {
+    if (stream) {
+        SDL_DestroyAudioStream(stream);
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    }
+}
+
+bool PreviewPlayer::Play(const std::filesystem::path& path, uint32_t sampleRate, std::string& error) {
+    SDL_AudioSpec spec{SDL_AUDIO_S16, 1, static_cast<int>(sampleRate)};
+    if (!stream) {
+        if (!SDL_InitSubSystem(SDL_INIT_AUDIO)) {
+            error = std::string("Audio init failed: ") + SDL_GetError();
+            return false;
+        }
+        stream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, FeedStream, this);
+        if (!stream) {
+            error = std::string("Audio device failed: ") + SDL_GetError();
+            SDL_QuitSubSystem(SDL_INIT_AUDIO);
+            return false;
+        }
+    }
+
+    SDL_LockAudioStream(stream);
+    SDL_ClearAudioStream(stream);
+    bool ok = player.Open(path, error);
+    if (ok) {
+        SDL_SetAudioStreamFormat(stream, &spec, nullptr);
+    }
+    finished = !ok || player.IsFinished();
+    position = 0;
+    SDL_UnlockAudioStream(stream);
+
+    this->path = ok ? path : std::filesystem::path();
+    if (ok) {
+        SDL_ResumeAudioStreamDevice(stream);
+    }
+    return ok;
+}
+
+void PreviewPlayer::Stop() {
+    if (!stream) {
+        return;
+    }
+    SDL_PauseAudioStreamDevice(stream);
+    SDL_LockAudioStream(stream);
+    player.Close();
+    SDL_ClearAudioStream(stream);
+    finished = true;
+    SDL_UnlockAudioStream(stream);
+    path.clear();
+}
+
+bool PreviewPlayer::IsPlaying() const {
+    return stream && (!finished.load(std::memory_order_acquire) || SDL_GetAudioStreamQueued(stream) > 0);
+}
+
+void PreviewPlayer::FeedStream(void* userdata, SDL_AudioStream* stream, int additionalBytes, int /*totalBytes*/) {
+    auto* self = static_cast<PreviewPlayer*>(userdata);
+    int16_t block[kFeedBlockSamples];
+    size_t needed = (static_cast<size_t>(std::max(additionalBytes, 0)) + 1) / sizeof(int16_t);
+    while (needed > 0 && !self->player.IsFinished()) {
+        size_t count = self->player.Read({block, std::min(needed, kFeedBlockSamples)});
+        if (count > 0) {
+            SDL_PutAudioStreamData(stream, block, static_cast<int>(count * sizeof(int16_t)));
+        }
+        needed -= std::min(needed, count);
+    }
+    self->position.store(self->player.GetPosition(), std::memory_order_relaxed);
+    if (self->player.IsFinished()) {
+        self->finished.store(true, std::memory_order_release);
+    }
+}
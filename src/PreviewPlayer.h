@@ -0,0 +1,51 @@
+#pragma once
+
+#include "SamplePlayer.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+struct SDL_AudioStream;
+
+// Plays converted samples through an SDL audio stream. The device is opened
+// on the first Play and kept, so later previews start as soon as the device
+// next asks for data. Decoding runs in SDL's stream callback, one small
+// block at a time, so the stream only ever holds what the device is about to
+// play. Any SDL audio driver works, including dummy and disk, which
+// SDL_AUDIO_DRIVER selects for headless runs. Call from the UI thread only.
+class PreviewPlayer {
+public:
+    PreviewPlayer() = default;
+    // Closes the device; destroy before SDL_Quit.
+    ~PreviewPlayer();
+
+    PreviewPlayer(const PreviewPlayer&) = delete;
+    PreviewPlayer& operator=(const PreviewPlayer&) = delete;
+
+    // Stops whatever is playing and starts the sample at path, which SoH
+    // plays at sampleRate.
+    bool Play(const std::filesystem::path& path, uint32_t sampleRate, std::string& error);
+    void Stop();
+
+    // True until the last sample has been handed to the device.
+    bool IsPlaying() const;
+    const std::filesystem::path& GetPath() const {
+        return path;
+    }
+    // Index in the sample of the most recently decoded block.
+    uint32_t GetPosition() const {
+        return position.load(std::memory_order_relaxed);
+    }
+
+private:
+    static void FeedStream(void* userdata, SDL_AudioStream* stream, int additionalBytes, int totalBytes);
+
+    SDL_AudioStream* stream = nullptr;
+    // Only touched with the stream locked, as the callback runs under it.
+    SamplePlayer player;
+    std::filesystem::path path;
+    std::atomic<bool> finished{true};
+    std::atomic<uint32_t> position{0};
+};
@@ -0,0 +1,156 @@
+#include "Profiler.h"
+
+#include "BinaryWriter.h"
+#include "PathUtils.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+
+const char* ProfileStageName(ProfileStage stage) {
+    switch (stage) {
+        case ProfileStage::Read:
+            return "Read";
+        case ProfileStage::Hash:
+            return "Hash";
+        case ProfileStage::Manifest:
+            return "Manifest";
+        case ProfileStage::Resample:
+            return "Resample";
+        case ProfileStage::Encode:
+            return "Encode";
+        case ProfileStage::Decode:
+            return "Decode";
+        case ProfileStage::Verify:
+            return "Verify";
+        case ProfileStage::Write:
+            return "Write";
+    }
+    return "";
+}
+
+double StageTimings::Total() const {
+    double total = 0.0;
+    for (double value : seconds) {
+        total += value;
+    }
+    return total;
+}
+
+static double Percentile(const std::vector<double>& sorted, double fraction) {
+    // Nearest rank.
+    size_t rank = static_cast<size_t>(fraction * static_cast<double>(sorted.size()) + 0.999999);
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+std::vector<StageSummary> SummarizeTimings(std::span<const StageTimings> timings) {
+    std::vector<StageSummary> summaries;
+    for (size_t index = 0; index < kProfileStageCount; index++) {
+        std::vector<double> values;
+        uint64_t bytes = 0;
+        for (const StageTimings& item : timings) {
+            if (item.seconds[index] > 0.0) {
+                values.push_back(item.seconds[index]);
+                bytes += item.pcmBytes;
+            }
+        }
+        if (values.empty()) {
+            continue;
+        }
+        std::sort(values.begin(), values.end());
+
+        StageSummary summary;
+        summary.stage = static_cast<ProfileStage>(index);
+        summary.count = values.size();
+        for (double value : values) {
+            summary.totalSeconds += value;
+        }
+        summary.p50Seconds = Percentile(values, 0.50);
+        summary.p99Seconds = Percentile(values, 0.99);
+        summary.mbPerSecond = static_cast<double>(bytes) / (1024.0 * 1024.0) / summary.totalSeconds;
+        summaries.push_back(summary);
+    }
+    return summaries;
+}
+
+// Small stable per-thread numbers make for readable trace track names.
+static uint32_t TraceThreadIndex() {
+    static std::atomic<uint32_t> nextIndex{1};
+    thread_local uint32_t index = nextIndex.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+TraceRecorder::TraceRecorder() : origin(ProfileClock::now()) {
+}
+
+void TraceRecorder::AddEvent(const char* name,
+                             const std::string& label,
+                             ProfileClock::time_point start,
+                             ProfileClock::time_point end) {
+    using std::chrono::duration_cast;
+    using std::chrono::microseconds;
+    Event event{name,
+                label,
+                duration_cast<microseconds>(start - origin).count(),
+                duration_cast<microseconds>(end - start).count(),
+                TraceThreadIndex()};
+    std::lock_guard<std::mutex> lock(mutex);
+    events.push_back(std::move(event));
+}
+
+bool TraceRecorder::Write(const std::filesystem::path& path, std::string& error) const {
+    std::string text = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::vector<uint32_t> threads;
+        char numbers[160];
+        for (const Event& event : events) {
+            if (std::find(threads.begin(), threads.end(), event.thread) == threads.end()) {
+                threads.push_back(event.thread);
+            }
+            text += "{\"name\":";
+            AppendJsonString(text, event.name);
+            std::snprintf(numbers, sizeof(numbers),
+                          ",\"cat\":\"convert\",\"ph\":\"X\",\"pid\":1,\"tid\":%" PRIu32 ",\"ts\":%" PRId64
+                          ",\"dur\":%" PRId64 ",\"args\":{\"sample\":",
+                          event.thread, event.startMicros, event.durationMicros);
+            text += numbers;
+            AppendJsonString(text, event.label);
+            text += "}},\n";
+        }
+        std::sort(threads.begin(), threads.end());
+        for (uint32_t thread : threads) {
+            std::snprintf(numbers, sizeof(numbers),
+                          "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%" PRIu32
+                          ",\"args\":{\"name\":\"Worker %" PRIu32 "\"}},\n",
+                          thread, thread);
+            text += numbers;
+        }
+    }
+    text += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"SoH-AudioTool\"}}\n]}\n";
+
+    std::span<const uint8_t> segments[] = {{reinterpret_cast<const uint8_t*>(text.data()), text.size()}};
+    return WriteFileSegments(path, segments, error);
+}
+
+ProfileScope::ProfileScope(StageTimings* timings, TraceRecorder* trace, std::string label)
+    : previous(current), timings(timings), trace(trace), label(std::move(label)), start(ProfileClock::now()) {
+    current = this;
+}
+
+ProfileScope::~ProfileScope() {
+    if (trace) {
+        trace->AddEvent("ConvertSample", label, start, ProfileClock::now());
+    }
+    current = previous;
+}
+
+void ProfileScope::Record(ProfileStage stage, ProfileClock::time_point stageStart, ProfileClock::time_point stageEnd) {
+    if (timings) {
+        timings->seconds[static_cast<size_t>(stage)] += std::chrono::duration<double>(stageEnd - stageStart).count();
+    }
+    if (trace) {
+        trace->AddEvent(ProfileStageName(stage), label, stageStart, stageEnd);
+    }
+}
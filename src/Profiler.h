@@ -0,0 +1,126 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+enum class ProfileStage : uint8_t {
+    Read,
+    Hash,
+    Manifest,
+    Resample,
+    Encode,
+    Decode,
+    Verify,
+    Write,
+};
+
+constexpr size_t kProfileStageCount = 8;
+
+const char* ProfileStageName(ProfileStage stage);
+
+using ProfileClock = std::chrono::steady_clock;
+
+// Time one conversion spent in each stage.
+struct StageTimings {
+    std::array<double, kProfileStageCount> seconds{};
+    uint64_t pcmBytes = 0;
+    // Working buffers the conversion had to allocate or grow; zero once a
+    // worker's buffers fit its inputs. See ConvertBuffers.
+    uint32_t bufferAllocations = 0;
+
+    double Total() const;
+};
+
+struct StageSummary {
+    ProfileStage stage = ProfileStage::Read;
+    size_t count = 0;
+    double totalSeconds = 0.0;
+    double p50Seconds = 0.0;
+    double p99Seconds = 0.0;
+    // PCM bytes of the conversions that ran this stage over the time spent in it.
+    double mbPerSecond = 0.0;
+};
+
+// Per-stage totals and percentiles over conversions that ran each stage.
+std::vector<StageSummary> SummarizeTimings(std::span<const StageTimings> timings);
+
+// Chrome trace-event recorder (chrome://tracing, Perfetto). Events from all
+// threads go into one list; each thread becomes its own track.
+class TraceRecorder {
+public:
+    TraceRecorder();
+
+    void AddEvent(const char* name, const std::string& label, ProfileClock::time_point start, ProfileClock::time_point end);
+    bool Write(const std::filesystem::path& path, std::string& error) const;
+
+private:
+    struct Event {
+        const char* name;
+        std::string label;
+        int64_t startMicros;
+        int64_t durationMicros;
+        uint32_t thread;
+    };
+
+    ProfileClock::time_point origin;
+    mutable std::mutex mutex;
+    std::vector<Event> events;
+};
+
+// Installs itself as the current thread's profile target for its lifetime.
+// ScopedStageTimers on this thread add to timings and, when a recorder is
+// given, emit one trace event each; the scope itself emits one event
+// spanning the whole conversion, named after label.
+class ProfileScope {
+public:
+    ProfileScope(StageTimings* timings, TraceRecorder* trace, std::string label);
+    ~ProfileScope();
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+    static ProfileScope* Current() {
+        return current;
+    }
+    void Record(ProfileStage stage, ProfileClock::time_point start, ProfileClock::time_point end);
+
+private:
+    inline static thread_local constinit ProfileScope* current = nullptr;
+
+    ProfileScope* previous = nullptr;
+    StageTimings* timings = nullptr;
+    TraceRecorder* trace = nullptr;
+    std::string label;
+    ProfileClock::time_point start;
+};
+
+// Times the enclosing block as one stage. Without a ProfileScope on the
+// thread it reads no clock and records nothing.
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(ProfileStage stage) : stage(stage), scope(ProfileScope::Current()) {
+        if (scope) {
+            start = ProfileClock::now();
+        }
+    }
+    ~ScopedStageTimer() {
+        if (scope) {
+            scope->Record(stage, start, ProfileClock::now());
+        }
+    }
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+private:
+    ProfileStage stage;
+    ProfileScope* scope;
+    ProfileClock::time_point start;
+};
@@ -0,0 +1,223 @@
+#include "QualityReport.h"
+
+#include "AudioFormats.h"
+#include "BinaryWriter.h"
+#include "O2rArchive.h"
+#include "PathUtils.h"
+#include "PcmKernels.h"
+#include "PredictorSearch.h"
+#include "Resampler.h"
+#include "SohSampleWriter.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+
+// Archive entries are read into resource, which the view then points into.
+static bool ReadOutput(const ConvertJob& job,
+                       const std::filesystem::path& outputDir,
+                       const O2rArchive* archive,
+                       std::vector<uint8_t>& resource,
+                       SohSampleView& sample,
+                       std::string& error) {
+    if (archive) {
+        return archive->ReadEntry(archive->ResourcePath(job.outputName), resource, error) &&
+               ReadSohSample(resource, sample, error);
+    }
+    return OpenSohSampleView(outputDir / Utf8ToPath(job.outputName), sample, error);
+}
+
+SampleQuality MeasureSampleQuality(const ConvertJob& job,
+                                   const std::filesystem::path& outputDir,
+                                   const O2rArchive* archive) {
+    SampleQuality quality;
+    quality.inputPath = job.inputPath;
+    quality.outputName = job.outputName;
+
+    PcmView source;
+    std::vector<uint8_t> resource;
+    SohSampleView sample;
+    if (!OpenWavView(job.inputPath, source, quality.error) ||
+        !ReadOutput(job, outputDir, archive, resource, sample, quality.error)) {
+        return quality;
+    }
+
+    // Resampled jobs are compared with the resampled source, so only the
+    // codec's error is measured.
+    std::span<const int16_t> reference = source.samples;
+    std::vector<int16_t> resampled;
+    if (job.targetSampleRate != 0 && job.targetSampleRate != source.sampleRate) {
+        if (!ResamplePcm(source.samples, source.sampleRate, job.targetSampleRate, resampled, quality.error)) {
+            return quality;
+        }
+        reference = resampled;
+    }
+
+    std::vector<int16_t> decoded;
+    if (!DecodeVadpcmFrames(sample.adpcmData, sample.order, sample.predictors, sample.book, SIZE_MAX, decoded,
+                            quality.error)) {
+        return quality;
+    }
+    if (decoded.size() < reference.size()) {
+        quality.error = "Decoded audio is shorter than the input.";
+        return quality;
+    }
+
+    PcmErrorSums sums;
+    AccumulatePcmError(reference.data(), decoded.data(), reference.size(), sums);
+    SnrAccumulator snr{static_cast<double>(sums.signalEnergy), static_cast<double>(sums.noiseEnergy)};
+    quality.sampleCount = sums.sampleCount;
+    quality.snrDb = snr.Db();
+    quality.peakError = sums.peakError;
+    quality.clippedSamples = sums.clippedSamples;
+    quality.dcOffset = sums.sampleCount ? static_cast<double>(sums.errorSum) / static_cast<double>(sums.sampleCount) : 0.0;
+    quality.ok = true;
+    return quality;
+}
+
+std::vector<SampleQuality> MeasureQuality(std::span<const ConvertJob> jobs,
+                                          const std::filesystem::path& outputDir,
+                                          const O2rArchive* archive,
+                                          size_t threadCount,
+                                          const std::atomic<bool>* cancel) {
+    std::vector<SampleQuality> results(jobs.size());
+    if (jobs.empty()) {
+        return results;
+    }
+    ThreadPool pool(std::min(threadCount == 0 ? ThreadPool::DefaultThreadCount() : threadCount, jobs.size()));
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const ConvertJob* job = &jobs[i];
+        SampleQuality* result = &results[i];
+        pool.Submit([job, result, &outputDir, archive, cancel] {
+            if (cancel && cancel->load(std::memory_order_relaxed)) {
+                result->inputPath = job->inputPath;
+                result->outputName = job->outputName;
+                result->error = "Cancelled.";
+                return;
+            }
+            *result = MeasureSampleQuality(*job, outputDir, archive);
+        });
+    }
+    pool.Wait();
+    return results;
+}
+
+void SortQuality(std::vector<SampleQuality>& results, QualitySortKey key, bool reverse) {
+    // Larger is worse.
+    auto badness = [key](const SampleQuality& item) -> double {
+        switch (key) {
+            case QualitySortKey::Snr:
+                return -item.snrDb;
+            case QualitySortKey::PeakError:
+                return item.peakError;
+            case QualitySortKey::Clipping:
+                return static_cast<double>(item.clippedSamples);
+            case QualitySortKey::DcOffset:
+                return std::abs(item.dcOffset);
+            case QualitySortKey::Name:
+                break;
+        }
+        return 0.0;
+    };
+    std::stable_sort(results.begin(), results.end(), [&](const SampleQuality& a, const SampleQuality& b) {
+        if (a.ok != b.ok) {
+            return !a.ok;
+        }
+        const SampleQuality& first = reverse ? b : a;
+        const SampleQuality& second = reverse ? a : b;
+        if (key == QualitySortKey::Name) {
+            return first.outputName < second.outputName;
+        }
+        return badness(first) > badness(second);
+    });
+}
+
+static bool EndsWithJson(const std::filesystem::path& path) {
+    std::string extension = PathToUtf8(path.extension());
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+    return extension == ".json";
+}
+
+static void AppendCsvField(std::string& out, const std::string& text) {
+    if (text.find_first_of(",\"\r\n") == std::string::npos) {
+        out += text;
+        return;
+    }
+    out += '"';
+    for (char ch : text) {
+        if (ch == '"') {
+            out += '"';
+        }
+        out += ch;
+    }
+    out += '"';
+}
+
+// JSON has no infinities, so there both become null.
+static std::string FormatSnr(double snrDb, bool json) {
+    if (std::isinf(snrDb)) {
+        return json ? "null" : snrDb > 0 ? "inf" : "-inf";
+    }
+    char text[32];
+    std::snprintf(text, sizeof(text), "%.3f", snrDb);
+    return text;
+}
+
+static std::string BuildCsv(std::span<const SampleQuality> results) {
+    std::string text = "input,output,status,samples,snr_db,peak_error,clipped,dc_offset\n";
+    char numbers[128];
+    for (const SampleQuality& item : results) {
+        AppendCsvField(text, PathToUtf8(item.inputPath));
+        text += ',';
+        AppendCsvField(text, item.outputName);
+        text += ',';
+        if (!item.ok) {
+            AppendCsvField(text, item.error);
+            text += ",,,,,\n";
+            continue;
+        }
+        std::snprintf(numbers, sizeof(numbers), "ok,%" PRIu64 ",%s,%" PRIu32 ",%" PRIu64 ",%.4f\n", item.sampleCount,
+                      FormatSnr(item.snrDb, false).c_str(), item.peakError, item.clippedSamples, item.dcOffset);
+        text += numbers;
+    }
+    return text;
+}
+
+static std::string BuildJson(std::span<const SampleQuality> results) {
+    std::string text = "[\n";
+    char numbers[160];
+    for (size_t i = 0; i < results.size(); i++) {
+        const SampleQuality& item = results[i];
+        text += "{\"input\":";
+        AppendJsonString(text, PathToUtf8(item.inputPath));
+        text += ",\"output\":";
+        AppendJsonString(text, item.outputName);
+        if (item.ok) {
+            std::snprintf(numbers, sizeof(numbers),
+                          ",\"ok\":true,\"samples\":%" PRIu64 ",\"snrDb\":%s,\"peakError\":%" PRIu32
+                          ",\"clipped\":%" PRIu64 ",\"dcOffset\":%.4f}",
+                          item.sampleCount, FormatSnr(item.snrDb, true).c_str(), item.peakError,
+                          item.clippedSamples, item.dcOffset);
+            text += numbers;
+        } else {
+            text += ",\"ok\":false,\"error\":";
+            AppendJsonString(text, item.error);
+            text += '}';
+        }
+        text += i + 1 < results.size() ? ",\n" : "\n";
+    }
+    text += "]\n";
+    return text;
+}
+
+bool WriteQualityReport(const std::filesystem::path& path,
+                        std::span<const SampleQuality> results,
+                        std::string& error) {
+    std::string text = EndsWithJson(path) ? BuildJson(results) : BuildCsv(results);
+    std::span<const uint8_t> segments[] = {{reinterpret_cast<const uint8_t*>(text.data()), text.size()}};
+    return WriteFileSegments(path, segments, error);
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "Convert.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+class O2rArchive;
+
+// Round-trip quality of one converted sample against its source WAV.
+struct SampleQuality {
+    std::filesystem::path inputPath;
+    std::string outputName;
+    bool ok = false;
+    std::string error;
+    uint64_t sampleCount = 0;
+    // Infinite when every sample decoded exactly.
+    double snrDb = 0.0;
+    // Largest absolute difference from the source, in sample units.
+    uint32_t peakError = 0;
+    // Decoded samples at full scale, where the decoder clamped or the source
+    // was already clipping.
+    uint64_t clippedSamples = 0;
+    // Mean of decoded minus source.
+    double dcOffset = 0.0;
+};
+
+enum class QualitySortKey : uint8_t {
+    Snr,
+    PeakError,
+    Clipping,
+    DcOffset,
+    Name,
+};
+
+// Decodes the output of a finished job with the reference decoder and
+// compares it with the job's input, resampled first when the job asks for
+// a target rate. The output is read from outputDir, or
+// from archive when set; the archive must have been finished.
+SampleQuality MeasureSampleQuality(const ConvertJob& job,
+                                   const std::filesystem::path& outputDir,
+                                   const O2rArchive* archive);
+
+// Measures every job on a worker pool. Results are in job order.
+// threadCount == 0 uses one thread per hardware core.
+std::vector<SampleQuality> MeasureQuality(std::span<const ConvertJob> jobs,
+                                          const std::filesystem::path& outputDir,
+                                          const O2rArchive* archive,
+                                          size_t threadCount = 0,
+                                          const std::atomic<bool>* cancel = nullptr);
+
+// Worst first for every key except Name, which sorts by output name; reverse
+// flips that. Failed measurements always come first.
+void SortQuality(std::vector<SampleQuality>& results, QualitySortKey key, bool reverse = false);
+
+// JSON when the path ends in .json, CSV otherwise.
+bool WriteQualityReport(const std::filesystem::path& path,
+                        std::span<const SampleQuality> results,
+                        std::string& error);
@@ -0,0 +1,157 @@
+#include "Resampler.h"
+
+#include "PcmKernels.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <utility>
+
+// Sinc lobes on each side of the centre tap. With the Kaiser window below
+// the stopband sits around -90 dB.
+static constexpr double kZeroCrossings = 16.0;
+static constexpr double kKaiserBeta = 9.0;
+// Passband edge as a fraction of the lower Nyquist rate.
+static constexpr double kRolloff = 0.95;
+// Ratios with more phases than this (e.g. 44101 -> 32000) blend the two
+// nearest rows instead of getting an exact row per phase.
+static constexpr uint32_t kMaxPhases = 1024;
+static constexpr uint32_t kMaxRate = 768000;
+
+static constexpr double kPi = 3.14159265358979323846;
+
+// Zeroth-order modified Bessel function of the first kind, by its series.
+static double BesselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    double quarterSquare = x * x / 4.0;
+    for (int k = 1; k < 64 && term > sum * 1e-12; k++) {
+        term *= quarterSquare / (static_cast<double>(k) * static_cast<double>(k));
+        sum += term;
+    }
+    return sum;
+}
+
+static std::shared_ptr<const ResampleFilter> BuildFilter(uint32_t upFactor, uint32_t downFactor) {
+    auto filter = std::make_shared<ResampleFilter>();
+    filter->upFactor = upFactor;
+    filter->downFactor = downFactor;
+    filter->interpolatePhases = upFactor > kMaxPhases;
+    filter->phaseCount = filter->interpolatePhases ? kMaxPhases : upFactor;
+
+    // Cutoff in cycles per input sample, times two; downsampling narrows it
+    // to the output's Nyquist rate and widens the filter to match.
+    double cutoff = kRolloff * std::min(1.0, static_cast<double>(upFactor) / static_cast<double>(downFactor));
+    double halfWidth = kZeroCrossings / cutoff;
+    uint32_t tapCount = static_cast<uint32_t>(std::ceil(halfWidth)) * 2;
+    tapCount = (tapCount + 7) / 8 * 8;
+    filter->tapCount = tapCount;
+
+    double windowScale = 1.0 / BesselI0(kKaiserBeta);
+    filter->taps.resize(static_cast<size_t>(filter->phaseCount + 1) * tapCount);
+    std::vector<double> row(tapCount);
+    for (uint32_t phase = 0; phase <= filter->phaseCount; phase++) {
+        double fraction = static_cast<double>(phase) / static_cast<double>(filter->phaseCount);
+        double sum = 0.0;
+        for (uint32_t k = 0; k < tapCount; k++) {
+            // Tap k weighs input sample floor(position) - tapCount / 2 + 1 + k.
+            double x = static_cast<double>(k) - static_cast<double>(tapCount / 2) + 1.0 - fraction;
+            double ratio = x / halfWidth;
+            if (std::abs(ratio) >= 1.0) {
+                row[k] = 0.0;
+                continue;
+            }
+            double arg = kPi * cutoff * x;
+            double sinc = arg == 0.0 ? 1.0 : std::sin(arg) / arg;
+            double window = BesselI0(kKaiserBeta * std::sqrt(1.0 - ratio * ratio)) * windowScale;
+            row[k] = sinc * window;
+            sum += row[k];
+        }
+        // Unity gain at DC for every phase.
+        float* taps = filter->taps.data() + static_cast<size_t>(phase) * tapCount;
+        for (uint32_t k = 0; k < tapCount; k++) {
+            taps[k] = static_cast<float>(row[k] / sum);
+        }
+    }
+    return filter;
+}
+
+std::shared_ptr<const ResampleFilter> GetResampleFilter(uint32_t inputRate, uint32_t outputRate) {
+    static std::mutex mutex;
+    static std::map<std::pair<uint32_t, uint32_t>, std::shared_ptr<const ResampleFilter>> filters;
+
+    uint32_t divisor = std::gcd(inputRate, outputRate);
+    std::pair<uint32_t, uint32_t> key(outputRate / divisor, inputRate / divisor);
+    std::lock_guard<std::mutex> lock(mutex);
+    auto& filter = filters[key];
+    if (!filter) {
+        filter = BuildFilter(key.first, key.second);
+    }
+    return filter;
+}
+
+size_t ResampledLength(size_t count, uint32_t inputRate, uint32_t outputRate) {
+    return static_cast<size_t>((static_cast<uint64_t>(count) * outputRate + inputRate - 1) / inputRate);
+}
+
+uint32_t ResamplePosition(uint32_t position, uint32_t inputRate, uint32_t outputRate) {
+    return static_cast<uint32_t>((static_cast<uint64_t>(position) * outputRate + inputRate / 2) / inputRate);
+}
+
+bool ResamplePcm(std::span<const int16_t> input,
+                 uint32_t inputRate,
+                 uint32_t outputRate,
+                 std::vector<int16_t>& output,
+                 std::string& error,
+                 std::vector<float>* work) {
+    if (inputRate == 0 || outputRate == 0 || inputRate > kMaxRate || outputRate > kMaxRate) {
+        error = "Sample rates must be between 1 and " + std::to_string(kMaxRate) + " Hz.";
+        return false;
+    }
+    if (inputRate == outputRate) {
+        output.assign(input.begin(), input.end());
+        return true;
+    }
+
+    std::shared_ptr<const ResampleFilter> filter = GetResampleFilter(inputRate, outputRate);
+    size_t tapCount = filter->tapCount;
+    // tapCount / 2 zeros ahead of the input so the first window starts at
+    // index 0, and a full window of zeros after it.
+    // The resampled floats follow the padded input in one buffer.
+    size_t lead = tapCount / 2;
+    size_t paddedCount = lead + input.size() + tapCount;
+    size_t outputCount = ResampledLength(input.size(), inputRate, outputRate);
+    std::vector<float> localWork;
+    std::vector<float>& buffer = work ? *work : localWork;
+    buffer.assign(paddedCount + outputCount, 0.0f);
+    float* padded = buffer.data();
+    float* resampled = padded + paddedCount;
+    WidenS16ToF32(input.data(), padded + lead, input.size());
+    uint64_t up = filter->upFactor;
+    uint64_t down = filter->downFactor;
+    const float* taps = filter->taps.data();
+    for (size_t n = 0; n < outputCount; n++) {
+        uint64_t position = static_cast<uint64_t>(n) * down;
+        const float* window = padded + position / up + 1;
+        uint64_t remainder = position % up;
+        if (!filter->interpolatePhases) {
+            resampled[n] = DotF32(taps + remainder * tapCount, window, tapCount);
+            continue;
+        }
+        double scaled = static_cast<double>(remainder) * filter->phaseCount / static_cast<double>(up);
+        size_t phase = static_cast<size_t>(scaled);
+        float blend = static_cast<float>(scaled - static_cast<double>(phase));
+        float value = DotF32(taps + phase * tapCount, window, tapCount);
+        if (blend > 0.0f) {
+            float next = DotF32(taps + (phase + 1) * tapCount, window, tapCount);
+            value += blend * (next - value);
+        }
+        resampled[n] = value;
+    }
+
+    output.resize(outputCount);
+    NarrowF32ToS16(resampled, output.data(), outputCount);
+    return true;
+}
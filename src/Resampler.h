@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+// Windowed-sinc filter bank for one rate ratio. Row p holds the taps for an
+// output that falls p / phaseCount of the way between two input samples.
+struct ResampleFilter {
+    // Reduced ratio: upFactor outputs for every downFactor inputs.
+    uint32_t upFactor = 1;
+    uint32_t downFactor = 1;
+    uint32_t phaseCount = 1;
+    // A multiple of 8, centred on the output position.
+    uint32_t tapCount = 0;
+    // True when the ratio has more phases than the table; outputs then blend
+    // the two nearest rows.
+    bool interpolatePhases = false;
+    // (phaseCount + 1) rows of tapCount taps.
+    std::vector<float> taps;
+};
+
+// Built on first use for each ratio and shared after that. Safe to call from
+// several threads at once.
+std::shared_ptr<const ResampleFilter> GetResampleFilter(uint32_t inputRate, uint32_t outputRate);
+
+// Number of samples ResamplePcm produces for count inputs.
+size_t ResampledLength(size_t count, uint32_t inputRate, uint32_t outputRate);
+// Maps an input sample index to the nearest output index, e.g. for loop
+// points.
+uint32_t ResamplePosition(uint32_t position, uint32_t inputRate, uint32_t outputRate);
+
+// Converts mono PCM from inputRate to outputRate. The signal is band-limited
+// to the lower of the two Nyquist rates first, so downsampling does not
+// alias. The float intermediates go into work when given, so callers
+// resampling many inputs can keep one buffer.
+bool ResamplePcm(std::span<const int16_t> input,
+                 uint32_t inputRate,
+                 uint32_t outputRate,
+                 std::vector<int16_t>& output,
+                 std::string& error,
+                 std::vector<float>* work = nullptr);
@@ -0,0 +1,73 @@
+#include "SampleExport.h"
+
+#include "AudioFormats.h"
+#include "PathUtils.h"
+#include "SohSampleWriter.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <system_error>
+
+bool ExportSohSample(const std::filesystem::path& input,
+                     const std::filesystem::path& output,
+                     uint32_t sampleRate,
+                     std::string& error) {
+    SohSampleView sample;
+    if (!OpenSohSampleView(input, sample, error)) {
+        return false;
+    }
+
+    WavData wav;
+    wav.sampleRate = sampleRate;
+    if (!DecodeVadpcmFrames(sample.adpcmData, sample.order, sample.predictors, sample.book, SIZE_MAX, wav.samples,
+                            error)) {
+        return false;
+    }
+    if (sample.loopEnabled) {
+        wav.hasLoop = true;
+        wav.loopStart = sample.loopStart;
+        wav.loopEnd = sample.loopEnd;
+        // The resource stores the count as unsigned; all bits set is forever.
+        wav.loopCount = sample.loopCount;
+    } else if (wav.samples.size() > sample.sampleCount) {
+        wav.samples.resize(sample.sampleCount);
+    }
+    if (wav.samples.empty()) {
+        error = "Sample has no audio.";
+        return false;
+    }
+    return WriteWavFile(output, wav, error);
+}
+
+std::vector<ExportResult> ExportSamples(std::span<const ExportJob> jobs,
+                                        const std::filesystem::path& outputDir,
+                                        uint32_t sampleRate,
+                                        size_t threadCount,
+                                        const std::atomic<bool>* cancel) {
+    std::vector<ExportResult> results(jobs.size());
+    if (jobs.empty()) {
+        return results;
+    }
+    ThreadPool pool(std::min(threadCount == 0 ? ThreadPool::DefaultThreadCount() : threadCount, jobs.size()));
+    for (size_t i = 0; i < jobs.size(); i++) {
+        const ExportJob* job = &jobs[i];
+        ExportResult* result = &results[i];
+        pool.Submit([job, result, &outputDir, sampleRate, cancel] {
+            result->inputPath = job->inputPath;
+            result->outputName = job->outputName;
+            if (cancel && cancel->load(std::memory_order_relaxed)) {
+                result->error = "Cancelled.";
+                return;
+            }
+            // Several workers may race to create the same folder; only the
+            // final state matters.
+            std::filesystem::path outPath = outputDir / Utf8ToPath(job->outputName + ".wav");
+            std::error_code ec;
+            std::filesystem::create_directories(outPath.parent_path(), ec);
+            result->ok = ExportSohSample(job->inputPath, outPath, sampleRate, result->error);
+        });
+    }
+    pool.Wait();
+    return results;
+}
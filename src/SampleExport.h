@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+// One SoH sample to decode back to a WAV.
+struct ExportJob {
+    std::filesystem::path inputPath;
+    // Output path below the export folder, without the .wav extension.
+    std::string outputName;
+};
+
+struct ExportResult {
+    std::filesystem::path inputPath;
+    std::string outputName;
+    bool ok = false;
+    std::string error;
+};
+
+// SoH samples do not store a playback rate, so the caller picks one.
+constexpr uint32_t kDefaultExportRate = 32000;
+
+// Decodes a SoH sample file to a 16-bit mono WAV. Loop points go into a smpl
+// chunk. A looping sample keeps every decoded frame, since its loop may run
+// to the end of the padded last frame; others are cut to their length.
+bool ExportSohSample(const std::filesystem::path& input,
+                     const std::filesystem::path& output,
+                     uint32_t sampleRate,
+                     std::string& error);
+
+// Exports every job into outputDir on a worker pool, creating subfolders as
+// needed. Results are in job order. threadCount == 0 uses one thread per
+// hardware core.
+std::vector<ExportResult> ExportSamples(std::span<const ExportJob> jobs,
+                                        const std::filesystem::path& outputDir,
+                                        uint32_t sampleRate,
+                                        size_t threadCount = 0,
+                                        const std::atomic<bool>* cancel = nullptr);
@@ -0,0 +1,111 @@
+#include "SamplePlayer.h"
+
+#include <algorithm>
+#include <cstring>
+
+extern "C" {
+#include "codec/vadpcm.h"
+}
+
+// The codec works on 8-sample vectors; the player keeps them as plain arrays
+// so its header does not need the codec's.
+static_assert(sizeof(vadpcm_vector) == 8 * sizeof(int16_t));
+static_assert(alignof(vadpcm_vector) <= alignof(int16_t));
+
+bool SamplePlayer::Open(const std::filesystem::path& path, std::string& error) {
+    Close();
+    if (!OpenSohSampleView(path, sample, error)) {
+        return false;
+    }
+    if (sample.order <= 0 || sample.predictors <= 0 || sample.order > kVADPCMMaxOrder ||
+        sample.predictors > kVADPCMMaxPredictorCount) {
+        error = "Invalid VADPCM codebook.";
+        return false;
+    }
+    size_t bookSize = static_cast<size_t>(sample.order) * static_cast<size_t>(sample.predictors) * 8;
+    if (sample.book.size() < bookSize) {
+        error = "VADPCM codebook is incomplete.";
+        return false;
+    }
+    std::copy_n(sample.book.begin(), bookSize, codebook.begin());
+
+    uint64_t frameSampleCount =
+        static_cast<uint64_t>(sample.adpcmData.size() / kVADPCMFrameByteSize) * kVADPCMFrameSampleCount;
+    endPosition = static_cast<uint32_t>(std::min<uint64_t>(frameSampleCount, UINT32_MAX));
+    if (!sample.loopEnabled) {
+        endPosition = std::min(endPosition, sample.sampleCount);
+    } else if (sample.loopStart > sample.loopEnd || sample.loopEnd >= endPosition) {
+        error = "Sample loop is outside its audio.";
+        return false;
+    }
+
+    state = {};
+    decodedFrame = SIZE_MAX;
+    position = 0;
+    loopsLeft = sample.loopEnabled ? sample.loopCount : 0;
+    playedCount = 0;
+    open = true;
+    finished = endPosition == 0;
+    return true;
+}
+
+void SamplePlayer::Close() {
+    sample = SohSampleView{};
+    open = false;
+    finished = true;
+}
+
+bool SamplePlayer::DecodeFrame(size_t frame) {
+    // Only sequential frames and loop restarts are decoded, so the running
+    // state is always the one this frame needs.
+    vadpcm_error err = vadpcm_decode(sample.predictors, sample.order,
+                                     reinterpret_cast<const vadpcm_vector*>(codebook.data()),
+                                     reinterpret_cast<vadpcm_vector*>(state.data()), 1, frameSamples.data(),
+                                     sample.adpcmData.data() + frame * kVADPCMFrameByteSize);
+    decodedFrame = frame;
+    return err == kVADPCMErrNone;
+}
+
+bool SamplePlayer::RestartLoop() {
+    // As on the console: the decoder resumes from the saved state, which
+    // holds the samples just before loopStart, at the frame containing it.
+    std::copy(sample.loopState.end() - state.size(), sample.loopState.end(), state.begin());
+    position = sample.loopStart;
+    if (loopsLeft > 0) {
+        loopsLeft--;
+    }
+    return DecodeFrame(sample.loopStart / kVADPCMFrameSampleCount);
+}
+
+size_t SamplePlayer::Read(std::span<int16_t> out) {
+    size_t written = 0;
+    while (written < out.size() && !finished) {
+        // A frame that fails to decode (a predictor past the codebook) ends
+        // playback rather than playing stale samples.
+        if (loopsLeft != 0 && position > sample.loopEnd && !RestartLoop()) {
+            finished = true;
+            break;
+        }
+        if (position >= endPosition) {
+            finished = true;
+            break;
+        }
+
+        size_t frame = position / kVADPCMFrameSampleCount;
+        if (frame != decodedFrame && !DecodeFrame(frame)) {
+            finished = true;
+            break;
+        }
+        uint32_t limit = std::min<uint32_t>(static_cast<uint32_t>((frame + 1) * kVADPCMFrameSampleCount), endPosition);
+        if (loopsLeft != 0) {
+            limit = std::min(limit, sample.loopEnd + 1);
+        }
+        size_t count = std::min<size_t>(limit - position, out.size() - written);
+        std::memcpy(out.data() + written, frameSamples.data() + position % kVADPCMFrameSampleCount,
+                    count * sizeof(int16_t));
+        position += static_cast<uint32_t>(count);
+        written += count;
+        playedCount += count;
+    }
+    return written;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "SohSampleWriter.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+
+// Plays a converted sample back the way the game walks it. Frames are decoded
+// one at a time as Read asks for them, so opening a sample costs the same
+// for a one-second effect as for a multi-minute track, and memory does not
+// grow with its length. A looping sample plays through loopEnd, restarts at
+// loopStart from the stored loop state, and once loopCount passes are done
+// (never for -1) runs on to the end. Not thread-safe; an audio callback and
+// the thread that opens samples must serialize their calls.
+class SamplePlayer {
+public:
+    bool Open(const std::filesystem::path& path, std::string& error);
+    void Close();
+
+    // Fills out with the next samples and returns how many were written,
+    // fewer than out.size() only once playback has finished.
+    size_t Read(std::span<int16_t> out);
+
+    bool IsOpen() const {
+        return open;
+    }
+    bool IsFinished() const {
+        return finished;
+    }
+    // Index in the sample of the next sample Read returns.
+    uint32_t GetPosition() const {
+        return position;
+    }
+    // Samples returned so far, repeats included.
+    uint64_t GetPlayedCount() const {
+        return playedCount;
+    }
+    const SohSampleView& GetSample() const {
+        return sample;
+    }
+
+private:
+    bool DecodeFrame(size_t frame);
+    bool RestartLoop();
+
+    SohSampleView sample;
+    // Room for the largest codebook, 16 predictors of order 8.
+    std::array<int16_t, 16 * 8 * 8> codebook{};
+    std::array<int16_t, 8> state{};
+    std::array<int16_t, 16> frameSamples{};
+    size_t decodedFrame = SIZE_MAX;
+    uint32_t position = 0;
+    uint32_t endPosition = 0;
+    // Loop restarts still to come; -1 loops forever.
+    int32_t loopsLeft = 0;
+    uint64_t playedCount = 0;
+    bool open = false;
+    bool finished = true;
+};
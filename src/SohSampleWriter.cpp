@@ -1,110 +1,177 @@
 #include "SohSampleWriter.h"
 
-#include <fstream>
+#include "BinaryWriter.h"
 
-static void WriteU8(std::ostream& out, uint8_t value) {
-    out.put(static_cast<char>(value));
-}
+#include <span>
 
-static void WriteU16LE(std::ostream& out, uint16_t value) {
-    uint8_t bytes[2] = {
-        static_cast<uint8_t>(value & 0xFF),
-        static_cast<uint8_t>((value >> 8) & 0xFF),
-    };
-    out.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+extern "C" {
+#include "codec/vadpcm.h"
 }
 
-static void WriteU32LE(std::ostream& out, uint32_t value) {
-    uint8_t bytes[4] = {
-        static_cast<uint8_t>(value & 0xFF),
-        static_cast<uint8_t>((value >> 8) & 0xFF),
-        static_cast<uint8_t>((value >> 16) & 0xFF),
-        static_cast<uint8_t>((value >> 24) & 0xFF),
-    };
-    out.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
-}
+static constexpr uint32_t kResTypeAudioSample = 0x4F534D50; // OSMP
+static constexpr size_t kHeaderSize = 0x40;
+static constexpr size_t kPrefixSize = kHeaderSize + 4 + 4;
 
-static void WriteU64LE(std::ostream& out, uint64_t value) {
-    uint8_t bytes[8] = {
-        static_cast<uint8_t>(value & 0xFF),
-        static_cast<uint8_t>((value >> 8) & 0xFF),
-        static_cast<uint8_t>((value >> 16) & 0xFF),
-        static_cast<uint8_t>((value >> 24) & 0xFF),
-        static_cast<uint8_t>((value >> 32) & 0xFF),
-        static_cast<uint8_t>((value >> 40) & 0xFF),
-        static_cast<uint8_t>((value >> 48) & 0xFF),
-        static_cast<uint8_t>((value >> 56) & 0xFF),
-    };
-    out.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+static size_t SuffixSize(const SohSampleData& sample) {
+    size_t loopBlock = sample.loopEnabled ? 16 + sample.loopState.size() * 2 : 16;
+    return loopBlock + 12 + sample.book.size() * 2;
 }
 
-static void WriteHeader(std::ostream& out) {
-    constexpr uint32_t kResTypeAudioSample = 0x4F534D50; // OSMP
+static void PutHeader(BinaryWriter& out) {
     constexpr uint32_t kResVersion = 2;
     constexpr uint64_t kResId = 0xDEADBEEFDEADBEEFULL;
 
-    WriteU8(out, 0);
-    WriteU8(out, 0);
-    WriteU8(out, 0);
-    WriteU8(out, 0);
+    size_t start = out.GetSize();
+    out.PutU8(0);
+    out.PutU8(0);
+    out.PutU8(0);
+    out.PutU8(0);
 
-    WriteU32LE(out, kResTypeAudioSample);
-    WriteU32LE(out, kResVersion);
-    WriteU64LE(out, kResId);
-    WriteU32LE(out, 0);
-    WriteU64LE(out, 0);
-    WriteU32LE(out, 0);
+    out.PutU32LE(kResTypeAudioSample);
+    out.PutU32LE(kResVersion);
+    out.PutU64LE(kResId);
+    out.PutU32LE(0);
+    out.PutU64LE(0);
+    out.PutU32LE(0);
 
-    while (out.tellp() < 0x40) {
-        WriteU32LE(out, 0);
-    }
+    out.PadTo(start + kHeaderSize);
 }
 
-bool WriteSohSample(const std::filesystem::path& path, const SohSampleData& sample, std::string& error) {
-    std::ofstream out(path, std::ios::binary);
-    if (!out) {
-        error = "Failed to open output file.";
-        return false;
-    }
+size_t SohSampleSize(const SohSampleData& sample) {
+    return kPrefixSize + sample.adpcmData.size() + SuffixSize(sample);
+}
 
-    WriteHeader(out);
+void SerializeSohSamplePrefix(uint32_t adpcmSize, std::vector<uint8_t>& out) {
+    BinaryWriter writer(out);
+    writer.Reserve(kPrefixSize);
+    PutHeader(writer);
 
-    WriteU8(out, 0); // CODEC_ADPCM
-    WriteU8(out, 0); // medium
-    WriteU8(out, 0); // unk_bit26
-    WriteU8(out, 0); // isRelocated
+    writer.PutU8(0); // CODEC_ADPCM
+    writer.PutU8(0); // medium
+    writer.PutU8(0); // unk_bit26
+    writer.PutU8(0); // isRelocated
 
-    WriteU32LE(out, static_cast<uint32_t>(sample.adpcmData.size()));
-    if (!sample.adpcmData.empty()) {
-        out.write(reinterpret_cast<const char*>(sample.adpcmData.data()), sample.adpcmData.size());
-    }
+    writer.PutU32LE(adpcmSize);
+}
 
+void SerializeSohSampleSuffix(const SohSampleData& sample, std::vector<uint8_t>& out) {
+    BinaryWriter writer(out);
+    writer.Reserve(SuffixSize(sample));
     if (sample.loopEnabled) {
-        WriteU32LE(out, sample.loopStart);
-        WriteU32LE(out, sample.loopEnd);
-        WriteU32LE(out, static_cast<uint32_t>(sample.loopCount));
-        WriteU32LE(out, 16);
-        for (int16_t value : sample.loopState) {
-            WriteU16LE(out, static_cast<uint16_t>(value));
-        }
+        writer.PutU32LE(sample.loopStart);
+        writer.PutU32LE(sample.loopEnd);
+        writer.PutU32LE(static_cast<uint32_t>(sample.loopCount));
+        writer.PutU32LE(16);
+        writer.PutS16LE(sample.loopState);
     } else {
-        WriteU32LE(out, 0);
-        WriteU32LE(out, sample.sampleCount);
-        WriteU32LE(out, 0);
-        WriteU32LE(out, 0);
+        writer.PutU32LE(0);
+        writer.PutU32LE(sample.sampleCount);
+        writer.PutU32LE(0);
+        writer.PutU32LE(0);
     }
 
-    WriteU32LE(out, static_cast<uint32_t>(sample.order));
-    WriteU32LE(out, static_cast<uint32_t>(sample.predictors));
-    WriteU32LE(out, static_cast<uint32_t>(sample.book.size()));
-    for (int16_t value : sample.book) {
-        WriteU16LE(out, static_cast<uint16_t>(value));
+    writer.PutU32LE(static_cast<uint32_t>(sample.order));
+    writer.PutU32LE(static_cast<uint32_t>(sample.predictors));
+    writer.PutU32LE(static_cast<uint32_t>(sample.book.size()));
+    writer.PutS16LE(sample.book);
+}
+
+void SerializeSohSample(const SohSampleData& sample, std::vector<uint8_t>& out) {
+    out.reserve(out.size() + SohSampleSize(sample));
+    SerializeSohSamplePrefix(static_cast<uint32_t>(sample.adpcmData.size()), out);
+    out.insert(out.end(), sample.adpcmData.begin(), sample.adpcmData.end());
+    SerializeSohSampleSuffix(sample, out);
+}
+
+std::array<std::span<const uint8_t>, 3> FrameSohSample(const SohSampleData& sample, std::vector<uint8_t>& framing) {
+    // Only the small prefix and suffix are built, back to back.
+    framing.clear();
+    framing.reserve(kPrefixSize + SuffixSize(sample));
+    SerializeSohSamplePrefix(static_cast<uint32_t>(sample.adpcmData.size()), framing);
+    size_t prefixSize = framing.size();
+    SerializeSohSampleSuffix(sample, framing);
+
+    std::span<const uint8_t> all(framing);
+    return {all.first(prefixSize), sample.adpcmData, all.subspan(prefixSize)};
+}
+
+bool WriteSohSample(const std::filesystem::path& path,
+                    const SohSampleData& sample,
+                    std::string& error,
+                    std::vector<uint8_t>* framing) {
+    // The payload is written from the caller's buffer.
+    std::vector<uint8_t> localFraming;
+    auto segments = FrameSohSample(sample, framing ? *framing : localFraming);
+    return WriteFileSegments(path, segments, error);
+}
+
+static uint32_t ReadU32LE(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) | (static_cast<uint32_t>(p[2]) << 16) |
+           (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static void ReadS16LE(const uint8_t* p, std::span<int16_t> out) {
+    for (size_t i = 0; i < out.size(); i++) {
+        out[i] = static_cast<int16_t>(p[i * 2] | (p[i * 2 + 1] << 8));
+    }
+}
+
+bool ReadSohSample(std::span<const uint8_t> resource, SohSampleView& out, std::string& error) {
+    const uint8_t* data = resource.data();
+    size_t size = resource.size();
+    if (size < kPrefixSize || ReadU32LE(data + 4) != kResTypeAudioSample) {
+        error = "Not a SoH audio sample.";
+        return false;
+    }
+    if (data[kHeaderSize] != 0) {
+        error = "Only ADPCM samples are supported.";
+        return false;
     }
 
-    if (!out) {
-        error = "Failed to write output file.";
+    size_t adpcmSize = ReadU32LE(data + kHeaderSize + 4);
+    size_t position = kPrefixSize + adpcmSize;
+    // Loop block, then order, predictor count and book size.
+    if (adpcmSize > size || position + 16 + 12 > size) {
+        error = "Sample is truncated.";
         return false;
     }
+    out.adpcmData = resource.subspan(kPrefixSize, adpcmSize);
+
+    out.loopStart = ReadU32LE(data + position);
+    out.loopEnd = ReadU32LE(data + position + 4);
+    out.loopCount = static_cast<int32_t>(ReadU32LE(data + position + 8));
+    uint32_t stateCount = ReadU32LE(data + position + 12);
+    position += 16;
+    out.loopEnabled = stateCount != 0;
+    if (out.loopEnabled) {
+        if (stateCount != out.loopState.size() || position + stateCount * 2 + 12 > size) {
+            error = "Sample loop block is malformed.";
+            return false;
+        }
+        ReadS16LE(data + position, out.loopState);
+        position += stateCount * 2;
+        out.sampleCount = static_cast<uint32_t>(adpcmSize / kVADPCMFrameByteSize * kVADPCMFrameSampleCount);
+    } else {
+        out.sampleCount = out.loopEnd;
+        out.loopEnd = 0;
+        out.loopCount = 0;
+        out.loopState = {};
+    }
 
+    out.order = static_cast<int>(ReadU32LE(data + position));
+    out.predictors = static_cast<int>(ReadU32LE(data + position + 4));
+    size_t bookSize = ReadU32LE(data + position + 8);
+    position += 12;
+    if (out.order < 1 || out.order > 8 || out.predictors < 1 || out.predictors > kVADPCMMaxPredictorCount ||
+        bookSize != static_cast<size_t>(out.order * out.predictors * 8) || position + bookSize * 2 > size) {
+        error = "Sample codebook is malformed.";
+        return false;
+    }
+    out.book.resize(bookSize);
+    ReadS16LE(data + position, out.book);
     return true;
 }
+
+bool OpenSohSampleView(const std::filesystem::path& path, SohSampleView& out, std::string& error) {
+    return out.file.Open(path, error) && ReadSohSample({out.file.GetData(), out.file.GetSize()}, out, error);
+}
@@ -1,8 +1,11 @@
 #pragma once
 
+#include "MappedFile.h"
+
 #include <array>
 #include <cstdint>
 #include <filesystem>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -19,4 +22,45 @@ struct SohSampleData {
     std::vector<int16_t> book;
 };
 
-bool WriteSohSample(const std::filesystem::path& path, const SohSampleData& sample, std::string& error);
+// A sample parsed in place: adpcmData points into the resource it was read
+// from, which must outlive the view. Only the codebook, at most 2 KB, is
+// copied out.
+struct SohSampleView {
+    std::span<const uint8_t> adpcmData;
+    uint32_t sampleCount = 0;
+    uint32_t loopStart = 0;
+    uint32_t loopEnd = 0;
+    int32_t loopCount = 0;
+    bool loopEnabled = false;
+    std::array<int16_t, 16> loopState{};
+    int order = 0;
+    int predictors = 0;
+    std::vector<int16_t> book;
+    // The mapping adpcmData points into when opened from a file.
+    MappedFile file;
+};
+
+// Exact size of the serialized resource.
+size_t SohSampleSize(const SohSampleData& sample);
+// Appends the whole resource to out, for callers that keep it in memory.
+void SerializeSohSample(const SohSampleData& sample, std::vector<uint8_t>& out);
+// The resource as prefix, ADPCM payload and suffix, with only the prefix and
+// suffix built (in framing); the payload span points into sample.
+std::array<std::span<const uint8_t>, 3> FrameSohSample(const SohSampleData& sample, std::vector<uint8_t>& framing);
+// Writes the resource with one gathered write: prefix, ADPCM payload, suffix.
+// The prefix and suffix are built in framing when given.
+bool WriteSohSample(const std::filesystem::path& path,
+                    const SohSampleData& sample,
+                    std::string& error,
+                    std::vector<uint8_t>* framing = nullptr);
+// Reads a serialized resource back. Looping samples do not store their
+// length, so sampleCount is then the whole frames in the payload.
+bool ReadSohSample(std::span<const uint8_t> resource, SohSampleView& out, std::string& error);
+// Maps the file into out.file and reads it with ReadSohSample.
+bool OpenSohSampleView(const std::filesystem::path& path, SohSampleView& out, std::string& error);
+
+// Pieces of the resource for writers that stream the ADPCM payload
+// themselves: the prefix ends with the payload size, the suffix holds the
+// loop block and codebook (sample.adpcmData is ignored).
+void SerializeSohSamplePrefix(uint32_t adpcmSize, std::vector<uint8_t>& out);
+void SerializeSohSampleSuffix(const SohSampleData& sample, std::vector<uint8_t>& out);
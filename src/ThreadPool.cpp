@@ -0,0 +1,83 @@
+#include "ThreadPool.h"
+
+#include <utility>
+
+size_t ThreadPool::DefaultThreadCount() {
+    unsigned int count = std::thread::hardware_concurrency();
+    return count == 0 ? 1 : static_cast<size_t>(count);
+}
+
+ThreadPool::ThreadPool(size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = DefaultThreadCount();
+    }
+    workers.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) {
+        workers.emplace_back([this] { WorkerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    taskAvailable.notify_one();
+}
+
+void ThreadPool::Wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    idle.wait(lock, [this] { return tasks.empty() && activeTasks == 0; });
+    if (firstException) {
+        std::rethrow_exception(std::exchange(firstException, nullptr));
+    }
+}
+
+size_t ThreadPool::GetThreadCount() const {
+    return workers.size();
+}
+
+void ThreadPool::WorkerLoop() {
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            activeTasks++;
+        }
+
+        std::exception_ptr exception;
+        try {
+            task();
+        } catch (...) {
+            exception = std::current_exception();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (exception && !firstException) {
+                firstException = exception;
+            }
+            activeTasks--;
+            if (tasks.empty() && activeTasks == 0) {
+                idle.notify_all();
+            }
+        }
+    }
+}
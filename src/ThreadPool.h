@@ -0,0 +1,42 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads. Tasks run in submission order; Wait()
+// blocks until every submitted task has finished. A task that throws does not
+// take its worker down: the first exception is kept and rethrown by the next
+// Wait(), and the remaining tasks still run.
+class ThreadPool {
+public:
+    // threadCount == 0 uses one thread per hardware core.
+    explicit ThreadPool(size_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Submit(std::function<void()> task);
+    void Wait();
+    size_t GetThreadCount() const;
+
+    static size_t DefaultThreadCount();
+
+private:
+    void WorkerLoop();
+
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable idle;
+    std::exception_ptr firstException;
+    size_t activeTasks = 0;
+    bool stopping = false;
+};
@@ -0,0 +1,424 @@
+#include "VadpcmStream.h"
+
+#include "AudioFormats.h"
+#include "ConversionCache.h"
+#include "Hash64.h"
+#include "Profiler.h"
+#include "SohSampleWriter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <system_error>
+
+extern "C" {
+#include "codec/vadpcm.h"
+}
+
+// Frames read or encoded per chunk in either pass.
+static constexpr size_t kChunkFrames = 4096;
+// Training excerpt: kTrainingBlocks runs of kTrainingBlockFrames frames spread
+// evenly over the input (16384 frames, about 8 s at 32 kHz).
+static constexpr size_t kTrainingBlockFrames = 256;
+static constexpr size_t kTrainingBlocks = 64;
+static constexpr int kMaxScale = 12;
+
+VadpcmFrameEncoder::VadpcmFrameEncoder(std::span<const int16_t> book, int order, int predictors)
+    : book(book.begin(), book.end()), order(order), predictors(predictors) {
+}
+
+int VadpcmFrameEncoder::IdealResidualPeak(int predictor, const int16_t* input) const {
+    // With unquantized residuals the decoder reproduces the input exactly, so
+    // the second vector is predicted from the first vector's input samples.
+    double peak = 0.0;
+    for (int vector = 0; vector < 2; vector++) {
+        const int16_t* history = vector == 0 ? state : input;
+        const int16_t* x = input + vector * 8;
+        double accumulator[8];
+        for (int i = 0; i < 8; i++) {
+            double sum = 0.0;
+            for (int k = 0; k < order; k++) {
+                sum += static_cast<double>(history[8 - order + k]) * Coefficient(predictor, k, i);
+            }
+            accumulator[i] = sum;
+        }
+        for (int k = 0; k < 8; k++) {
+            double residual = x[k] - accumulator[k] / 2048.0;
+            peak = std::max(peak, std::fabs(residual));
+            for (int i = 0; i < 7 - k; i++) {
+                accumulator[k + i + 1] += residual * Coefficient(predictor, order - 1, i);
+            }
+        }
+    }
+    return static_cast<int>(std::min(peak, 65536.0));
+}
+
+int64_t VadpcmFrameEncoder::QuantizeFrame(int predictor,
+                                          int scale,
+                                          const int16_t* input,
+                                          uint8_t* nibbles,
+                                          int16_t* decoded) const {
+    int64_t error = 0;
+    double step = static_cast<double>(1 << scale);
+    for (int vector = 0; vector < 2; vector++) {
+        const int16_t* history = vector == 0 ? state : decoded;
+        const int16_t* x = input + vector * 8;
+        int16_t* y = decoded + vector * 8;
+        // 64-bit so extreme codebooks cannot overflow; the decoder clamps the
+        // same way for every value a real codebook produces.
+        int64_t accumulator[8];
+        for (int i = 0; i < 8; i++) {
+            int64_t sum = 0;
+            for (int k = 0; k < order; k++) {
+                sum += history[8 - order + k] * Coefficient(predictor, k, i);
+            }
+            accumulator[i] = sum;
+        }
+        for (int k = 0; k < 8; k++) {
+            double target = static_cast<double>(x[k]) - static_cast<double>(accumulator[k]) / 2048.0;
+            int residual = static_cast<int>(std::lround(target / step));
+            residual = std::clamp(residual, -8, 7);
+            nibbles[vector * 8 + k] = static_cast<uint8_t>(residual & 0xF);
+
+            int64_t value = residual * (1 << scale);
+            accumulator[k] += value * 2048;
+            for (int i = 0; i < 7 - k; i++) {
+                accumulator[k + i + 1] += value * Coefficient(predictor, order - 1, i);
+            }
+
+            int32_t sample = static_cast<int32_t>(std::clamp<int64_t>(accumulator[k] >> 11, -32768, 32767));
+            y[k] = static_cast<int16_t>(sample);
+            int64_t diff = static_cast<int64_t>(x[k]) - sample;
+            error += diff * diff;
+        }
+    }
+    return error;
+}
+
+void VadpcmFrameEncoder::EncodeFrame(const int16_t* input, uint8_t* output, int16_t* decoded) {
+    int64_t bestError = std::numeric_limits<int64_t>::max();
+    int bestPredictor = 0;
+    int bestScale = 0;
+    uint8_t bestNibbles[16] = {};
+
+    for (int predictor = 0; predictor < predictors; predictor++) {
+        int peak = IdealResidualPeak(predictor, input);
+        int scale = 0;
+        while (scale < kMaxScale && (peak >> scale) > 7) {
+            scale++;
+        }
+
+        for (int candidate = std::max(scale - 1, 0); candidate <= std::min(scale + 1, kMaxScale); candidate++) {
+            uint8_t nibbles[16];
+            int16_t trial[16];
+            int64_t error = QuantizeFrame(predictor, candidate, input, nibbles, trial);
+            if (error < bestError) {
+                bestError = error;
+                bestPredictor = predictor;
+                bestScale = candidate;
+                std::copy(std::begin(nibbles), std::end(nibbles), bestNibbles);
+                std::copy(std::begin(trial), std::end(trial), decoded);
+            }
+        }
+    }
+
+    output[0] = static_cast<uint8_t>((bestScale << 4) | bestPredictor);
+    for (int i = 0; i < 8; i++) {
+        output[1 + i] = static_cast<uint8_t>((bestNibbles[i * 2] << 4) | bestNibbles[i * 2 + 1]);
+    }
+    std::copy(decoded + 8, decoded + 16, state);
+}
+
+// Reads the whole input once, hashing it and keeping an excerpt of blocks of
+// whole frames at evenly spaced positions; short inputs are taken whole.
+static bool ReadExcerpt(WavStreamReader& reader,
+                        uint64_t frameCount,
+                        std::vector<int16_t>& training,
+                        Hash64Stream& pcmHash,
+                        std::string& status) {
+    size_t blockCount = kTrainingBlocks;
+    uint64_t blockFrames = kTrainingBlockFrames;
+    if (frameCount <= kTrainingBlocks * kTrainingBlockFrames) {
+        blockCount = 1;
+        blockFrames = frameCount;
+    }
+    uint64_t stride = frameCount / blockCount;
+
+    training.assign(static_cast<size_t>(blockCount * blockFrames) * kVADPCMFrameSampleCount, 0);
+    std::vector<int16_t> chunk(kChunkFrames * kVADPCMFrameSampleCount);
+    size_t trainingFill = 0;
+    uint64_t sampleIndex = 0;
+    for (;;) {
+        size_t read = reader.Read(chunk.data(), chunk.size());
+        if (read == 0) {
+            break;
+        }
+        {
+            ScopedStageTimer timer(ProfileStage::Hash);
+            pcmHash.Update({reinterpret_cast<const uint8_t*>(chunk.data()), read * sizeof(int16_t)});
+        }
+        for (size_t i = 0; i < read; i++, sampleIndex++) {
+            uint64_t frame = sampleIndex / kVADPCMFrameSampleCount;
+            uint64_t block = frame / stride;
+            if (block < blockCount && frame - block * stride < blockFrames) {
+                training[trainingFill++] = chunk[i];
+            }
+        }
+    }
+    if (sampleIndex != reader.GetSampleCount()) {
+        status = "WAV error: Failed to read file.";
+        return false;
+    }
+    return true;
+}
+
+static bool TrainCodebook(std::span<const int16_t> training,
+                          const ConvertOptions& options,
+                          StreamEncodeResult& result,
+                          std::vector<int16_t>& book,
+                          std::string& status,
+                          const std::atomic<bool>* cancel) {
+    VadpcmAifc trained;
+    std::string error;
+    if (options.targetSnrDb > 0.0) {
+        // The count is picked on the excerpt; its SNR is replaced by the
+        // whole stream's once the second pass has run.
+        PredictorChoice choice;
+        if (!SearchPredictorCount(training, 0, options.predictorCount, options.targetSnrDb, trained, choice, error,
+                                  cancel, options.parallelSearch)) {
+            status = "VADPCM encode failed: " + error;
+            return false;
+        }
+        result.predictorChoice = choice;
+    } else {
+        ScopedStageTimer timer(ProfileStage::Encode);
+        if (!EncodeVadpcm(training, 0, options.predictorCount, trained, error)) {
+            status = "VADPCM encode failed: " + error;
+            return false;
+        }
+    }
+    result.predictorCount = trained.predictors;
+    book = std::move(trained.book);
+    return true;
+}
+
+bool StreamConvertSample(const ConvertJob& job,
+                         const std::filesystem::path& outPath,
+                         const ConvertOptions& options,
+                         StreamEncodeResult& result,
+                         std::string& status,
+                         const std::atomic<bool>* cancel,
+                         const StreamInputReady& inputReady) {
+    auto cancelled = [&] {
+        if (cancel && cancel->load(std::memory_order_relaxed)) {
+            status = ConvertStageName(ConvertStage::Cancelled);
+            return true;
+        }
+        return false;
+    };
+
+    std::string error;
+    WavStreamReader reader;
+    if (!reader.Open(job.inputPath, error, options.dither)) {
+        status = "WAV error: " + error;
+        return false;
+    }
+
+    uint64_t sampleCount = reader.GetSampleCount();
+    uint64_t frameCount = (sampleCount + kVADPCMFrameSampleCount - 1) / kVADPCMFrameSampleCount;
+    uint64_t adpcmSize = frameCount * kVADPCMFrameByteSize;
+    if (sampleCount > std::numeric_limits<uint32_t>::max() || adpcmSize > std::numeric_limits<uint32_t>::max()) {
+        status = "Input is too long for a SoH sample.";
+        return false;
+    }
+
+    SohSampleData outputSample;
+    outputSample.sampleCount = static_cast<uint32_t>(sampleCount);
+    if (job.loopEnabled) {
+        uint32_t maxIndex = static_cast<uint32_t>(frameCount * kVADPCMFrameSampleCount - 1);
+        uint32_t loopEnd = job.loopEnd == 0 ? maxIndex : job.loopEnd;
+        if (job.loopStart > loopEnd || loopEnd > maxIndex) {
+            status = "Invalid loop range. Max index = " + std::to_string(maxIndex) + ".";
+            return false;
+        }
+        outputSample.loopEnabled = true;
+        outputSample.loopStart = job.loopStart;
+        outputSample.loopEnd = loopEnd;
+        outputSample.loopCount = job.loopCount;
+    }
+
+    std::vector<int16_t> training;
+    Hash64Stream pcmHash;
+    if (!ReadExcerpt(reader, frameCount, training, pcmHash, status)) {
+        return false;
+    }
+    if (cancelled()) {
+        return false;
+    }
+    result.inputKey = ConversionCacheKey(pcmHash.Digest(), sampleCount, reader.GetSampleRate(), job, options);
+    if (inputReady && !inputReady(result.inputKey)) {
+        result.skipped = true;
+        status = "OK";
+        return true;
+    }
+
+    std::vector<int16_t> book;
+    if (!TrainCodebook(training, options, result, book, status, cancel)) {
+        // A search stopped by cancel reports that instead of its error.
+        cancelled();
+        return false;
+    }
+    int predictorCount = result.predictorCount;
+    if (cancelled()) {
+        return false;
+    }
+    if (!reader.Rewind()) {
+        status = "WAV error: Failed to read file.";
+        return false;
+    }
+
+    // Written under a temporary name and renamed once complete, so a failed
+    // or cancelled run leaves an earlier output in place.
+    std::filesystem::path tempPath = outPath;
+    tempPath += ".tmp";
+    std::ofstream out(tempPath, std::ios::binary);
+    if (!out) {
+        status = "Write error: Failed to open output file.";
+        return false;
+    }
+    auto fail = [&](std::string message) {
+        out.close();
+        std::error_code ec;
+        std::filesystem::remove(tempPath, ec);
+        status = std::move(message);
+        return false;
+    };
+
+    // The manifest records what was written without reading it back.
+    Hash64Stream resourceHash;
+    std::vector<uint8_t> framing;
+    auto write = [&](std::span<const uint8_t> bytes) {
+        resourceHash.Update(bytes);
+        out.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    };
+    {
+        ScopedStageTimer timer(ProfileStage::Write);
+        SerializeSohSamplePrefix(static_cast<uint32_t>(adpcmSize), framing);
+        write(framing);
+    }
+
+    VadpcmFrameEncoder encoder(book, kVADPCMEncodeOrder, predictorCount);
+    std::vector<int16_t> input(kChunkFrames * kVADPCMFrameSampleCount);
+    std::vector<uint8_t> encoded(kChunkFrames * kVADPCMFrameByteSize);
+    int16_t decoded[kVADPCMFrameSampleCount];
+    // Verify mode keeps the encoder's reconstruction of the whole chunk and
+    // runs the reference decoder, with its own carried state, over the same
+    // bytes.
+    std::vector<int16_t> expected;
+    std::vector<int16_t> reference;
+    std::vector<vadpcm_vector> codebook;
+    vadpcm_vector verifyState{};
+    if (options.verify) {
+        expected.resize(input.size());
+        reference.resize(input.size());
+        codebook.resize(book.size() / kVADPCMVectorSampleCount);
+        for (size_t i = 0; i < codebook.size(); i++) {
+            std::copy_n(book.begin() + i * kVADPCMVectorSampleCount, kVADPCMVectorSampleCount, codebook[i].v);
+        }
+    }
+    int64_t loopStateBegin = static_cast<int64_t>(outputSample.loopStart) - 16;
+    SnrAccumulator snr;
+    int peak = 0;
+    uint64_t framesDone = 0;
+    while (framesDone < frameCount) {
+        if (cancelled()) {
+            return fail(status);
+        }
+
+        size_t chunkFrames = static_cast<size_t>(std::min<uint64_t>(kChunkFrames, frameCount - framesDone));
+        size_t wanted = chunkFrames * kVADPCMFrameSampleCount;
+        size_t read = reader.Read(input.data(), wanted);
+        uint64_t remaining = sampleCount - framesDone * kVADPCMFrameSampleCount;
+        if (read < std::min<uint64_t>(wanted, remaining)) {
+            return fail("WAV error: Failed to read file.");
+        }
+        std::fill(input.begin() + read, input.begin() + wanted, 0);
+
+        {
+            ScopedStageTimer timer(ProfileStage::Encode);
+            for (size_t frame = 0; frame < chunkFrames; frame++) {
+                encoder.EncodeFrame(input.data() + frame * kVADPCMFrameSampleCount,
+                                    encoded.data() + frame * kVADPCMFrameByteSize,
+                                    decoded);
+                if (options.verify) {
+                    std::copy(std::begin(decoded), std::end(decoded), expected.begin() + frame * kVADPCMFrameSampleCount);
+                }
+
+                int64_t base = static_cast<int64_t>((framesDone + frame) * kVADPCMFrameSampleCount);
+                if (result.predictorChoice) {
+                    size_t valid = static_cast<size_t>(
+                        std::min<uint64_t>(kVADPCMFrameSampleCount, sampleCount - static_cast<uint64_t>(base)));
+                    snr.Add({input.data() + frame * kVADPCMFrameSampleCount, valid}, decoded);
+                }
+                for (int i = 0; i < kVADPCMFrameSampleCount; i++) {
+                    int value = decoded[i] < 0 ? -static_cast<int>(decoded[i]) : decoded[i];
+                    peak = std::max(peak, value);
+                    int64_t statePos = base + i - loopStateBegin;
+                    if (outputSample.loopEnabled && statePos >= 0 && statePos < 16) {
+                        outputSample.loopState[static_cast<size_t>(statePos)] = decoded[i];
+                    }
+                }
+            }
+        }
+
+        if (options.verify) {
+            ScopedStageTimer timer(ProfileStage::Verify);
+            vadpcm_error err = vadpcm_decode(predictorCount, kVADPCMEncodeOrder, codebook.data(), &verifyState,
+                                             chunkFrames, reference.data(), encoded.data());
+            if (err != kVADPCMErrNone) {
+                return fail(std::string("Verify failed: ") + vadpcm_error_name(err));
+            }
+            if (!std::equal(reference.begin(), reference.begin() + wanted, expected.begin())) {
+                return fail("Verify failed: decoded audio does not match the encoder.");
+            }
+        }
+
+        {
+            ScopedStageTimer timer(ProfileStage::Write);
+            write({encoded.data(), chunkFrames * kVADPCMFrameByteSize});
+        }
+        framesDone += chunkFrames;
+    }
+
+    if (peak == 0) {
+        return fail("Encoded audio is silent.");
+    }
+
+    outputSample.order = kVADPCMEncodeOrder;
+    outputSample.predictors = predictorCount;
+    outputSample.book = std::move(book);
+    ScopedStageTimer timer(ProfileStage::Write);
+    framing.clear();
+    SerializeSohSampleSuffix(outputSample, framing);
+    write(framing);
+    out.close();
+    if (!out) {
+        return fail("Write error: Failed to write output file.");
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempPath, outPath, ec);
+    if (ec) {
+        return fail("Write error: " + ec.message());
+    }
+
+    result.sampleCount = sampleCount;
+    result.peak = peak;
+    result.resourceHash = resourceHash.Digest();
+    if (result.predictorChoice) {
+        result.predictorChoice->snrDb = snr.Db();
+        result.predictorChoice->metTarget = result.predictorChoice->snrDb >= options.targetSnrDb;
+    }
+    status = "OK";
+    return true;
+}
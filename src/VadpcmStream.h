@@ -0,0 +1,72 @@
+#pragma once
+
+#include "Convert.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+// Encodes 16-sample VADPCM frames against a fixed codebook. It runs the
+// decoder alongside, so every frame is chosen by its reconstructed error and
+// the caller gets the decoded samples for free.
+class VadpcmFrameEncoder {
+public:
+    VadpcmFrameEncoder(std::span<const int16_t> book, int order, int predictors);
+
+    // Encodes one frame of 16 samples into 9 bytes and writes the samples
+    // the decoder will reproduce into decoded.
+    void EncodeFrame(const int16_t* input, uint8_t* output, int16_t* decoded);
+
+private:
+    int64_t QuantizeFrame(int predictor, int scale, const int16_t* input, uint8_t* nibbles, int16_t* decoded) const;
+    int IdealResidualPeak(int predictor, const int16_t* input) const;
+    int32_t Coefficient(int predictor, int row, int column) const {
+        return book[(static_cast<size_t>(predictor) * order + row) * 8 + column];
+    }
+
+    std::vector<int16_t> book;
+    int order = 0;
+    int predictors = 0;
+    int16_t state[8] = {};
+};
+
+struct StreamEncodeResult {
+    uint64_t sampleCount = 0;
+    int peak = 0;
+    int predictorCount = 0;
+    // ConversionCacheKey of the samples the first pass read.
+    uint64_t inputKey = 0;
+    // Set when inputReady stopped the conversion before the second pass.
+    bool skipped = false;
+    // Hash64 of the resource as written.
+    uint64_t resourceHash = 0;
+    // Set when options.targetSnrDb asked for a search. The search runs on
+    // the training excerpt; the SNR is measured over the whole stream.
+    std::optional<PredictorChoice> predictorChoice;
+};
+
+// Called between the passes with result.inputKey, before anything is
+// trained or written. Returning false ends the conversion there.
+using StreamInputReady = std::function<bool(uint64_t inputKey)>;
+
+// Two-pass conversion for inputs too long to hold in memory. The first pass
+// reads the WAV in fixed-size chunks and keeps an evenly spaced excerpt to
+// train the codebook on; the second pass encodes frame by frame into a
+// temporary file that replaces outPath once it is complete. Working memory
+// does not depend on the input length.
+// With options.targetSnrDb set, the predictor search runs on that excerpt.
+// With options.verify each chunk is also run through the reference decoder
+// and compared with the encoder's own reconstruction. The first pass also
+// hashes the samples, so the caller can look the input up in a cache or
+// manifest through inputReady without reading it a third time.
+bool StreamConvertSample(const ConvertJob& job,
+                         const std::filesystem::path& outPath,
+                         const ConvertOptions& options,
+                         StreamEncodeResult& result,
+                         std::string& status,
+                         const std::atomic<bool>* cancel = nullptr,
+                         const StreamInputReady& inputReady = {});
@@ -0,0 +1,33 @@
+#include "WavProbeQueue.h"
+
+#include "ThreadPool.h"
+
+WavProbeQueue::WavProbeQueue(size_t threadCount) : pool(std::make_unique<ThreadPool>(threadCount)) {
+}
+
+WavProbeQueue::~WavProbeQueue() {
+    stopping.store(true, std::memory_order_relaxed);
+    pool.reset();
+}
+
+uint64_t WavProbeQueue::Submit(std::filesystem::path path) {
+    uint64_t id = nextId++;
+    pool->Submit([this, id, path = std::move(path)] {
+        if (stopping.load(std::memory_order_relaxed)) {
+            return;
+        }
+        Result result;
+        result.id = id;
+        result.ok = ProbeWavFile(path, result.info, result.error);
+        std::lock_guard<std::mutex> lock(mutex);
+        results.push_back(std::move(result));
+    });
+    return id;
+}
+
+std::vector<WavProbeQueue::Result> WavProbeQueue::TakeResults() {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<Result> taken;
+    taken.swap(results);
+    return taken;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "AudioFormats.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+// Reads WAV headers on background threads, so adding hundreds of files
+// never stalls the caller. Finished probes are picked up with TakeResults.
+class WavProbeQueue {
+public:
+    struct Result {
+        uint64_t id = 0;
+        bool ok = false;
+        WavInfo info;
+        std::string error;
+    };
+
+    explicit WavProbeQueue(size_t threadCount = 2);
+    // Drops probes that have not started and waits for the running ones.
+    ~WavProbeQueue();
+
+    WavProbeQueue(const WavProbeQueue&) = delete;
+    WavProbeQueue& operator=(const WavProbeQueue&) = delete;
+
+    // Returns the id the result will carry; ids start at 1.
+    uint64_t Submit(std::filesystem::path path);
+    // Probes finished since the last call, in completion order.
+    std::vector<Result> TakeResults();
+
+private:
+    std::unique_ptr<ThreadPool> pool;
+    std::mutex mutex;
+    std::vector<Result> results;
+    uint64_t nextId = 1;
+    std::atomic<bool> stopping{false};
+};
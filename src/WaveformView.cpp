@@ -0,0 +1,231 @@
+#include "WaveformView.h"
+
+#include "PathUtils.h"
+
+#include "imgui.h"
+
+extern "C" {
+#include "codec/vadpcm.h"
+}
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+// Closest zoom, in pixels per sample.
+static constexpr double kMaxPixelsPerSample = 16.0;
+// View length scale per wheel notch.
+static constexpr double kZoomStep = 0.8;
+// Frame grid lines are hidden when closer than this, in pixels.
+static constexpr double kMinGridSpacing = 6.0;
+// How far from a loop edge, in pixels, a click still grabs it.
+static constexpr float kEdgeGrabDistance = 5.0f;
+
+static constexpr ImU32 kLoopFillColor = IM_COL32(80, 160, 255, 48);
+static constexpr ImU32 kLoopEdgeColor = IM_COL32(80, 160, 255, 220);
+static constexpr ImU32 kGridColor = IM_COL32(255, 255, 255, 24);
+
+WaveformView::~WaveformView() {
+    CancelBuild();
+}
+
+void WaveformView::SetSource(const std::filesystem::path& path) {
+    if (path == this->path) {
+        return;
+    }
+    Clear();
+    this->path = path;
+    cancel = false;
+    build = std::async(std::launch::async, [this, path] {
+        BuildResult result;
+        result.peaks = std::make_unique<PeakPyramid>();
+        if (!result.peaks->Open(path, result.error, &cancel)) {
+            result.peaks.reset();
+        }
+        return result;
+    });
+}
+
+void WaveformView::Clear() {
+    CancelBuild();
+    path.clear();
+    peaks.reset();
+    error.clear();
+    drag = DragTarget::None;
+}
+
+void WaveformView::CancelBuild() {
+    if (build.valid()) {
+        cancel = true;
+        build.wait();
+        build = {};
+    }
+}
+
+void WaveformView::Draw(float height, uint32_t targetRate, bool loopEnabled, uint32_t& loopStart, uint32_t& loopEnd) {
+    if (build.valid() && build.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+        BuildResult result = build.get();
+        peaks = std::move(result.peaks);
+        error = std::move(result.error);
+        viewStart = 0.0;
+        viewLength = peaks ? static_cast<double>(peaks->GetSampleCount()) : 0.0;
+    }
+    if (build.valid()) {
+        ImGui::TextDisabled("Reading %s...", PathToUtf8(path).c_str());
+        return;
+    }
+    if (!peaks) {
+        if (!error.empty()) {
+            ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.3f, 1.0f), "%s", error.c_str());
+        }
+        return;
+    }
+    uint64_t sampleCount = peaks->GetSampleCount();
+    if (sampleCount == 0) {
+        ImGui::TextDisabled("The sample is empty.");
+        return;
+    }
+
+    uint32_t inputRate = peaks->GetSampleRate();
+    double frameLength = static_cast<double>(kVADPCMFrameSampleCount);
+    if (targetRate != 0 && inputRate != 0) {
+        frameLength = frameLength * inputRate / targetRate;
+    }
+    float width = std::max(ImGui::GetContentRegionAvail().x, 1.0f);
+    double samplesPerPixel = viewLength / width;
+
+    ImGui::Checkbox("Snap to frames", &snapToFrames);
+    if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("Drop dragged loop points on VADPCM frame boundaries, %.3g input samples apart.", frameLength);
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled("Samples %.0f to %.0f of %llu, %.3g per pixel. Wheel zooms, right-drag pans.", viewStart,
+                        viewStart + viewLength, static_cast<unsigned long long>(sampleCount), samplesPerPixel);
+
+    ImVec2 origin = ImGui::GetCursorScreenPos();
+    ImVec2 corner(origin.x + width, origin.y + height);
+    ImGui::InvisibleButton("##waveform", ImVec2(width, height),
+                           ImGuiButtonFlags_MouseButtonLeft | ImGuiButtonFlags_MouseButtonRight);
+    bool hovered = ImGui::IsItemHovered();
+    bool active = ImGui::IsItemActive();
+    ImGuiIO& io = ImGui::GetIO();
+
+    double total = static_cast<double>(sampleCount);
+    if (hovered && io.MouseWheel != 0.0f) {
+        double anchor = viewStart + (io.MousePos.x - origin.x) * samplesPerPixel;
+        double minLength = std::min(total, width / kMaxPixelsPerSample);
+        viewLength = std::clamp(viewLength * std::pow(kZoomStep, io.MouseWheel), minLength, total);
+        viewStart = anchor - (io.MousePos.x - origin.x) * viewLength / width;
+    }
+    if (active && ImGui::IsMouseDown(ImGuiMouseButton_Right)) {
+        viewStart -= io.MouseDelta.x * samplesPerPixel;
+    }
+    viewStart = std::clamp(viewStart, 0.0, total - viewLength);
+    samplesPerPixel = viewLength / width;
+    auto toX = [&](double sample) {
+        return origin.x + static_cast<float>((sample - viewStart) / samplesPerPixel);
+    };
+    auto toSample = [&](float x) {
+        return viewStart + (x - origin.x) * samplesPerPixel;
+    };
+    auto snap = [&](double sample) {
+        double snapped = snapToFrames ? std::round(sample / frameLength) * frameLength : sample;
+        return static_cast<uint64_t>(std::clamp(std::round(snapped), 0.0, total));
+    };
+
+    // loopEnd is the last looped sample, 0 for the end of the sample. The
+    // region is drawn to the far side of it.
+    uint64_t last = sampleCount - 1;
+    uint64_t shownStart = std::min<uint64_t>(loopStart, last);
+    uint64_t shownEnd = loopEnd == 0 ? last : std::clamp<uint64_t>(loopEnd, shownStart, last);
+    float startX = toX(static_cast<double>(shownStart));
+    float endX = toX(static_cast<double>(shownEnd + 1));
+    float pointerX = io.MousePos.x;
+
+    if (!loopEnabled || !active || !ImGui::IsMouseDown(ImGuiMouseButton_Left)) {
+        drag = DragTarget::None;
+    } else if (ImGui::IsItemActivated()) {
+        float startDistance = std::abs(pointerX - startX);
+        float endDistance = std::abs(pointerX - endX);
+        if (startDistance <= kEdgeGrabDistance && startDistance <= endDistance) {
+            drag = DragTarget::Start;
+        } else if (endDistance <= kEdgeGrabDistance) {
+            drag = DragTarget::End;
+        } else if (pointerX > startX && pointerX < endX) {
+            drag = DragTarget::Loop;
+            grabOffset = toSample(pointerX) - static_cast<double>(shownStart);
+        }
+    }
+    if (drag != DragTarget::None) {
+        // The end handle sits after the last looped sample, so a snapped end
+        // keeps the loop a whole number of frames.
+        double pointer = toSample(pointerX);
+        if (drag == DragTarget::Start) {
+            loopStart = static_cast<uint32_t>(std::min(snap(pointer), shownEnd));
+        } else if (drag == DragTarget::End) {
+            uint64_t boundary = std::clamp<uint64_t>(snap(pointer), shownStart + 1, sampleCount);
+            loopEnd = static_cast<uint32_t>(boundary - 1);
+        } else {
+            uint64_t length = shownEnd - shownStart;
+            uint64_t start = std::min(snap(pointer - grabOffset), last - length);
+            loopStart = static_cast<uint32_t>(start);
+            loopEnd = static_cast<uint32_t>(start + length);
+        }
+    } else if (loopEnabled && hovered &&
+               std::min(std::abs(pointerX - startX), std::abs(pointerX - endX)) <= kEdgeGrabDistance) {
+        ImGui::SetMouseCursor(ImGuiMouseCursor_ResizeEW);
+    }
+
+    ImDrawList* drawList = ImGui::GetWindowDrawList();
+    drawList->PushClipRect(origin, corner, true);
+    drawList->AddRectFilled(origin, corner, ImGui::GetColorU32(ImGuiCol_FrameBg));
+    if (loopEnabled) {
+        drawList->AddRectFilled(ImVec2(startX, origin.y), ImVec2(endX, corner.y), kLoopFillColor);
+    }
+    if (frameLength / samplesPerPixel >= kMinGridSpacing) {
+        double frame = std::floor(viewStart / frameLength);
+        for (double sample = frame * frameLength; sample <= viewStart + viewLength; sample += frameLength) {
+            float x = toX(sample);
+            drawList->AddLine(ImVec2(x, origin.y), ImVec2(x, corner.y), kGridColor);
+        }
+    }
+
+    float middle = origin.y + height * 0.5f;
+    float scale = height * 0.5f / 32768.0f;
+    ImU32 waveColor = ImGui::GetColorU32(ImGuiCol_PlotLines);
+    if (samplesPerPixel < 1.0) {
+        // Fewer samples than pixels: join the samples themselves, each at
+        // the middle of the span it covers.
+        std::span<const int16_t> samples = peaks->GetSamples();
+        uint64_t first = static_cast<uint64_t>(viewStart);
+        uint64_t end = std::min<uint64_t>(static_cast<uint64_t>(std::ceil(viewStart + viewLength)) + 1, sampleCount);
+        ImVec2 previous(toX(first + 0.5), middle - samples[first] * scale);
+        for (uint64_t i = first + 1; i < end; i++) {
+            ImVec2 point(toX(i + 0.5), middle - samples[i] * scale);
+            drawList->AddLine(previous, point, waveColor);
+            previous = point;
+        }
+    } else {
+        columns.resize(static_cast<size_t>(width));
+        uint64_t first = static_cast<uint64_t>(viewStart);
+        uint64_t end = std::min<uint64_t>(first + static_cast<uint64_t>(std::llround(viewLength)), sampleCount);
+        peaks->Query(first, end, columns);
+        for (size_t column = 0; column < columns.size(); column++) {
+            float x = origin.x + column + 0.5f;
+            // One pixel taller than the span so silence still shows.
+            drawList->AddLine(ImVec2(x, middle - columns[column].max * scale),
+                              ImVec2(x, middle - columns[column].min * scale + 1.0f), waveColor);
+        }
+    }
+    if (loopEnabled) {
+        drawList->AddLine(ImVec2(startX, origin.y), ImVec2(startX, corner.y), kLoopEdgeColor, 2.0f);
+        drawList->AddLine(ImVec2(endX, origin.y), ImVec2(endX, corner.y), kLoopEdgeColor, 2.0f);
+    }
+    drawList->PopClipRect();
+
+    if (hovered && drag == DragTarget::None) {
+        uint64_t sample = std::min(static_cast<uint64_t>(std::max(toSample(pointerX), 0.0)), last);
+        ImGui::SetTooltip("Sample %llu, frame %llu", static_cast<unsigned long long>(sample),
+                          static_cast<unsigned long long>(sample / frameLength));
+    }
+}
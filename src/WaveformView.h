@@ -0,0 +1,66 @@
+#pragma once
+
+#include "PeakPyramid.h"
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Waveform of one input WAV with its loop region and the VADPCM frame grid
+// drawn over it. Peaks are built on a background thread, and every frame
+// draws from the pyramid, so zooming in to single samples costs no more than
+// the whole-file overview. The wheel zooms around the pointer, the right
+// button pans, and the left button drags a loop edge or the whole loop. Call
+// from the UI thread only.
+class WaveformView {
+public:
+    WaveformView() = default;
+    // Cancels and waits for a build in progress.
+    ~WaveformView();
+
+    WaveformView(const WaveformView&) = delete;
+    WaveformView& operator=(const WaveformView&) = delete;
+
+    // Starts reading path unless it is already shown.
+    void SetSource(const std::filesystem::path& path);
+    void Clear();
+
+    // Draws across the available width at the cursor. Loop points are in
+    // input samples, as the sample list holds them; targetRate places the
+    // frame grid where the encoder's frames fall after resampling, 0 for none.
+    void Draw(float height, uint32_t targetRate, bool loopEnabled, uint32_t& loopStart, uint32_t& loopEnd);
+
+    bool IsBuilding() const {
+        return build.valid();
+    }
+    bool GetSnapToFrames() const {
+        return snapToFrames;
+    }
+
+private:
+    struct BuildResult {
+        std::unique_ptr<PeakPyramid> peaks;
+        std::string error;
+    };
+    enum class DragTarget : uint8_t { None, Start, End, Loop };
+
+    void CancelBuild();
+
+    std::filesystem::path path;
+    std::atomic<bool> cancel{false};
+    std::future<BuildResult> build;
+    std::unique_ptr<PeakPyramid> peaks;
+    std::string error;
+    std::vector<SamplePeak> columns;
+    // Samples in view. Fractional so zooming in stays anchored to the pointer.
+    double viewStart = 0.0;
+    double viewLength = 0.0;
+    DragTarget drag = DragTarget::None;
+    // Pointer offset from the loop start while the whole loop is dragged.
+    double grabOffset = 0.0;
+    bool snapToFrames = true;
+};
@@ -1,5 +1,18 @@
 #include "AudioFormats.h"
-#include "SohSampleWriter.h"
+#include "ConversionBatch.h"
+#include "ConversionCache.h"
+#include "ConversionManifest.h"
+#include "Convert.h"
+#include "DirectoryScan.h"
+#include "LoopFinder.h"
+#include "O2rArchive.h"
+#include "PathUtils.h"
+#include "PreviewPlayer.h"
+#include "Profiler.h"
+#include "QualityReport.h"
+#include "Resampler.h"
+#include "WavProbeQueue.h"
+#include "WaveformView.h"
 
 #include "imgui.h"
 #include "imgui_impl_sdl3.h"
@@ -7,11 +20,18 @@
 
 #include <SDL3/SDL.h>
 
-#include <array>
+#include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <filesystem>
+#include <future>
+#include <memory>
 #include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #ifdef _WIN32
@@ -27,19 +47,200 @@ int WINAPI WinMain(HINSTANCE, HINSTANCE, LPSTR, int) {
 }
 #endif
 
-struct SampleItem {
-    std::filesystem::path inputPath;
-    std::string outputName;
-    bool loopEnabled = false;
-    uint32_t loopStart = 0;
-    uint32_t loopEnd = 0;
-    int32_t loopCount = -1;
+constexpr size_t kNoBatchIndex = static_cast<size_t>(-1);
+
+struct LoopSearchRun {
+    size_t item = 0;
+    std::vector<LoopCandidate> candidates;
+    std::string error;
+};
+
+struct SampleItem : ConvertJob {
     uint32_t sampleRate = 0;
     uint32_t sampleCount = 0;
+    // Empty for mono 16-bit WAVs, which need no conversion.
+    std::string sourceFormat;
+    // Of the converted sample, so after any resampling.
     double tuning = 0.0;
     std::string status;
+    std::optional<StageTimings> timings;
+    std::optional<PredictorChoice> predictorChoice;
+    size_t batchIndex = kNoBatchIndex;
+    // Output of the last conversion and the rate it was encoded at, for the
+    // preview button. Empty when the sample went into an archive.
+    std::filesystem::path previewPath;
+    uint32_t previewRate = 0;
+    // Last stage read from the batch; status is refetched only when it moves.
+    ConvertStage stage = ConvertStage::Queued;
+    // Built once, not every frame.
+    std::string inputLabel;
+    std::string rateLabel;
+};
+
+enum SampleColumn : ImGuiID {
+    kColumnInput,
+    kColumnOutput,
+    kColumnLoop,
+    kColumnLoopStart,
+    kColumnLoopEnd,
+    kColumnLoopCount,
+    kColumnRate,
+    kColumnTargetRate,
+    kColumnStatus,
+    kColumnTime,
+    kColumnPredictors,
+    kColumnSnr,
+    kColumnPreview,
+    kSampleColumnCount,
+};
+
+// Fields the filter box can be limited to, in combo order.
+enum SampleFilterField : int {
+    kFilterAll,
+    kFilterInput,
+    kFilterOutput,
+    kFilterStatus,
 };
 
+struct SampleSortKey {
+    ImGuiID column = kColumnInput;
+    bool ascending = true;
+};
+
+// Probe id -> row, for rows whose header probe has not come back yet.
+using ProbeRows = std::unordered_map<uint64_t, size_t>;
+
+// Adds a row straight away; its format fields fill in once the probe ends.
+static void AddSampleItem(std::vector<SampleItem>& items,
+                          WavProbeQueue& probes,
+                          ProbeRows& probeRows,
+                          const std::filesystem::path& path,
+                          std::string outputName) {
+    SampleItem item;
+    item.inputPath = path;
+    item.outputName = std::move(outputName);
+    item.outputName.reserve(128);
+    item.status = "Probing";
+    item.inputLabel = PathToUtf8(path);
+    probeRows[probes.Submit(path)] = items.size();
+    items.push_back(std::move(item));
+}
+
+// Rate, tuning and length of what the row will convert to.
+static void UpdateRateLabel(SampleItem& item) {
+    char rate[96];
+    if (item.targetSampleRate != 0 && item.targetSampleRate != item.sampleRate && item.sampleRate != 0) {
+        item.tuning = static_cast<double>(item.targetSampleRate) / 32000.0;
+        std::snprintf(rate, sizeof(rate), "%u -> %u (%.4f) / %zu", item.sampleRate, item.targetSampleRate, item.tuning,
+                      ResampledLength(item.sampleCount, item.sampleRate, item.targetSampleRate));
+    } else {
+        item.tuning = static_cast<double>(item.sampleRate) / 32000.0;
+        std::snprintf(rate, sizeof(rate), "%u (%.4f) / %u", item.sampleRate, item.tuning, item.sampleCount);
+    }
+    item.rateLabel = rate;
+    if (!item.sourceFormat.empty()) {
+        item.rateLabel += " (" + item.sourceFormat + ")";
+    }
+}
+
+static void ApplyProbeResult(SampleItem& item, const WavProbeQueue::Result& result) {
+    if (!result.ok) {
+        item.status = "WAV error: " + result.error;
+        return;
+    }
+    item.sampleRate = result.info.sampleRate;
+    item.sampleCount = static_cast<uint32_t>(result.info.sampleCount);
+    const WavFormat& format = result.info.format;
+    if (format.channelCount != 1 || format.bitsPerSample != 16 || format.isFloat) {
+        item.sourceFormat = std::to_string(format.channelCount) + " ch " + std::to_string(format.bitsPerSample) +
+                            (format.isFloat ? "-bit float" : "-bit");
+    }
+    item.status = "Ready";
+    UpdateRateLabel(item);
+    if (result.info.hasLoop) {
+        item.loopEnabled = true;
+        item.loopStart = result.info.loopStart;
+        item.loopEnd = result.info.loopEnd;
+        item.loopCount = result.info.loopCount;
+    }
+}
+
+static bool ContainsNoCase(const std::string& text, const std::string& needle) {
+    auto it = std::search(text.begin(), text.end(), needle.begin(), needle.end(), [](char a, char b) {
+        return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+    });
+    return it != text.end();
+}
+
+static bool MatchesFilter(const SampleItem& item, const std::string& filter, int field) {
+    if (filter.empty()) {
+        return true;
+    }
+    return ((field == kFilterAll || field == kFilterInput) && ContainsNoCase(item.inputLabel, filter)) ||
+           ((field == kFilterAll || field == kFilterOutput) && ContainsNoCase(item.outputName, filter)) ||
+           ((field == kFilterAll || field == kFilterStatus) && ContainsNoCase(item.status, filter));
+}
+
+template <typename T>
+static int Compare(const T& a, const T& b) {
+    return a < b ? -1 : (b < a ? 1 : 0);
+}
+
+static int CompareSamples(const SampleItem& a, const SampleItem& b, ImGuiID column) {
+    switch (column) {
+        case kColumnInput:
+            return a.inputLabel.compare(b.inputLabel);
+        case kColumnOutput:
+            return a.outputName.compare(b.outputName);
+        case kColumnRate:
+            if (int result = Compare(a.sampleRate, b.sampleRate)) {
+                return result;
+            }
+            return Compare(a.sampleCount, b.sampleCount);
+        case kColumnTargetRate:
+            return Compare(a.targetSampleRate, b.targetSampleRate);
+        case kColumnStatus:
+            return a.status.compare(b.status);
+        case kColumnTime:
+            return Compare(a.timings ? a.timings->Total() : -1.0, b.timings ? b.timings->Total() : -1.0);
+        case kColumnPredictors:
+            return Compare(a.predictorChoice ? a.predictorChoice->predictorCount : 0,
+                           b.predictorChoice ? b.predictorChoice->predictorCount : 0);
+        case kColumnSnr:
+            return Compare(a.predictorChoice ? a.predictorChoice->snrDb : -HUGE_VAL,
+                           b.predictorChoice ? b.predictorChoice->snrDb : -HUGE_VAL);
+        default:
+            return 0;
+    }
+}
+
+// Indices of the rows to show, filtered and sorted. Rebuilt only when the
+// rows, the filter or the sort order change, never per frame.
+static void BuildSampleView(const std::vector<SampleItem>& items,
+                            const std::vector<SampleSortKey>& sortKeys,
+                            const std::string& filter,
+                            int filterField,
+                            std::vector<size_t>& view) {
+    view.clear();
+    for (size_t i = 0; i < items.size(); i++) {
+        if (MatchesFilter(items[i], filter, filterField)) {
+            view.push_back(i);
+        }
+    }
+    if (sortKeys.empty()) {
+        return;
+    }
+    std::stable_sort(view.begin(), view.end(), [&](size_t left, size_t right) {
+        for (const SampleSortKey& key : sortKeys) {
+            int result = CompareSamples(items[left], items[right], key.column);
+            if (result != 0) {
+                return key.ascending ? result < 0 : result > 0;
+            }
+        }
+        return false;
+    });
+}
+
 static int ImGuiInputTextCallbackImpl(ImGuiInputTextCallbackData* data) {
     if (data->EventFlag == ImGuiInputTextFlags_CallbackResize) {
         auto* str = static_cast<std::string*>(data->UserData);
@@ -107,59 +308,6 @@ static std::optional<std::filesystem::path> NormalizeDropPath(const char* rawPat
     }
 }
 
-static bool IsWavPath(const std::filesystem::path& path) {
-    std::string ext = path.extension().string();
-    for (char& ch : ext) {
-        ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
-    }
-    return ext == ".wav";
-}
-
-static std::string ToUtf8(const std::wstring& input) {
-#ifdef _WIN32
-    if (input.empty()) {
-        return {};
-    }
-    int size = WideCharToMultiByte(CP_UTF8, 0, input.c_str(), static_cast<int>(input.size()), nullptr, 0, nullptr, nullptr);
-    std::string result(size, '\0');
-    WideCharToMultiByte(CP_UTF8, 0, input.c_str(), static_cast<int>(input.size()), result.data(), size, nullptr, nullptr);
-    return result;
-#else
-    return std::string(input.begin(), input.end());
-#endif
-}
-
-static std::wstring ToWide(const std::string& input) {
-#ifdef _WIN32
-    if (input.empty()) {
-        return {};
-    }
-    int size = MultiByteToWideChar(CP_UTF8, 0, input.c_str(), static_cast<int>(input.size()), nullptr, 0);
-    std::wstring result(size, L'\0');
-    MultiByteToWideChar(CP_UTF8, 0, input.c_str(), static_cast<int>(input.size()), result.data(), size);
-    return result;
-#else
-    return std::wstring(input.begin(), input.end());
-#endif
-}
-
-static std::string PathToUtf8(const std::filesystem::path& path) {
-#ifdef _WIN32
-    return ToUtf8(path.wstring());
-#else
-    try {
-        auto u8 = path.u8string();
-        return std::string(u8.begin(), u8.end());
-    } catch (const std::exception&) {
-        return path.string();
-    }
-#endif
-}
-
-static std::string DefaultOutputName(const std::filesystem::path& path) {
-    return path.stem().string();
-}
-
 #ifdef _WIN32
 static std::vector<std::filesystem::path> OpenWavDialog() {
     std::vector<std::filesystem::path> results;
@@ -214,112 +362,6 @@ static std::optional<std::filesystem::path> BrowseFolderDialog() {
 }
 #endif
 
-static std::array<int16_t, 16> BuildLoopState(const std::vector<int16_t>& samples, uint32_t loopStart) {
-    std::array<int16_t, 16> state{};
-    if (samples.empty()) {
-        return state;
-    }
-
-    if (loopStart >= 16) {
-        for (size_t i = 0; i < 16; i++) {
-            state[i] = samples[loopStart - 16 + i];
-        }
-    } else {
-        size_t pad = 16 - loopStart;
-        for (size_t i = 0; i < pad; i++) {
-            state[i] = 0;
-        }
-        for (size_t i = 0; i < loopStart; i++) {
-            state[pad + i] = samples[i];
-        }
-    }
-
-    return state;
-}
-
-static bool ConvertSample(const SampleItem& item,
-                          const std::filesystem::path& outputDir,
-                          int predictorCount,
-                          std::string& status) {
-    std::string error;
-    WavData wav;
-    if (!ReadWavFile(item.inputPath, wav, error)) {
-        status = "WAV error: " + error;
-        return false;
-    }
-
-    if (item.outputName.empty()) {
-        status = "Output name is empty.";
-        return false;
-    }
-
-    if (outputDir.empty()) {
-        status = "Output folder is empty.";
-        return false;
-    }
-
-    VadpcmAifc aifc;
-    if (!EncodeVadpcm(wav, predictorCount, aifc, error)) {
-        status = "VADPCM encode failed: " + error;
-        return false;
-    }
-
-    std::vector<int16_t> decodedSamples;
-    if (!DecodeVadpcm(aifc, decodedSamples, error)) {
-        status = "VADPCM decode failed: " + error;
-        return false;
-    }
-    int maxAbs = 0;
-    for (int16_t sample : decodedSamples) {
-        int value = sample < 0 ? -static_cast<int>(sample) : static_cast<int>(sample);
-        if (value > maxAbs) {
-            maxAbs = value;
-        }
-    }
-    if (maxAbs == 0) {
-        status = "Encoded audio is silent.";
-        return false;
-    }
-
-    SohSampleData outputSample;
-    outputSample.adpcmData = std::move(aifc.adpcmData);
-    outputSample.sampleCount = static_cast<uint32_t>(wav.samples.size());
-    outputSample.order = aifc.order;
-    outputSample.predictors = aifc.predictors;
-    outputSample.book = std::move(aifc.book);
-
-    if (item.loopEnabled) {
-        if (decodedSamples.empty()) {
-            status = "Decoded audio is empty.";
-            return false;
-        }
-        uint32_t maxIndex = static_cast<uint32_t>(decodedSamples.size() - 1);
-        uint32_t loopStart = item.loopStart;
-        uint32_t loopEnd = item.loopEnd == 0 ? maxIndex : item.loopEnd;
-
-        if (loopStart > loopEnd || loopEnd > maxIndex) {
-            status = "Invalid loop range. Max index = " + std::to_string(maxIndex) + ".";
-            return false;
-        }
-
-        outputSample.loopEnabled = true;
-        outputSample.loopStart = loopStart;
-        outputSample.loopEnd = loopEnd;
-        outputSample.loopCount = item.loopCount;
-        outputSample.loopState = BuildLoopState(decodedSamples, loopStart);
-    }
-
-    std::filesystem::create_directories(outputDir);
-    std::filesystem::path outPath = outputDir / item.outputName;
-    if (!WriteSohSample(outPath, outputSample, error)) {
-        status = "Write error: " + error;
-        return false;
-    }
-
-    status = "OK";
-    return true;
-}
-
 int main(int, char**) {
 #ifdef _WIN32
     CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
@@ -361,15 +403,97 @@ int main(int, char**) {
     ImGui_ImplSDLRenderer3_Init(renderer);
 
     std::filesystem::path outputDir = std::filesystem::current_path();
-    constexpr int predictorCount = 4;
+    // With "Cache outputs" on, finished samples are kept under the per-user
+    // data folder so unchanged inputs convert instantly on later runs; memory
+    // only if there is none. Opened on the first batch that uses it.
+    constexpr uint64_t kCacheMaxBytes = 512ull * 1024 * 1024;
+    bool useCache = false;
+    std::unique_ptr<ConversionCache> cache;
+    ConvertOptions convertOptions;
+    // With the search on, predictorCount is the largest count tried.
+    bool searchPredictors = false;
+    double targetSnrDb = 40.0;
     std::vector<SampleItem> items;
+    WavProbeQueue probes;
+    ProbeRows probeRows;
+    // Filtered, sorted row indices the table draws from. During a batch rows
+    // keep their place; the view is re-sorted once it finishes.
+    std::vector<size_t> sampleView;
+    size_t sampleViewItemCount = 0;
+    bool sampleViewDirty = true;
+    std::vector<SampleSortKey> sortKeys;
+    std::string filterText;
+    int filterField = kFilterAll;
+    // Dropped folders still being walked. Their files are added as found.
+    std::vector<std::unique_ptr<DirectoryScan>> scans;
     std::string outputDirStr = PathToUtf8(outputDir);
     outputDirStr.reserve(512);
+    std::unique_ptr<ConversionBatch> batch;
+    // The folder the last batch wrote to, for its previews, trace and report.
+    std::filesystem::path batchOutputDir;
+    std::optional<ConversionBatch::Stats> lastBatchStats;
+    // Loaded for each batch from the output folder and saved when it ends.
+    std::unique_ptr<ConversionManifest> manifest;
+    std::string manifestError;
+    std::vector<ManifestEntry> orphans;
+    // Written next to the output folder when a batch with tracing ends.
+    bool recordTrace = false;
+    std::unique_ptr<TraceRecorder> trace;
+    std::string traceMessage;
+    // Pack outputs into an archive in the output folder instead of loose
+    // files. Open for the length of a batch.
+    bool packArchive = false;
+    std::string archiveName = "custom_audio.o2r";
+    archiveName.reserve(256);
+    std::unique_ptr<O2rArchive> archive;
+    std::string archiveMessage;
+    // Decodes every finished output once a batch ends and compares it with
+    // its WAV. The archive stays open until the measurement is done.
+    bool measureQuality = false;
+    std::atomic<bool> qualityCancel{false};
+    std::future<std::vector<SampleQuality>> qualityRun;
+    std::vector<SampleQuality> qualityResults;
+    bool qualitySortDirty = false;
+    std::string qualityMessage;
+    std::vector<StageSummary> stageSummary;
+    // Released before SDL_Quit, which must outlive its audio stream.
+    auto preview = std::make_unique<PreviewPlayer>();
+    // Row whose input the waveform panel shows, an index into items.
+    std::optional<size_t> selectedItem;
+    WaveformView waveform;
+    // Find Loop runs for one row at a time and fills in its loop points.
+    std::atomic<bool> loopSearchCancel{false};
+    std::future<LoopSearchRun> loopSearch;
+    std::string loopSearchMessage;
+
+    // Frames to draw after input before the loop may block again; ImGui
+    // needs a few to settle hover state and layout.
+    constexpr int kFramesAfterInput = 3;
+    // Longest idle sleep. Also paces a focused text field's blinking cursor.
+    constexpr int kIdleWaitMs = 500;
+    int activeFrames = kFramesAfterInput;
+    bool wasBusy = false;
 
     bool done = false;
     while (!done) {
+        // Work in flight is polled at the display rate, so its progress shows
+        // at once. With nothing running the loop sleeps until input arrives.
+        bool busy = batch || qualityRun.valid() || !scans.empty() || !probeRows.empty() || preview->IsPlaying() ||
+                    waveform.IsBuilding() || loopSearch.valid();
+        if (wasBusy && !busy) {
+            // Let the final results settle like input does.
+            activeFrames = kFramesAfterInput;
+        }
+        wasBusy = busy;
+        if (activeFrames > 0) {
+            activeFrames--;
+        } else if (!busy) {
+            SDL_WaitEventTimeout(nullptr, kIdleWaitMs);
+        }
+
         SDL_Event event;
         while (SDL_PollEvent(&event)) {
+            activeFrames = kFramesAfterInput;
             ImGui_ImplSDL3_ProcessEvent(&event);
             if (event.type == SDL_EVENT_QUIT) {
                 done = true;
@@ -379,32 +503,158 @@ int main(int, char**) {
             }
             if (event.type == SDL_EVENT_DROP_FILE) {
                 auto dropPath = NormalizeDropPath(event.drop.data);
-                if (dropPath && IsWavPath(*dropPath)) {
-                    WavData wav;
-                    std::string err;
-                    SampleItem item;
-                    item.inputPath = *dropPath;
-                    item.outputName = DefaultOutputName(*dropPath);
-                    item.outputName.reserve(128);
-                    if (ReadWavFile(*dropPath, wav, err)) {
-                        item.sampleRate = wav.sampleRate;
-                        item.sampleCount = static_cast<uint32_t>(wav.samples.size());
-                        item.tuning = static_cast<double>(wav.sampleRate) / 32000.0;
-                        item.status = "Ready";
-                    } else {
-                        item.status = "WAV error: " + err;
-                    }
-                    items.push_back(std::move(item));
+                std::error_code ec;
+                if (dropPath && std::filesystem::is_directory(*dropPath, ec)) {
+                    scans.push_back(std::make_unique<DirectoryScan>(*dropPath));
+                } else if (dropPath && IsWavPath(*dropPath)) {
+                    AddSampleItem(items, probes, probeRows, *dropPath, DefaultOutputName(*dropPath));
                 }
                 // SDL3 manages drop event memory.
             }
         }
 
         if (SDL_GetWindowFlags(window) & SDL_WINDOW_MINIMIZED) {
-            SDL_Delay(10);
+            SDL_WaitEventTimeout(nullptr, busy ? 10 : kIdleWaitMs);
             continue;
         }
 
+        for (auto& scan : scans) {
+            bool finished = scan->IsFinished();
+            for (auto& file : scan->TakeFiles()) {
+                AddSampleItem(items, probes, probeRows, file.path, std::move(file.outputName));
+            }
+            if (finished) {
+                for (const auto& error : scan->GetErrors()) {
+                    SDL_Log("Failed to list folder %s", error.c_str());
+                }
+                scan.reset();
+            }
+        }
+        std::erase(scans, nullptr);
+
+        for (const auto& result : probes.TakeResults()) {
+            // Rows cleared in the meantime simply drop their result.
+            auto it = probeRows.find(result.id);
+            if (it != probeRows.end()) {
+                ApplyProbeResult(items[it->second], result);
+                probeRows.erase(it);
+                // Rate and status only move rows under a sort or filter.
+                sampleViewDirty |= !sortKeys.empty() || !filterText.empty();
+            }
+        }
+
+        if (batch) {
+            bool finished = batch->IsFinished();
+            for (auto& item : items) {
+                if (item.batchIndex == kNoBatchIndex) {
+                    continue;
+                }
+                // One atomic load per row; strings are only copied when the
+                // row's stage actually changed.
+                ConvertStage stage = batch->GetStage(item.batchIndex);
+                if (stage != item.stage) {
+                    item.stage = stage;
+                    if (stage == ConvertStage::Done && !archive) {
+                        item.previewPath = batchOutputDir / Utf8ToPath(item.outputName);
+                        item.previewRate = item.targetSampleRate != 0 ? item.targetSampleRate : item.sampleRate;
+                    }
+                    item.status = batch->GetStatus(item.batchIndex);
+                    item.timings = batch->GetTimings(item.batchIndex);
+                    item.predictorChoice = batch->GetPredictorChoice(item.batchIndex);
+                }
+                if (finished) {
+                    item.batchIndex = kNoBatchIndex;
+                }
+            }
+            stageSummary = batch->GetStageSummary();
+            if (finished) {
+                sampleViewDirty = true;
+                lastBatchStats = batch->GetStats();
+                batch.reset();
+                if (trace) {
+                    std::filesystem::path tracePath = ConversionManifest::PathFor(batchOutputDir);
+                    tracePath.replace_extension(".trace.json");
+                    std::string traceError;
+                    traceMessage = trace->Write(tracePath, traceError) ? "Trace written to " + PathToUtf8(tracePath)
+                                                                       : "Trace failed: " + traceError;
+                    trace.reset();
+                    convertOptions.trace = nullptr;
+                }
+                bool outputsReadable = true;
+                if (archive) {
+                    std::string archiveError;
+                    outputsReadable = archive->Finish(archiveError);
+                    if (outputsReadable) {
+                        O2rArchive::Stats archiveStats = archive->GetStats();
+                        archiveMessage = "Archive: " + std::to_string(archiveStats.added) + " added, " +
+                                         std::to_string(archiveStats.replaced) + " replaced, " +
+                                         std::to_string(archiveStats.unchanged) + " unchanged" +
+                                         (archiveStats.compacted ? ", compacted" : "");
+                    } else {
+                        archiveMessage = archiveError;
+                    }
+                }
+                if (manifest) {
+                    if (!manifest->Save(manifestError)) {
+                        SDL_Log("%s", manifestError.c_str());
+                    }
+                    orphans = manifest->FindOrphans();
+                    manifest.reset();
+                    convertOptions.manifest = nullptr;
+                }
+                convertOptions.archive = nullptr;
+                if (measureQuality && outputsReadable) {
+                    std::vector<ConvertJob> qualityJobs;
+                    for (const auto& item : items) {
+                        if (item.stage == ConvertStage::Done) {
+                            qualityJobs.push_back(item);
+                        }
+                    }
+                    qualityResults.clear();
+                    qualityMessage = "Measuring quality...";
+                    qualityCancel = false;
+                    qualityRun = std::async(std::launch::async,
+                                            [jobs = std::move(qualityJobs), outputDir = batchOutputDir,
+                                             archive = archive.get(), cancel = &qualityCancel] {
+                                                return MeasureQuality(jobs, outputDir, archive, 0, cancel);
+                                            });
+                } else {
+                    archive.reset();
+                }
+            }
+        }
+
+        if (qualityRun.valid() && qualityRun.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            qualityResults = qualityRun.get();
+            archive.reset();
+            // Report order: worst SNR first. The table re-sorts to its own.
+            SortQuality(qualityResults, QualitySortKey::Snr);
+            qualitySortDirty = true;
+            std::filesystem::path reportPath = ConversionManifest::PathFor(batchOutputDir);
+            reportPath.replace_extension(".quality.csv");
+            std::string reportError;
+            qualityMessage = WriteQualityReport(reportPath, qualityResults, reportError)
+                                 ? "Quality report written to " + PathToUtf8(reportPath)
+                                 : "Quality report failed: " + reportError;
+        }
+
+        if (loopSearch.valid() && loopSearch.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+            LoopSearchRun run = loopSearch.get();
+            if (run.candidates.empty()) {
+                loopSearchMessage = "Loop search failed: " + run.error;
+            } else if (run.item < items.size()) {
+                const LoopCandidate& best = run.candidates.front();
+                auto& item = items[run.item];
+                item.loopEnabled = true;
+                item.loopStart = best.loopStart;
+                item.loopEnd = best.loopEnd;
+                char text[128];
+                std::snprintf(text, sizeof(text), "Loop %u to %u, seam %.1f dB (best of %zu)", best.loopStart,
+                              best.loopEnd, best.seamSnrDb, run.candidates.size());
+                loopSearchMessage = text;
+            }
+        }
+
         ImGui_ImplSDLRenderer3_NewFrame();
         ImGui_ImplSDL3_NewFrame();
         ImGui::NewFrame();
@@ -416,14 +666,11 @@ int main(int, char**) {
                          ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoCollapse);
 
         ImGui::Text("Output folder:");
+        ImGui::BeginDisabled(batch != nullptr);
         ImGui::PushItemWidth(-120.0f);
         InputTextString("##output", outputDirStr);
         ImGui::PopItemWidth();
-#ifdef _WIN32
-        outputDir = std::filesystem::path(ToWide(outputDirStr));
-#else
-        outputDir = std::filesystem::u8path(outputDirStr);
-#endif
+        outputDir = Utf8ToPath(outputDirStr);
         ImGui::SameLine();
 #ifndef _WIN32
         ImGui::BeginDisabled();
@@ -443,6 +690,89 @@ int main(int, char**) {
             ImGui::SetTooltip("Manual path or drag-and-drop.");
         }
 #endif
+        ImGui::EndDisabled();
+
+        ImGui::BeginDisabled(batch != nullptr);
+        ImGui::Checkbox("Verify output", &convertOptions.verify);
+        ImGui::EndDisabled();
+        if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+            ImGui::SetTooltip("Decode every converted sample again and check it. Slower.");
+        }
+        ImGui::SameLine();
+        ImGui::BeginDisabled(batch != nullptr);
+        ImGui::Checkbox("Dither", &convertOptions.dither);
+        ImGui::EndDisabled();
+        if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+            ImGui::SetTooltip("Add TPDF dither when stereo, 24/32-bit or float WAVs are reduced to mono 16-bit.");
+        }
+        ImGui::SameLine();
+        ImGui::BeginDisabled(batch != nullptr);
+        ImGui::Checkbox("Skip unchanged", &convertOptions.incremental);
+        ImGui::EndDisabled();
+        if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+            ImGui::SetTooltip("Only convert samples whose WAV, settings or output changed since the last run.");
+        }
+        ImGui::SameLine();
+        ImGui::BeginDisabled(batch != nullptr);
+        ImGui::Checkbox("Cache outputs", &useCache);
+        ImGui::EndDisabled();
+        if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+            ImGui::SetTooltip("Keep a copy of every converted sample in the user data folder and reuse it when the same "
+                              "audio is converted again with the same settings.");
+        }
+        ImGui::SameLine();
+        ImGui::BeginDisabled(batch != nullptr);
+        ImGui::Checkbox("Profile", &convertOptions.profile);
+        ImGui::SameLine();
+        ImGui::Checkbox("Record trace", &recordTrace);
+        ImGui::EndDisabled();
+        if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+            ImGui::SetTooltip("Write a Chrome trace (chrome://tracing or Perfetto) of every stage next to the output folder.");
+        }
+        ImGui::SameLine();
+        ImGui::BeginDisabled(batch != nullptr);
+        ImGui::Checkbox("Quality report", &measureQuality);
+        ImGui::EndDisabled();
+        if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+            ImGui::SetTooltip("After converting, decode every sample and write its SNR, peak error, clipping and DC "
+                              "offset to a CSV next to the output folder.");
+        }
+
+        ImGui::BeginDisabled(batch != nullptr);
+        ImGui::Checkbox("Pack into archive", &packArchive);
+        if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+            ImGui::SetTooltip("Write the samples into a .o2r mod archive in the output folder. Only changed samples are "
+                              "rewritten.");
+        }
+        if (packArchive) {
+            ImGui::SameLine();
+            ImGui::PushItemWidth(240.0f * mainScale);
+            InputTextString("##archive", archiveName);
+            ImGui::PopItemWidth();
+        }
+        ImGui::EndDisabled();
+
+        ImGui::BeginDisabled(batch != nullptr);
+        ImGui::PushItemWidth(100.0f * mainScale);
+        if (ImGui::InputScalar(searchPredictors ? "Max predictors" : "Predictors", ImGuiDataType_S32,
+                               &convertOptions.predictorCount)) {
+            convertOptions.predictorCount = std::clamp(convertOptions.predictorCount, 1, 16);
+        }
+        ImGui::SameLine();
+        if (ImGui::Checkbox("Search", &searchPredictors) && searchPredictors) {
+            convertOptions.predictorCount = 16;
+        }
+        if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+            ImGui::SetTooltip("Use the fewest predictors whose round-trip SNR reaches the target.");
+        }
+        if (searchPredictors) {
+            ImGui::SameLine();
+            if (ImGui::InputScalar("Target SNR (dB)", ImGuiDataType_Double, &targetSnrDb)) {
+                targetSnrDb = std::clamp(targetSnrDb, 1.0, 200.0);
+            }
+        }
+        ImGui::PopItemWidth();
+        ImGui::EndDisabled();
 
         ImGui::TextDisabled("Loop End = 0 uses last sample. Count = -1 means infinite.");
 
@@ -453,21 +783,7 @@ int main(int, char**) {
 #ifdef _WIN32
             auto files = OpenWavDialog();
             for (const auto& path : files) {
-                WavData wav;
-                std::string err;
-                SampleItem item;
-                item.inputPath = path;
-                item.outputName = DefaultOutputName(path);
-                item.outputName.reserve(128);
-                if (ReadWavFile(path, wav, err)) {
-                    item.sampleRate = wav.sampleRate;
-                    item.sampleCount = static_cast<uint32_t>(wav.samples.size());
-                    item.tuning = static_cast<double>(wav.sampleRate) / 32000.0;
-                    item.status = "Ready";
-                } else {
-                    item.status = "WAV error: " + err;
-                }
-                items.push_back(std::move(item));
+                AddSampleItem(items, probes, probeRows, path, DefaultOutputName(path));
             }
 #endif
         }
@@ -477,61 +793,403 @@ int main(int, char**) {
         ImGui::TextDisabled("Use drag-and-drop on this platform.");
 #endif
         ImGui::SameLine();
+        ImGui::BeginDisabled(batch != nullptr);
         if (ImGui::Button("Clear List")) {
+            loopSearchCancel = true;
+            if (loopSearch.valid()) {
+                loopSearch.wait();
+                loopSearch = {};
+            }
+            loopSearchMessage.clear();
             items.clear();
+            selectedItem.reset();
+            waveform.Clear();
+            probeRows.clear();
+            sampleViewDirty = true;
+            scans.clear();
         }
+        ImGui::EndDisabled();
         ImGui::SameLine();
-        if (ImGui::Button("Convert")) {
-            for (auto& item : items) {
-                std::string status;
-                if (ConvertSample(item, outputDir, predictorCount, status)) {
-                    item.status = status;
-                } else {
-                    item.status = status;
+        if (!batch) {
+            // Probes can still set loop points and scans add rows, so wait
+            // for both.
+            ImGui::BeginDisabled(!probeRows.empty() || !scans.empty() || qualityRun.valid());
+            bool convert = ImGui::Button("Convert");
+            ImGui::EndDisabled();
+            if (convert && !items.empty() && packArchive) {
+                archiveMessage.clear();
+                archive = std::make_unique<O2rArchive>();
+                if (!archive->Open(outputDir / Utf8ToPath(archiveName), archiveMessage)) {
+                    // Nothing is converted rather than touching a file that
+                    // could not be read as an archive.
+                    archive.reset();
+                    convert = false;
+                }
+            }
+            if (convert && !items.empty()) {
+                // The preview maps an output file this batch may rewrite.
+                preview->Stop();
+                std::vector<ConvertJob> jobs;
+                jobs.reserve(items.size());
+                for (size_t i = 0; i < items.size(); i++) {
+                    jobs.push_back(items[i]);
+                    items[i].batchIndex = i;
+                    items[i].previewPath.clear();
+                    items[i].stage = ConvertStage::Queued;
+                    items[i].status = ConvertStageName(ConvertStage::Queued);
                 }
+                manifestError.clear();
+                orphans.clear();
+                convertOptions.archive = archive.get();
+                manifest = std::make_unique<ConversionManifest>();
+                if (!manifest->Load(archive ? archive->GetPath() : outputDir, manifestError, archive.get())) {
+                    SDL_Log("%s", manifestError.c_str());
+                }
+                convertOptions.manifest = manifest.get();
+                convertOptions.targetSnrDb = searchPredictors ? targetSnrDb : 0.0;
+                convertOptions.parallelSearch = jobs.size() == 1;
+                if (useCache && !cache) {
+                    std::filesystem::path cacheDir;
+                    if (char* prefPath = SDL_GetPrefPath("SoH", "AudioTool")) {
+                        cacheDir = Utf8ToPath(prefPath) / "cache";
+                        SDL_free(prefPath);
+                    }
+                    cache = std::make_unique<ConversionCache>(cacheDir, kCacheMaxBytes);
+                }
+                convertOptions.cache = useCache ? cache.get() : nullptr;
+                traceMessage.clear();
+                if (recordTrace) {
+                    trace = std::make_unique<TraceRecorder>();
+                    convertOptions.trace = trace.get();
+                }
+                batchOutputDir = outputDir;
+                batch = std::make_unique<ConversionBatch>(std::move(jobs), outputDir, convertOptions);
+            }
+        } else {
+            ImGui::BeginDisabled(batch->IsCancelled());
+            if (ImGui::Button("Cancel")) {
+                batch->Cancel();
+            }
+            ImGui::EndDisabled();
+        }
+
+        std::optional<ConversionBatch::Stats> stats = batch ? std::optional(batch->GetStats()) : lastBatchStats;
+        if (stats) {
+            float fraction = stats->total > 0 ? static_cast<float>(stats->finished) / static_cast<float>(stats->total) : 1.0f;
+            char overlay[64];
+            SDL_snprintf(overlay, sizeof(overlay), "%zu / %zu", stats->finished, stats->total);
+            ImGui::ProgressBar(fraction, ImVec2(-1.0f, 0.0f), overlay);
+
+            double seconds = stats->elapsedSeconds > 0.0 ? stats->elapsedSeconds : 1e-9;
+            double samplesPerSecond = static_cast<double>(stats->samples) / seconds;
+            ImGui::Text("%.1f files/s, %.2f Msamples/s (%.1f MB/s PCM), %zu failed, %.1f s",
+                        static_cast<double>(stats->finished) / seconds,
+                        samplesPerSecond / 1e6,
+                        samplesPerSecond * 2.0 / (1024.0 * 1024.0),
+                        stats->failed,
+                        stats->elapsedSeconds);
+            if (convertOptions.cache) {
+                ConversionCache::Stats cacheStats = convertOptions.cache->GetStats();
+                ImGui::TextDisabled("Cache: %llu hits, %llu misses, %zu entries (%.1f MB)",
+                                    static_cast<unsigned long long>(cacheStats.hits),
+                                    static_cast<unsigned long long>(cacheStats.misses),
+                                    cacheStats.entries,
+                                    static_cast<double>(cacheStats.bytes) / (1024.0 * 1024.0));
+            }
+        }
+        if (!stageSummary.empty() && ImGui::CollapsingHeader("Stage timings")) {
+            if (ImGui::BeginTable("stages", 6, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit)) {
+                ImGui::TableSetupColumn("Stage");
+                ImGui::TableSetupColumn("Runs");
+                ImGui::TableSetupColumn("p50 ms");
+                ImGui::TableSetupColumn("p99 ms");
+                ImGui::TableSetupColumn("Total s");
+                ImGui::TableSetupColumn("MB/s");
+                ImGui::TableHeadersRow();
+                for (const StageSummary& summary : stageSummary) {
+                    ImGui::TableNextRow();
+                    ImGui::TableSetColumnIndex(0);
+                    ImGui::TextUnformatted(ProfileStageName(summary.stage));
+                    ImGui::TableSetColumnIndex(1);
+                    ImGui::Text("%zu", summary.count);
+                    ImGui::TableSetColumnIndex(2);
+                    ImGui::Text("%.3f", summary.p50Seconds * 1000.0);
+                    ImGui::TableSetColumnIndex(3);
+                    ImGui::Text("%.3f", summary.p99Seconds * 1000.0);
+                    ImGui::TableSetColumnIndex(4);
+                    ImGui::Text("%.3f", summary.totalSeconds);
+                    ImGui::TableSetColumnIndex(5);
+                    ImGui::Text("%.1f", summary.mbPerSecond);
+                }
+                ImGui::EndTable();
+            }
+        }
+        if (!traceMessage.empty()) {
+            ImGui::TextDisabled("%s", traceMessage.c_str());
+        }
+        if (!archiveMessage.empty()) {
+            ImGui::TextDisabled("%s", archiveMessage.c_str());
+        }
+        if (!qualityMessage.empty()) {
+            ImGui::TextDisabled("%s", qualityMessage.c_str());
+        }
+        if (!qualityResults.empty() && ImGui::CollapsingHeader("Quality")) {
+            ImGuiTableFlags qualityFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY |
+                                           ImGuiTableFlags_Sortable | ImGuiTableFlags_SizingFixedFit;
+            if (ImGui::BeginTable("quality", 5, qualityFlags, ImVec2(0.0f, 200.0f * mainScale))) {
+                ImGui::TableSetupScrollFreeze(0, 1);
+                // Ascending is worst first, matching SortQuality.
+                ImGui::TableSetupColumn("Output Name", ImGuiTableColumnFlags_WidthStretch, 0.0f,
+                                        static_cast<ImGuiID>(QualitySortKey::Name));
+                ImGui::TableSetupColumn("SNR dB", ImGuiTableColumnFlags_DefaultSort, 0.0f,
+                                        static_cast<ImGuiID>(QualitySortKey::Snr));
+                ImGui::TableSetupColumn("Peak error", 0, 0.0f, static_cast<ImGuiID>(QualitySortKey::PeakError));
+                ImGui::TableSetupColumn("Clipped", 0, 0.0f, static_cast<ImGuiID>(QualitySortKey::Clipping));
+                ImGui::TableSetupColumn("DC offset", 0, 0.0f, static_cast<ImGuiID>(QualitySortKey::DcOffset));
+                ImGui::TableHeadersRow();
+                if (ImGuiTableSortSpecs* specs = ImGui::TableGetSortSpecs(); specs && (specs->SpecsDirty || qualitySortDirty)) {
+                    if (specs->SpecsCount > 0) {
+                        SortQuality(qualityResults, static_cast<QualitySortKey>(specs->Specs[0].ColumnUserID),
+                                    specs->Specs[0].SortDirection == ImGuiSortDirection_Descending);
+                    }
+                    specs->SpecsDirty = false;
+                    qualitySortDirty = false;
+                }
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>(qualityResults.size()));
+                while (clipper.Step()) {
+                    for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                        const SampleQuality& item = qualityResults[static_cast<size_t>(row)];
+                        ImGui::TableNextRow();
+                        ImGui::TableSetColumnIndex(0);
+                        ImGui::TextUnformatted(item.outputName.c_str());
+                        ImGui::TableSetColumnIndex(1);
+                        if (!item.ok) {
+                            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", item.error.c_str());
+                            continue;
+                        }
+                        ImGui::Text("%.1f", item.snrDb);
+                        ImGui::TableSetColumnIndex(2);
+                        ImGui::Text("%u", item.peakError);
+                        ImGui::TableSetColumnIndex(3);
+                        ImGui::Text("%llu", static_cast<unsigned long long>(item.clippedSamples));
+                        ImGui::TableSetColumnIndex(4);
+                        ImGui::Text("%.2f", item.dcOffset);
+                    }
+                }
+                ImGui::EndTable();
+            }
+        }
+        if (!manifestError.empty()) {
+            ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.3f, 1.0f), "%s", manifestError.c_str());
+        }
+        if (!orphans.empty() &&
+            ImGui::CollapsingHeader((std::to_string(orphans.size()) + " stale outputs (input removed)###orphans").c_str())) {
+            for (const auto& orphan : orphans) {
+                ImGui::BulletText("%s  <-  %s", orphan.outputName.c_str(), PathToUtf8(orphan.inputPath).c_str());
             }
         }
 
+        if (selectedItem && ImGui::CollapsingHeader("Waveform", ImGuiTreeNodeFlags_DefaultOpen)) {
+            auto& item = items[*selectedItem];
+            ImGui::TextUnformatted(item.inputLabel.c_str());
+            ImGui::SameLine();
+            ImGui::BeginDisabled(loopSearch.valid() || batch != nullptr);
+            if (ImGui::SmallButton(loopSearch.valid() ? "Searching..." : "Find Loop")) {
+                LoopSearchOptions search;
+                search.loopEnd = item.loopEnabled ? item.loopEnd : 0;
+                search.snapToFrames = waveform.GetSnapToFrames();
+                search.predictorCount = convertOptions.predictorCount;
+                loopSearchCancel = false;
+                loopSearchMessage.clear();
+                loopSearch = std::async(std::launch::async, [job = ConvertJob(item), index = *selectedItem, search,
+                                                             dither = convertOptions.dither, cancel = &loopSearchCancel] {
+                    LoopSearchRun run;
+                    run.item = index;
+                    FindJobLoopPoints(job, dither, search, run.candidates, run.error, cancel);
+                    return run;
+                });
+            }
+            ImGui::EndDisabled();
+            if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+                ImGui::SetTooltip("Search for the loop start whose seam sounds smoothest, ending at the current loop "
+                                  "end (or the end of the sample).");
+            }
+            if (!loopSearchMessage.empty()) {
+                ImGui::SameLine();
+                ImGui::TextDisabled("%s", loopSearchMessage.c_str());
+            }
+            waveform.Draw(160.0f * mainScale, item.targetSampleRate, item.loopEnabled, item.loopStart, item.loopEnd);
+        }
+
         ImGui::Separator();
 
-        if (ImGui::BeginTable("samples", 8, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable)) {
-            ImGui::TableSetupColumn("Input");
-            ImGui::TableSetupColumn("Output Name");
-            ImGui::TableSetupColumn("Loop");
-            ImGui::TableSetupColumn("Start");
-            ImGui::TableSetupColumn("End");
-            ImGui::TableSetupColumn("Count");
-            ImGui::TableSetupColumn("Rate");
-            ImGui::TableSetupColumn("Status");
+        ImGui::PushItemWidth(240.0f * mainScale);
+        if (InputTextString("Filter", filterText)) {
+            sampleViewDirty = true;
+        }
+        ImGui::PopItemWidth();
+        ImGui::SameLine();
+        ImGui::PushItemWidth(140.0f * mainScale);
+        if (ImGui::Combo("##filterField", &filterField, "All columns\0Input\0Output Name\0Status\0")) {
+            sampleViewDirty = true;
+        }
+        ImGui::PopItemWidth();
+        ImGui::SameLine();
+        ImGui::TextDisabled("%zu of %zu samples", sampleView.size(), items.size());
+
+        ImGuiTableFlags tableFlags = ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_Resizable |
+                                     ImGuiTableFlags_ScrollY | ImGuiTableFlags_Sortable | ImGuiTableFlags_SortMulti |
+                                     ImGuiTableFlags_SortTristate;
+        if (ImGui::BeginTable("samples", static_cast<int>(kSampleColumnCount), tableFlags)) {
+            ImGuiTableColumnFlags noSort = ImGuiTableColumnFlags_NoSort;
+            ImGui::TableSetupScrollFreeze(0, 1);
+            ImGui::TableSetupColumn("Input", 0, 0.0f, kColumnInput);
+            ImGui::TableSetupColumn("Output Name", 0, 0.0f, kColumnOutput);
+            ImGui::TableSetupColumn("Loop", noSort, 0.0f, kColumnLoop);
+            ImGui::TableSetupColumn("Start", noSort, 0.0f, kColumnLoopStart);
+            ImGui::TableSetupColumn("End", noSort, 0.0f, kColumnLoopEnd);
+            ImGui::TableSetupColumn("Count", noSort, 0.0f, kColumnLoopCount);
+            ImGui::TableSetupColumn("Rate", 0, 0.0f, kColumnRate);
+            ImGui::TableSetupColumn("Target Rate", 0, 0.0f, kColumnTargetRate);
+            ImGui::TableSetupColumn("Status", 0, 0.0f, kColumnStatus);
+            ImGui::TableSetupColumn("Time", 0, 0.0f, kColumnTime);
+            ImGui::TableSetupColumn("Predictors", 0, 0.0f, kColumnPredictors);
+            ImGui::TableSetupColumn("SNR", 0, 0.0f, kColumnSnr);
+            ImGui::TableSetupColumn("Preview", noSort, 0.0f, kColumnPreview);
             ImGui::TableHeadersRow();
 
-            for (size_t i = 0; i < items.size(); i++) {
-                auto& item = items[i];
-                ImGui::TableNextRow();
+            if (ImGuiTableSortSpecs* specs = ImGui::TableGetSortSpecs(); specs && specs->SpecsDirty) {
+                sortKeys.clear();
+                for (int i = 0; i < specs->SpecsCount; i++) {
+                    const ImGuiTableColumnSortSpecs& spec = specs->Specs[i];
+                    sortKeys.push_back({spec.ColumnUserID, spec.SortDirection == ImGuiSortDirection_Ascending});
+                }
+                specs->SpecsDirty = false;
+                sampleViewDirty = true;
+            }
+            if (!sampleViewDirty && sortKeys.empty() && sampleViewItemCount < items.size()) {
+                // Unsorted rows only ever grow at the end, so a folder import
+                // costs one filter check per new row instead of a rebuild.
+                for (size_t i = sampleViewItemCount; i < items.size(); i++) {
+                    if (MatchesFilter(items[i], filterText, filterField)) {
+                        sampleView.push_back(i);
+                    }
+                }
+                sampleViewItemCount = items.size();
+            } else if (sampleViewDirty || sampleViewItemCount != items.size()) {
+                BuildSampleView(items, sortKeys, filterText, filterField, sampleView);
+                sampleViewItemCount = items.size();
+                sampleViewDirty = false;
+            }
+
+            // Only the rows in view are submitted; every row has the same
+            // height, which is what the clipper needs.
+            ImGuiListClipper clipper;
+            clipper.Begin(static_cast<int>(sampleView.size()));
+            while (clipper.Step()) {
+                for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; row++) {
+                    size_t i = sampleView[static_cast<size_t>(row)];
+                    auto& item = items[i];
+                    ImGui::PushID(static_cast<int>(i));
+                    ImGui::TableNextRow();
+
+                    ImGui::TableSetColumnIndex(kColumnInput);
+                    if (ImGui::Selectable(item.inputLabel.c_str(), selectedItem == i)) {
+                        selectedItem = i;
+                        waveform.SetSource(item.inputPath);
+                    }
+
+                    ImGui::TableSetColumnIndex(kColumnOutput);
+                    InputTextString("##out", item.outputName);
 
-                ImGui::TableSetColumnIndex(0);
-                ImGui::TextUnformatted(PathToUtf8(item.inputPath).c_str());
+                    ImGui::TableSetColumnIndex(kColumnLoop);
+                    ImGui::Checkbox("##loop", &item.loopEnabled);
 
-                ImGui::TableSetColumnIndex(1);
-                InputTextString(("##out" + std::to_string(i)).c_str(), item.outputName);
+                    ImGui::TableSetColumnIndex(kColumnLoopStart);
+                    ImGui::InputScalar("##start", ImGuiDataType_U32, &item.loopStart);
 
-                ImGui::TableSetColumnIndex(2);
-                ImGui::Checkbox(("##loop" + std::to_string(i)).c_str(), &item.loopEnabled);
+                    ImGui::TableSetColumnIndex(kColumnLoopEnd);
+                    ImGui::InputScalar("##end", ImGuiDataType_U32, &item.loopEnd);
 
-                ImGui::TableSetColumnIndex(3);
-                ImGui::InputScalar(("##start" + std::to_string(i)).c_str(), ImGuiDataType_U32, &item.loopStart);
+                    ImGui::TableSetColumnIndex(kColumnLoopCount);
+                    ImGui::InputScalar("##count", ImGuiDataType_S32, &item.loopCount);
 
-                ImGui::TableSetColumnIndex(4);
-                ImGui::InputScalar(("##end" + std::to_string(i)).c_str(), ImGuiDataType_U32, &item.loopEnd);
+                    ImGui::TableSetColumnIndex(kColumnRate);
+                    ImGui::TextUnformatted(item.rateLabel.c_str());
 
-                ImGui::TableSetColumnIndex(5);
-                ImGui::InputScalar(("##count" + std::to_string(i)).c_str(), ImGuiDataType_S32, &item.loopCount);
+                    ImGui::TableSetColumnIndex(kColumnTargetRate);
+                    if (ImGui::InputScalar("##rate", ImGuiDataType_U32, &item.targetSampleRate)) {
+                        item.targetSampleRate = std::min<uint32_t>(item.targetSampleRate, 768000);
+                        if (item.sampleRate != 0) {
+                            UpdateRateLabel(item);
+                        }
+                    }
+                    if (ImGui::IsItemHovered()) {
+                        ImGui::SetTooltip("Resample to this rate before encoding. 0 keeps the WAV's rate.");
+                    }
 
-                ImGui::TableSetColumnIndex(6);
-                ImGui::Text("%u (%.4f) / %u", item.sampleRate, item.tuning, item.sampleCount);
+                    ImGui::TableSetColumnIndex(kColumnStatus);
+                    ImGui::TextUnformatted(item.status.c_str());
+
+                    ImGui::TableSetColumnIndex(kColumnTime);
+                    if (item.timings) {
+                        ImGui::Text("%.1f ms", item.timings->Total() * 1000.0);
+                        if (ImGui::IsItemHovered()) {
+                            ImGui::BeginTooltip();
+                            for (size_t stage = 0; stage < kProfileStageCount; stage++) {
+                                if (item.timings->seconds[stage] > 0.0) {
+                                    ImGui::Text("%-9s %8.3f ms", ProfileStageName(static_cast<ProfileStage>(stage)),
+                                                item.timings->seconds[stage] * 1000.0);
+                                }
+                            }
+                            ImGui::Text("%-9s %8u", "Buffers", item.timings->bufferAllocations);
+                            ImGui::EndTooltip();
+                        }
+                    }
 
-                ImGui::TableSetColumnIndex(7);
-                ImGui::TextUnformatted(item.status.c_str());
+                    if (item.predictorChoice) {
+                        ImGui::TableSetColumnIndex(kColumnPredictors);
+                        ImGui::Text("%d", item.predictorChoice->predictorCount);
+
+                        ImGui::TableSetColumnIndex(kColumnSnr);
+                        if (std::isinf(item.predictorChoice->snrDb) && item.predictorChoice->snrDb > 0) {
+                            ImGui::TextUnformatted("Lossless");
+                        } else if (item.predictorChoice->metTarget) {
+                            ImGui::Text("%.1f dB", item.predictorChoice->snrDb);
+                        } else {
+                            ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.3f, 1.0f), "%.1f dB", item.predictorChoice->snrDb);
+                            if (ImGui::IsItemHovered()) {
+                                ImGui::SetTooltip("No predictor count reached the target; the best one was kept.");
+                            }
+                        }
+                    }
+
+                    ImGui::TableSetColumnIndex(kColumnPreview);
+                    bool playing = !item.previewPath.empty() && preview->IsPlaying() &&
+                                   preview->GetPath() == item.previewPath;
+                    ImGui::BeginDisabled(item.previewPath.empty() || batch != nullptr);
+                    if (ImGui::SmallButton(playing ? "Stop" : "Play")) {
+                        std::string previewError;
+                        if (playing) {
+                            preview->Stop();
+                        } else if (!preview->Play(item.previewPath, item.previewRate, previewError)) {
+                            item.status = "Preview failed: " + previewError;
+                        }
+                    }
+                    ImGui::EndDisabled();
+                    if (ImGui::IsItemHovered(ImGuiHoveredFlags_AllowWhenDisabled)) {
+                        if (playing) {
+                            ImGui::SetTooltip("Sample %u of the encoded output at %u Hz, loops included.",
+                                              preview->GetPosition(), item.previewRate);
+                        } else if (item.previewPath.empty()) {
+                            ImGui::SetTooltip("Convert to a folder to preview; archived samples are not played.");
+                        } else {
+                            ImGui::SetTooltip("Play the encoded output as the game would, loops included.");
+                        }
+                    }
+                    ImGui::PopID();
+                }
             }
 
             ImGui::EndTable();
@@ -547,6 +1205,16 @@ int main(int, char**) {
         SDL_RenderPresent(renderer);
     }
 
+    qualityCancel = true;
+    if (qualityRun.valid()) {
+        qualityRun.wait();
+    }
+    loopSearchCancel = true;
+    if (loopSearch.valid()) {
+        loopSearch.wait();
+    }
+    preview.reset();
+
     ImGui_ImplSDLRenderer3_Shutdown();
     ImGui_ImplSDL3_Shutdown();
     ImGui::DestroyContext();